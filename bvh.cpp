@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+
+#include "bvh.h"
+
+namespace game {
+
+    // Number of candidate split positions per axis
+    static const int bvh_bins_g = 12;
+    // Deepest level of the tree (traversal keeps at most one pending node per level)
+    static const int bvh_max_depth_g = 60;
+
+
+    AABB TransformAABB(const AABB& box, const glm::mat4& transf) {
+
+        AABB result;
+        if (box.IsEmpty()) {
+            return result;
+        }
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                             (i & 2) ? box.max.y : box.min.y,
+                             (i & 4) ? box.max.z : box.min.z);
+            result.Grow(glm::vec3(transf * glm::vec4(corner, 1.0f)));
+        }
+        return result;
+    }
+
+
+    Bvh::Bvh(void) {
+    }
+
+
+    void Bvh::SetNodeBounds(BvhNode& node, const AABB& box) {
+
+        for (int a = 0; a < 3; a++) {
+            node.min[a] = box.min[a];
+            node.max[a] = box.max[a];
+        }
+    }
+
+
+    void Bvh::Build(const std::vector<AABB>& bounds) {
+
+        bounds_ = bounds;
+        nodes_.clear();
+        primitive_.resize(bounds.size());
+        for (int i = 0; i < primitive_.size(); i++) {
+            primitive_[i] = i;
+        }
+        if (bounds.empty()) {
+            return;
+        }
+
+        // At most 2n - 1 nodes
+        nodes_.reserve(bounds.size() * 2);
+        BvhNode root;
+        root.left_first = 0;
+        root.count = bounds.size();
+        nodes_.push_back(root);
+
+        Refit();
+        Subdivide(0, 0);
+        Refit();
+    }
+
+
+    void Bvh::Subdivide(int node_index, int depth) {
+
+        int first = nodes_[node_index].left_first;
+        int count = nodes_[node_index].count;
+        if (count <= 2 || depth >= bvh_max_depth_g) {
+            return;
+        }
+
+        // Split positions are chosen on primitive centers
+        AABB centers;
+        AABB box;
+        for (int i = first; i < first + count; i++) {
+            centers.Grow(bounds_[primitive_[i]].GetCenter());
+            box.Grow(bounds_[primitive_[i]]);
+        }
+
+        // Binned SAH: try bvh_bins_g - 1 split planes on every axis
+        float best_cost = FLT_MAX;
+        int best_axis = -1;
+        int best_split = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float lo = centers.min[axis];
+            float hi = centers.max[axis];
+            if (hi <= lo) {
+                continue;
+            }
+            float scale = bvh_bins_g / (hi - lo);
+
+            AABB bin_box[bvh_bins_g];
+            int bin_count[bvh_bins_g] = { 0 };
+            for (int i = first; i < first + count; i++) {
+                const AABB& b = bounds_[primitive_[i]];
+                int bin = std::min(bvh_bins_g - 1, (int)((b.GetCenter()[axis] - lo) * scale));
+                bin_count[bin]++;
+                bin_box[bin].Grow(b);
+            }
+
+            // Sweep from both sides to get the cost of every split plane
+            float left_area[bvh_bins_g - 1];
+            int left_count[bvh_bins_g - 1];
+            AABB left;
+            int n = 0;
+            for (int i = 0; i < bvh_bins_g - 1; i++) {
+                left.Grow(bin_box[i]);
+                n += bin_count[i];
+                left_area[i] = left.GetHalfArea();
+                left_count[i] = n;
+            }
+            AABB right;
+            n = 0;
+            for (int i = bvh_bins_g - 1; i > 0; i--) {
+                right.Grow(bin_box[i]);
+                n += bin_count[i];
+                float cost = left_count[i - 1] * left_area[i - 1] + n * right.GetHalfArea();
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = i;
+                }
+            }
+        }
+
+        // Keep the leaf if no split is cheaper than testing every primitive
+        if (best_axis < 0 || best_cost >= count * box.GetHalfArea()) {
+            return;
+        }
+
+        // Partition the primitives around the chosen plane
+        float lo = centers.min[best_axis];
+        float scale = bvh_bins_g / (centers.max[best_axis] - lo);
+        int i = first;
+        int j = first + count - 1;
+        while (i <= j) {
+            int bin = std::min(bvh_bins_g - 1, (int)((bounds_[primitive_[i]].GetCenter()[best_axis] - lo) * scale));
+            if (bin < best_split) {
+                i++;
+            }
+            else {
+                std::swap(primitive_[i], primitive_[j--]);
+            }
+        }
+        int left_count = i - first;
+        if (left_count == 0 || left_count == count) {
+            return;
+        }
+
+        // Children are stored next to each other
+        int left_index = nodes_.size();
+        BvhNode child;
+        child.left_first = first;
+        child.count = left_count;
+        nodes_.push_back(child);
+        child.left_first = i;
+        child.count = count - left_count;
+        nodes_.push_back(child);
+
+        nodes_[node_index].left_first = left_index;
+        nodes_[node_index].count = 0;
+
+        Subdivide(left_index, depth + 1);
+        Subdivide(left_index + 1, depth + 1);
+    }
+
+
+    void Bvh::SetBounds(int primitive, const AABB& bounds) {
+
+        bounds_[primitive] = bounds;
+    }
+
+
+    void Bvh::Refit(void) {
+
+        // Children always come after their parent, so walking backwards updates them first
+        for (int n = nodes_.size() - 1; n >= 0; n--) {
+            BvhNode& node = nodes_[n];
+            AABB box;
+            if (node.count > 0) {
+                for (int i = node.left_first; i < node.left_first + node.count; i++) {
+                    box.Grow(bounds_[primitive_[i]]);
+                }
+            }
+            else {
+                for (int c = node.left_first; c <= node.left_first + 1; c++) {
+                    AABB child;
+                    child.min = glm::vec3(nodes_[c].min[0], nodes_[c].min[1], nodes_[c].min[2]);
+                    child.max = glm::vec3(nodes_[c].max[0], nodes_[c].max[1], nodes_[c].max[2]);
+                    box.Grow(child);
+                }
+            }
+            SetNodeBounds(node, box);
+        }
+    }
+
+
+    float Bvh::IntersectBox(const Ray& ray, const float* box_min, const float* box_max, float t_max) {
+
+        // Empty boxes (e.g. removed objects) are never hit
+        if (box_min[0] > box_max[0]) {
+            return INFINITY;
+        }
+
+        // Slab test
+        float t0 = 0.0f;
+        float t1 = t_max;
+        for (int a = 0; a < 3; a++) {
+            float near_t = (box_min[a] - ray.origin[a]) * ray.inv_direction[a];
+            float far_t = (box_max[a] - ray.origin[a]) * ray.inv_direction[a];
+            if (near_t > far_t) {
+                std::swap(near_t, far_t);
+            }
+            t0 = std::max(t0, near_t);
+            t1 = std::min(t1, far_t);
+        }
+        return (t0 <= t1) ? t0 : INFINITY;
+    }
+
+} // namespace game
@@ -0,0 +1,141 @@
+/*
+ *
+ * Bounding volume hierarchy over axis-aligned boxes, used for ray and segment queries.
+ * Built top-down with a binned surface area heuristic (SAH). Nodes are stored flat in one array,
+ * 32 bytes each, with the two children of a node next to each other, so traversal walks a compact
+ * array instead of chasing pointers. Moving primitives are handled by refitting the boxes without
+ * rebuilding the tree.
+ *
+ */
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <vector>
+#include <cfloat>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace game {
+
+    // Axis-aligned bounding box; an empty box has min > max and is never hit
+    struct AABB {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        inline void Grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+        inline void Grow(const AABB& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+        inline bool IsEmpty(void) const { return min.x > max.x; }
+        inline glm::vec3 GetCenter(void) const { return (min + max) * 0.5f; }
+        // Half the surface area (enough for comparing SAH costs)
+        inline float GetHalfArea(void) const {
+            if (IsEmpty()) return 0.0f;
+            glm::vec3 e = max - min;
+            return e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+    };
+
+    // Bounds of a box after a transformation
+    AABB TransformAABB(const AABB& box, const glm::mat4& transf);
+
+    // Flattened node: leaves have count > 0 and index the primitive list, inner nodes have
+    // count == 0 and their children at left_first and left_first + 1
+    struct BvhNode {
+        float min[3];
+        int left_first;
+        float max[3];
+        int count;
+    };
+
+    // A ray with the reciprocal direction precomputed for box tests
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 direction; // Need not be normalized; distances are in multiples of it
+        glm::vec3 inv_direction;
+
+        Ray(glm::vec3 o, glm::vec3 d) : origin(o), direction(d), inv_direction(1.0f / d.x, 1.0f / d.y, 1.0f / d.z) {}
+    };
+
+    class Bvh {
+
+        public:
+            Bvh(void);
+
+            // Build the tree over the given primitive bounds (primitive i keeps index i)
+            void Build(const std::vector<AABB>& bounds);
+
+            // Change the bounds of one primitive; call Refit() afterwards to update the tree
+            void SetBounds(int primitive, const AABB& bounds);
+            // Recompute every node box from its children/primitives (tree shape is kept)
+            void Refit(void);
+
+            bool IsEmpty(void) const { return nodes_.empty(); }
+            int GetNumNodes(void) const { return nodes_.size(); }
+
+            // Entry distance of the ray into a box, or a value > t_max if it misses
+            static float IntersectBox(const Ray& ray, const float* box_min, const float* box_max, float t_max);
+
+            // Find the closest hit along the ray up to t_max.
+            // hit_primitive(index, t_max) tests one primitive and returns its hit distance (> t_max for a miss).
+            // Returns the primitive hit, or -1; t_max is lowered to the hit distance.
+            template <typename HitPrimitive>
+            int RayCast(const Ray& ray, float& t_max, HitPrimitive hit_primitive) const {
+                if (nodes_.empty()) {
+                    return -1;
+                }
+
+                int hit = -1;
+                int stack[64];
+                int top = 0;
+                if (IntersectBox(ray, nodes_[0].min, nodes_[0].max, t_max) <= t_max) {
+                    stack[top++] = 0;
+                }
+
+                while (top > 0) {
+                    const BvhNode& node = nodes_[stack[--top]];
+
+                    if (node.count > 0) {
+                        for (int i = 0; i < node.count; i++) {
+                            int primitive = primitive_[node.left_first + i];
+                            float t = hit_primitive(primitive, t_max);
+                            if (t <= t_max) {
+                                t_max = t;
+                                hit = primitive;
+                            }
+                        }
+                        continue;
+                    }
+
+                    // Visit the nearer child first so the far one can often be skipped
+                    int a = node.left_first;
+                    int b = node.left_first + 1;
+                    float ta = IntersectBox(ray, nodes_[a].min, nodes_[a].max, t_max);
+                    float tb = IntersectBox(ray, nodes_[b].min, nodes_[b].max, t_max);
+                    if (ta > tb) {
+                        float t = ta; ta = tb; tb = t;
+                        int n = a; a = b; b = n;
+                    }
+                    if (tb <= t_max && top < 64) {
+                        stack[top++] = b;
+                    }
+                    if (ta <= t_max && top < 64) {
+                        stack[top++] = a;
+                    }
+                }
+                return hit;
+            }
+
+        private:
+            std::vector<BvhNode> nodes_;
+            std::vector<int> primitive_; // Primitive indices, grouped by leaf
+            std::vector<AABB> bounds_; // Bounds of each primitive
+
+            // Split the node into two children if the SAH says it pays off
+            // Depth is capped so traversal never needs more than its fixed-size stack
+            void Subdivide(int node_index, int depth);
+            void SetNodeBounds(BvhNode& node, const AABB& box);
+
+    }; // class Bvh
+
+} // namespace game
+
+#endif // BVH_H_
@@ -10,9 +10,12 @@ namespace game {
 Camera::Camera(void){
     state_ = walking;
     radius_ = 1.0f;
+    terrain_ = NULL;
+    walk_field_ = NULL;
 
     max_y_ = 15.5;
     ground_height_ = 3.4f;
+    max_landing_slope_ = 1.1f;
 }
 
 Camera::~Camera(){}
@@ -54,57 +57,12 @@ void Camera::SetTimer(float t) {
     timer_ = t;
 }
 
-// This function sets the necessary height maps for the camera to use when traversing the terrain
-void Camera::SetHeightMap(std::vector<float> h, std::vector<float> height_boundary) {
-
-    for (int i = 0; i < h.size(); i++) {
-        height_map_.push_back(std::max(h[i], height_boundary[i]));
-    }
-
-    float slopes[4];
-    int index = 0;
-    // z
-    for (int i = 0; i < height - 1; i++) {
-        // x
-        for (int j = 0; j < width - 1; j++) {
-            float heightA = height_map_[j + (width -1)* i];
-            float heightB = height_map_[j + 1 + (width - 1) * i];
-            float heightC = height_map_[j + (width - 1) * (i + 1)];
-            float heightD = height_map_[(j + 1) + (width - 1) * (i + 1)];
-            // A B
-            // C D
-
-            //AB
-            slopes[0] = heightB - heightA;
-
-            //BD
-            slopes[1] = heightD - heightB;
-
-            //CD
-            slopes[2] = heightD - heightC;
-
-            //AC
-            slopes[3] = heightC - heightA;
-            for (int i = 1; i < 4; i++) {
-                if (abs(slopes[index]) < abs(slopes[i])) {
-                    index = i;
-                }
-            }
-
-            slope_map_.push_back(slopes[index]);
-            index = 0;
-        }
-    }
+void Camera::SetTerrain(const Terrain* terrain) {
+    terrain_ = terrain;
 }
- // This function sets the necessary height map dimensions for the camera
-void Camera::SetDimensions(int x, int z, int w, int h) {
-    offsetX = x;
-    offsetZ = z;
-    width = w;
-    height = h;
 
-    slope_map_.reserve((width-1) * (height-1));
-    height_map_.reserve(width * height);
+void Camera::SetWalkField(const WalkField* walk_field) {
+    walk_field_ = walk_field;
 }
 
 void Camera::IncreaseTimer(float t) {
@@ -247,34 +205,27 @@ void Camera::Update(float delta_time)
     glm::vec3 tempPos = position_ + ((GetForwardMovement() * forward_speed_ * delta_time)) + (GetSideMovement() * side_speed_ * delta_time);
 
     float oldY = 0.0;
-    
-
-    int coordXMin = floor(tempPos.x + offsetX);
-    int coordXMax = ceil(tempPos.x + offsetX);
-
-    int coordZMin = floor(tempPos.z + offsetZ);
-    int coordZMax = ceil(tempPos.z + offsetZ);
-
-    float s = tempPos.x + offsetX - coordXMin;
-    float t = tempPos.z + offsetZ - coordZMin;
-
-    int x = coordXMin - (1 - round(s));
-    int z = coordZMin - (1 - round(t));
 
+    // Free movement until there is ground to walk on
+    if (terrain_ == NULL || terrain_->IsEmpty()) {
+        position_ = tempPos;
+        return;
+    }
 
-    float a = (height_map_)[coordXMin + (width) * coordZMin];
-    float b = (height_map_)[coordXMax + (width) * coordZMin];
-    float c = (height_map_)[coordXMin + (width) * coordZMax];
-    float d = (height_map_)[coordXMax + (width) * coordZMax];
+    // Keep to walkable ground: movement into steep slopes or the edge of the field slides along them
+    if (walk_field_ != NULL && state_ != jumping) {
+        tempPos = walk_field_->Slide(position_, tempPos, 0.0f);
+    }
 
-    float interpolation = ((1 - t) * ((1 - s) * a + s * b) + t * ((1 - s) * c + s * d)) + 3.0;
+    float interpolation = terrain_->GetHeight(tempPos.x, tempPos.z) + 3.0;
     if (state_ == jumping)
     {
         //y position is calculated using kinematic equation of vertical motion, factoring in gravity, base y position,
         //basevelocity, and time (jump height is also specified here)
         if (position_.y <= ground_height_ + 0.2)
         {
-            if (abs(slope_map_[x + width * z]) >= 1.1 || x == 0 || x == height - 2 || z == 0 || z == width - 2)
+            // Landing is allowed on somewhat steeper ground than walking
+            if (!CanLand(tempPos))
             {
                 state_ = walking;
                 return;
@@ -314,11 +265,6 @@ void Camera::Update(float delta_time)
     }
     else
     {
-        if (abs(slope_map_[x + width * z]) >= 1.0 || x == 0 || x == height - 2 || z == 0 || z == width - 2)
-        {
-            return;
-        }
-
         tempPos.y = interpolation;
         position_ = tempPos;
         oldY = interpolation;
@@ -327,6 +273,18 @@ void Camera::Update(float delta_time)
 
 }
 
+bool Camera::CanLand(glm::vec3 position) const {
+
+    // Cell whose center is nearest in each direction; cells on the edge of the field never are
+    glm::vec2 grid = glm::vec2(position.x, position.z) - terrain_->GetOrigin();
+    int x = floor(grid.x) - (1 - round(grid.x - floor(grid.x)));
+    int z = floor(grid.y) - (1 - round(grid.y - floor(grid.y)));
+    if (x <= 0 || z <= 0 || x >= terrain_->GetWidth() - 2 || z >= terrain_->GetDepth() - 2) {
+        return false;
+    }
+    return terrain_->GetCellSlope(x, z) < max_landing_slope_;
+}
+
 void Camera::UpdateForwardVelocity(float backwards)
 {
     forward_speed_ = max_speed_ * backwards;
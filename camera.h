@@ -13,6 +13,9 @@
 #include <iostream>
 #include <vector>
 
+#include "terrain.h"
+#include "walk_field.h"
+
 
 namespace game {
 
@@ -43,8 +46,10 @@ namespace game {
             void SetDead(bool d);
             void SetHurt(bool h);
             inline void SetState(CameraState t) { state_ = t; }
-            void SetHeightMap(std::vector<float> h, std::vector<float> height_boundary);
-            void SetDimensions(int x, int z, int width, int height);
+            // Ground the camera walks on (owned by the game)
+            void SetTerrain(const Terrain* terrain);
+            // Where the camera may walk (owned by the game)
+            void SetWalkField(const WalkField* walk_field);
             void UpdateForwardVelocity(float backwards);
             void UpdateSideVelocity(float left);
             void Update(float delta_time);
@@ -111,16 +116,13 @@ namespace game {
             glm::vec3 base_position_;
             CameraState state_;
 
-            std::vector<float> height_map_;
-            std::vector<float> slope_map_;
-            int offsetX;
-            int offsetZ;
-            int width;
-            int height;
+            const Terrain* terrain_;
+            const WalkField* walk_field_;
 
 
             float max_y_;
             float ground_height_;
+            float max_landing_slope_; // Steepest cell a jump can end on (walking stops at the walk field's limit)
 
             // For collision
             float radius_;
@@ -138,6 +140,8 @@ namespace game {
 
             // Create view matrix from current camera parameters
             void SetupViewMatrix(void);
+            // True if a jump may end at the position
+            bool CanLand(glm::vec3 position) const;
 
     }; // class Camera
 
@@ -1,4 +1,5 @@
 #include "composite_node.h"
+#include "node_pool.h"
 #include <iostream>
 namespace game {
 
@@ -8,20 +9,43 @@ namespace game {
 
     CompositeNode::~CompositeNode(){}
 
+    static NodePool<CompositeNode>& GetCompositeNodePool(void) {
+        static NodePool<CompositeNode> pool;
+        return pool;
+    }
+
+    void* CompositeNode::operator new(std::size_t size) {
+        if (size != sizeof(CompositeNode)) {
+            return ::operator new(size);
+        }
+        return GetCompositeNodePool().Allocate();
+    }
+
+    void CompositeNode::operator delete(void* p, std::size_t size) {
+        if (p == nullptr) {
+            return;
+        }
+        if (size != sizeof(CompositeNode)) {
+            ::operator delete(p);
+            return;
+        }
+        GetCompositeNodePool().Free(p);
+    }
+
+    void CompositeNode::ReleasePool(void) {
+        GetCompositeNodePool().Release();
+    }
+
     void CompositeNode::AddNode(SceneNode* node) {
         root_->AddChild(node);
         node_.push_back(node);
+        index_.Insert(node->GetName(), node);
     }
 
-    SceneNode* CompositeNode::GetNode(std::string node_name) const {
+    SceneNode* CompositeNode::GetNode(std::string_view node_name) const {
 
         // Find node with the specified name
-        for (int i = 0; i < node_.size(); i++) {
-            if (node_[i]->GetName() == node_name) {
-                return node_[i];
-            }
-        }
-        return NULL;
+        return index_.Find(node_name);
     }
 
     SceneNode* CompositeNode::GetNode(int index) const {
@@ -50,6 +74,7 @@ namespace game {
     void CompositeNode::ClearNodes()
     {
         node_.clear();
+        index_.Clear();
     }
 
     void CompositeNode::SetCollision(int val) {
@@ -94,4 +119,12 @@ namespace game {
         }
         return 0;
     }
+
+    // Nodes were added after their parents, so a single pass resolves the hierarchy
+    void CompositeNode::UpdateTransforms() {
+        root_->UpdateTransform();
+        for (int i = 0; i < node_.size(); i++) {
+            node_[i]->UpdateTransform();
+        }
+    }
 }
\ No newline at end of file
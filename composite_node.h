@@ -11,6 +11,8 @@
 #define COMPOSITE_NODE_H
 
 #include "scene_node.h"
+#include "name_index.h"
+#include "entity_handle.h"
 #include <vector>
 
 namespace game {
@@ -26,18 +28,25 @@ namespace game {
 		// Create a named composite node
 		CompositeNode(const std::string name);
 		~CompositeNode();
+
+		// Composite nodes are allocated from a slab pool (see node_pool.h)
+		static void* operator new(std::size_t size);
+		static void operator delete(void* p, std::size_t size);
+		// Return the pool's memory to the system; only does anything once every composite node is deleted
+		static void ReleasePool(void);
 		
 		// Methods
 		// Add an already-created node
 		void AddNode(SceneNode* node);
 		
 		// Getters
-		SceneNode* GetNode(std::string node_name) const;
+		SceneNode* GetNode(std::string_view node_name) const;
 		SceneNode* GetNode(int index) const;
-		inline std::vector<SceneNode*> GetAllNodes() const { return node_; }
+		inline const std::vector<SceneNode*>& GetAllNodes() const { return node_; }
 		inline std::string GetName(void) const { return name_; }
 		SceneNode* GetRoot() const;
 		Type GetType() const { return t_; }
+		EntityHandle GetHandle() const { return handle_; }
 		std::vector<SceneNode*>::const_iterator begin() const;
 		std::vector<SceneNode*>::const_iterator end() const;
 
@@ -46,6 +55,7 @@ namespace game {
 		// Setters
 		void SetRoot(SceneNode* root);
 		void SetType(Type type) { t_ = type; }
+		void SetHandle(EntityHandle handle) { handle_ = handle; } // Assigned by the scene graph
 
 		// Collision
 		void SetCollision(int val);
@@ -64,14 +74,19 @@ namespace game {
 		// Update all nodes
 		int Update(Camera* camera);
 
+		// Compute world transformations of the root and all nodes (parents before children)
+		void UpdateTransforms();
+
 		std::vector<SceneNode*> hitboxes_;
 
 	private:
 		std::string name_;
 		std::vector<SceneNode*> node_;
+		NameIndex<SceneNode> index_; // Name lookup for node_
 		SceneNode* root_ = nullptr;
 		Type t_ = None; // Object type
 		int collision_ = 0;
+		EntityHandle handle_; // Handle in the scene graph that owns this node
 	};
 
 }
@@ -0,0 +1,28 @@
+/*
+ *
+ * Handle to an object owned by the scene graph. A handle stays valid only as long as the object
+ * it was issued for: once the object is destroyed its slot is reused with a new generation, so old
+ * handles simply stop resolving instead of pointing at whatever took the slot.
+ *
+ */
+#ifndef ENTITY_HANDLE_H_
+#define ENTITY_HANDLE_H_
+
+#include <cstdint>
+
+namespace game {
+
+    struct EntityHandle {
+        uint32_t index = 0xFFFFFFFF; // Slot in the owner's slot table
+        uint32_t generation = 0; // Generation of the slot when the handle was issued
+
+        // True for a handle that was never assigned
+        inline bool IsNull(void) const { return index == 0xFFFFFFFF; }
+
+        inline bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+        inline bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+    };
+
+} // namespace game
+
+#endif // ENTITY_HANDLE_H_
@@ -0,0 +1,78 @@
+#include "entity_registry.h"
+
+namespace game {
+
+    EntityRegistry::EntityRegistry(void) {
+    }
+
+
+    EntityHandle EntityRegistry::Create(void) {
+
+        EntityHandle entity;
+
+        // Reuse a free slot if there is one
+        if (!free_.empty()) {
+            entity.index = free_.back();
+            free_.pop_back();
+        }
+        else {
+            entity.index = generation_.size();
+            generation_.push_back(0);
+            alive_.push_back(0);
+        }
+
+        entity.generation = generation_[entity.index];
+        alive_[entity.index] = 1;
+        return entity;
+    }
+
+
+    void EntityRegistry::Destroy(EntityHandle entity) {
+
+        if (!IsAlive(entity)) {
+            return;
+        }
+
+        transform_.Remove(entity);
+        renderable_.Remove(entity);
+        collider_.Remove(entity);
+        animator_.Remove(entity);
+        collectible_.Remove(entity);
+        hazard_.Remove(entity);
+        solid_.Remove(entity);
+        emitter_.Remove(entity);
+
+        // A new generation makes every handle to this slot stale
+        alive_[entity.index] = 0;
+        generation_[entity.index]++;
+        free_.push_back(entity.index);
+    }
+
+
+    bool EntityRegistry::IsAlive(EntityHandle entity) const {
+
+        return entity.index < generation_.size() && alive_[entity.index] && generation_[entity.index] == entity.generation;
+    }
+
+
+    void EntityRegistry::Clear(void) {
+
+        transform_.Clear();
+        renderable_.Clear();
+        collider_.Clear();
+        animator_.Clear();
+        collectible_.Clear();
+        hazard_.Clear();
+        solid_.Clear();
+        emitter_.Clear();
+
+        for (int i = 0; i < generation_.size(); i++) {
+            if (alive_[i]) {
+                alive_[i] = 0;
+                generation_[i]++;
+                free_.push_back(i);
+            }
+        }
+    }
+
+} // namespace game
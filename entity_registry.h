@@ -0,0 +1,182 @@
+/*
+ *
+ * Entity-component storage. Entities are EntityHandles; each kind of component is kept in its own
+ * densely packed array so a system only walks the entities that actually have its component
+ * (e.g. collision only visits colliders instead of every node in the scene).
+ *
+ */
+#ifndef ENTITY_REGISTRY_H_
+#define ENTITY_REGISTRY_H_
+
+#include <cstdint>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "entity_handle.h"
+
+namespace game {
+
+    class CompositeNode;
+
+    // Components
+    // The composite node whose root holds the entity's transformation
+    struct Transform {
+        CompositeNode* node;
+    };
+
+    // Drawn by the scene graph
+    struct Renderable {
+        CompositeNode* node;
+    };
+
+    // Collision layers; two colliders are only tested if each one's layer is in the other's mask
+    enum CollisionLayer : uint32_t {
+        LayerPlayer = 1 << 0,
+        LayerCollectible = 1 << 1,
+        LayerHazard = 1 << 2,
+        LayerAll = 0xFFFFFFFF
+    };
+
+    // Sphere around the root node; with hitboxes set, the node's hitboxes are used for hazards instead
+    struct Collider {
+        CompositeNode* node;
+        bool hitboxes;
+        uint32_t layer; // CollisionLayer bit of this collider
+        uint32_t mask; // Layers it collides with
+    };
+
+    // Procedural animation run by Manipulator::AnimateAll
+    struct Animator {
+        enum Kind { Sway, Submarine };
+        CompositeNode* node;
+        Kind kind;
+    };
+
+    // Picked up on contact (mechanical parts)
+    struct Collectible {
+        CompositeNode* node;
+    };
+
+    // Costs the player oxygen on contact. Switched hazards only hurt while their node's collision is on (vents)
+    struct Hazard {
+        CompositeNode* node;
+        float damage;
+        bool switched;
+    };
+
+    // Solid geometry for ray and segment queries (line of sight, picking, camera blocking).
+    // With triangles set, rays are tested against the meshes instead of the bounding box;
+    // dynamic solids have their bounds refitted every frame
+    struct Solid {
+        CompositeNode* node;
+        bool triangles;
+        bool dynamic;
+    };
+
+    // Particle system; follow_camera keeps it at the camera position plus offset
+    struct ParticleEmitter {
+        CompositeNode* node;
+        bool follow_camera;
+        glm::vec3 offset;
+    };
+
+
+    // Densely packed components of one type, indexed by entity
+    template <typename T>
+    class ComponentArray {
+
+        public:
+            // Give an entity the component (replaces the existing one)
+            void Add(EntityHandle entity, const T& component) {
+                if (entity.index >= sparse_.size()) {
+                    sparse_.resize(entity.index + 1, -1);
+                }
+                int i = sparse_[entity.index];
+                if (i >= 0) {
+                    dense_[i] = component;
+                    entity_[i] = entity;
+                    return;
+                }
+                sparse_[entity.index] = dense_.size();
+                dense_.push_back(component);
+                entity_.push_back(entity);
+            }
+
+            // Take the component away; the last component takes its place
+            void Remove(EntityHandle entity) {
+                if (!Has(entity)) {
+                    return;
+                }
+                int i = sparse_[entity.index];
+                int last = dense_.size() - 1;
+                dense_[i] = dense_[last];
+                entity_[i] = entity_[last];
+                sparse_[entity_[i].index] = i;
+                dense_.pop_back();
+                entity_.pop_back();
+                sparse_[entity.index] = -1;
+            }
+
+            bool Has(EntityHandle entity) const {
+                return entity.index < sparse_.size() && sparse_[entity.index] >= 0 && entity_[sparse_[entity.index]] == entity;
+            }
+
+            // Component of an entity, or NULL
+            T* Get(EntityHandle entity) {
+                return Has(entity) ? &dense_[sparse_[entity.index]] : NULL;
+            }
+
+            void Clear(void) {
+                sparse_.clear();
+                dense_.clear();
+                entity_.clear();
+            }
+
+            // Iteration over the packed components
+            int GetSize(void) const { return dense_.size(); }
+            T& operator[](int i) { return dense_[i]; }
+            const T& operator[](int i) const { return dense_[i]; }
+            EntityHandle GetEntity(int i) const { return entity_[i]; }
+
+        private:
+            std::vector<int> sparse_; // Entity index -> position in dense_, -1 if absent
+            std::vector<T> dense_;
+            std::vector<EntityHandle> entity_; // Owner of each entry in dense_
+    };
+
+
+    // Allocates entities and owns all component arrays
+    class EntityRegistry {
+
+        public:
+            EntityRegistry(void);
+
+            // Create an entity with no components
+            EntityHandle Create(void);
+            // Remove all components of an entity and invalidate its handle
+            void Destroy(EntityHandle entity);
+            bool IsAlive(EntityHandle entity) const;
+            // Destroy every entity
+            void Clear(void);
+
+            // Component arrays
+            ComponentArray<Transform> transform_;
+            ComponentArray<Renderable> renderable_;
+            ComponentArray<Collider> collider_;
+            ComponentArray<Animator> animator_;
+            ComponentArray<Collectible> collectible_;
+            ComponentArray<Hazard> hazard_;
+            ComponentArray<Solid> solid_;
+            ComponentArray<ParticleEmitter> emitter_;
+
+        private:
+            std::vector<uint32_t> generation_; // Current generation of every entity slot
+            std::vector<char> alive_;
+            std::vector<uint32_t> free_;
+
+    }; // class EntityRegistry
+
+} // namespace game
+
+#endif // ENTITY_REGISTRY_H_
@@ -1,8 +1,11 @@
 #include <iostream>
+#include <random>
 #include <time.h>
 #include <sstream>
 #include "game.h"
 #include "path_config.h"
+#include "height_map.h"
+#include "prop_scatter.h"
 
 namespace game {
     // Configuration constants
@@ -22,6 +25,40 @@ namespace game {
 
     // Materials 
     const std::string material_directory_g = MATERIAL_DIRECTORY;
+    // Width of a streamed world chunk (must match the size given to scene_converter)
+    const float world_chunk_size_g = 50.0f;
+    // Steepest height difference along a terrain cell edge the player can walk over
+    const float max_walk_slope_g = 1.0f;
+    // Height of the brightest height map value (255 / 8 as with the original 8 bit maps)
+    const float max_map_height_g = 255.0f / 8.0f;
+    // Height error allowed when simplifying terrain meshes
+    const float max_terrain_error_g = 0.05f;
+
+    // Props scattered over the floor, drawn in batches (Game::ScatterProps)
+    struct PropLayer {
+        const char* name;
+        const char* object;
+        const char* texture;
+        glm::vec3 color;
+        float spacing; // Least distance between two props
+        float min_height; // Floor heights the props are found at
+        float max_height;
+        float max_slope;
+        float min_scale;
+        float max_scale;
+        float min_stretch; // Extra vertical scale
+        float max_stretch;
+        float lift; // Part of the prop's height above the floor (0.5 for meshes centred on their origin)
+        float extent; // Reach of the mesh from its origin
+    };
+    const PropLayer prop_layer_g[] = {
+        { "ScatteredRocks", "PropSphere", "NormalMapRock", glm::vec3(0.6, 0.6, 0.65), 3.0f, 0.0f, 10.0f, 2.0f, 0.2f, 0.7f, 0.5f, 0.8f, 0.2f, 1.0f },
+        { "ScatteredKelp", "LowPolyCylinder", "NormalMapGrass", glm::vec3(0.5, 0.8, 0.4), 2.5f, 5.5f, 8.0f, 1.0f, 0.15f, 0.3f, 8.0f, 20.0f, 0.5f, 0.8f },
+        { "ScatteredCoral", "StalagmiteSpike", "NormalMapCoral", glm::vec3(1.0, 0.5, 0.5), 4.0f, 5.5f, 8.0f, 0.8f, 0.4f, 1.0f, 1.0f, 2.5f, 0.5f, 0.8f },
+        { "ScatteredAnemones", "PropSphere", "NormalMapCoral", glm::vec3(1.0, 0.9, 0.3), 5.0f, 1.0f, 7.0f, 0.8f, 0.2f, 0.4f, 0.6f, 1.0f, 0.3f, 1.0f }
+    };
+    // Same props every run
+    const uint32_t prop_seed_g = 3535;
 
     Manipulator* manipulator = new Manipulator();
 
@@ -42,6 +79,12 @@ namespace game {
         SoundEngine = irrklang::createIrrKlangDevice();
         SoundEngine->play2D((MATERIAL_DIRECTORY + std::string("\\audio\\stranded.mp3")).c_str(), true);
 
+        // Objects built by the manipulator become entities of the scene
+        manipulator->SetRegistry(&scene_.GetRegistry());
+        // Scene nodes refer to their resources by handle
+        SceneNode::SetResourceManager(&resman_);
+
+        SetupFrameGraph();
     }
 
     void Game::InitWindow(void) {
@@ -120,52 +163,27 @@ namespace game {
 
     void Game::SetupResources(void) {
         // POPULATE HEIGHT MAP ARRAY
-        std::ifstream height_file;
+        // Binary/ASCII PGM, PNG or raw floats; the size of the playing field comes from the maps
+        HeightMap height_file;
+        HeightMap collision_file;
         try {
-            height_file.open(material_directory_g + "\\height_map.pgm");
-            if (!height_file.is_open()) {
-                throw std::ios_base::failure("Error opening height_map.pgm");
-            }
+            height_file.Open(material_directory_g + "\\height_map.pgm");
+            collision_file.Open(material_directory_g + "\\collision_map.pgm");
         }
         catch (const std::ios_base::failure& e) {
             std::cout << e.what();
             std::exit(1);
         }
 
-        std::ifstream collision_file;
-        try {
-            collision_file.open(material_directory_g + "\\collision_map.pgm");
-            if (!collision_file.is_open())
-            {
-                throw std::ios_base::failure("Error opening collision_map.pgm");
-            }
-        }
-        catch (const std::ios_base::failure& e) {
-            std::cout << e.what();
-            std::exit(1);
-        }
-        
-
         // Setup drawing to texture
         scene_.SetupDrawToTexture();
 
-        // CHECK FORMATTING; ONLY ACCEPT PGM FILES
-        // PGM FILES START WITH P2 AND ARE FOLLOWED BY THEIR WIDTH x HEIGHT DIMENSIONS
-        // THE REST OF THE FILE CONTAINS THE VERTEX DATA
-        std::string magic_number;
-        std::string comment;
-        int width, height, max_value;
-
-        height_file >> magic_number >> width >> height >> max_value;
-        if (magic_number != "P2" || width != plane_size_.x || height != plane_size_.y || max_value != 255) {
-            throw std::invalid_argument("Invalid PGM file format or dimensions");
-        }
-
-        collision_file >> magic_number >> width >> height >> max_value;
-
-        if (magic_number != "P2" || width != plane_size_.x || height != plane_size_.y || max_value != 255) {
-            throw std::invalid_argument("Invalid PGM file format or dimensions");
+        int width = height_file.GetWidth();
+        int height = height_file.GetDepth();
+        if (width < 2 || height < 2 || collision_file.GetWidth() != width || collision_file.GetDepth() != height) {
+            throw std::invalid_argument("Height and collision maps must have the same size");
         }
+        plane_size_ = glm::ivec2(width, height);
 
         height_map_.reserve(width * height);
         height_map_boundary_.reserve(width * height);
@@ -176,35 +194,43 @@ namespace game {
         srand(3535);
         // Generate random starting values
         
-        for (int z = 0; z < height_map_.capacity() && z < height_map_boundary_.capacity(); z++) {
+        for (int z = 0; z < width * height; z++) {
             height_map_.insert(height_map_.end(), rand() / (float)(RAND_MAX / 0.5)); // Random height between 0 to 2.0
             height_map_boundary_.insert(height_map_boundary_.end() , -0.1f - (float)(rand() / (RAND_MAX))); // -0.1 to -1.1
             height_map_collision_.insert(height_map_collision_.end(), -0.1f - (float)(rand() / (RAND_MAX)));
         }
-    height_map_.resize(height_map_.capacity());
-    height_map_boundary_.resize(height_map_boundary_.capacity());
-    height_map_collision_.resize(height_map_collision_.capacity());
     // Set heights
     
-    float h = 0;
-    for (int z = 0; z < height_map_boundary_.size() / width; ++z) {
-        for (int x = 0; x < height_map_boundary_.size() / height; ++x) {
-            height_file >> h;
-            height_map_boundary_[x + width*z] += h/8; // max height is 16 (255/16) ~= 15.9
+    for (int z = 0; z < height; ++z) {
+        for (int x = 0; x < width; ++x) {
+            height_map_boundary_[x + width*z] += height_file.GetHeight(x, z, max_map_height_g);
+            height_map_collision_[x + width * z] += collision_file.GetHeight(x, z, max_map_height_g);
         }
     }
-    height_file.close();
+    height_file.Close();
+    collision_file.Close();
+     
+    // One copy of the walkable ground, shared by the camera, object placement and collision
+    std::vector<float> ground(width * height);
+    for (int i = 0; i < ground.size(); i++) {
+        ground[i] = std::max(height_map_[i], height_map_collision_[i]);
+    }
+    terrain_.Init(std::move(ground), width, height, glm::vec2(-offsetX, -offsetZ));
+    camera_.SetTerrain(&terrain_);
 
-    for (int z = 0; z < height_map_collision_.size() / width; ++z)
-    {
-        for (int x = 0; x < height_map_boundary_.size() / height; ++x) {
-            collision_file >> h;
-            height_map_collision_[x + width * z] += h / 8;
+    // Where the ground is walkable, cached next to the collision map (rebuilt when the maps change)
+    std::string walk_field_file = material_directory_g + "\\collision_map.walk";
+    if (!walk_field_.Load(walk_field_file, terrain_, max_walk_slope_g)) {
+        walk_field_.Build(terrain_, max_walk_slope_g);
+        try {
+            walk_field_.Save(walk_field_file);
+        }
+        catch (const std::ios_base::failure& e) {
+            std::cout << e.what() << std::endl; // Only slower the next time
         }
     }
-     
-    camera_.SetDimensions(offsetX, offsetZ, width, height);
-    camera_.SetHeightMap(height_map_, height_map_collision_);
+    camera_.SetWalkField(&walk_field_);
+    manipulator->SetTerrain(&terrain_);
     
   
     // SHAPES
@@ -232,14 +258,38 @@ namespace game {
     resman_.CreateSphere("Rock_Sphere", 2, 40, 20);
     // Seaweed
     resman_.CreateCylinder("LowPolyCylinder", 1.0, 0.6, 10, 9);
+    // Scattered props (thousands of copies each)
+    resman_.CreateSphere("PropSphere", 1.0, 12, 8);
     // Skybox
     resman_.CreateInvertedSphere("SkyBox", 700, 300, 150);
-    // Plane
-    resman_.CreatePlane("Plane", height_map_, height_map_.size() / width, height_map_.size() / height, offsetX, offsetZ);
-    resman_.CreatePlane("Boundary", height_map_boundary_, height_map_boundary_.capacity() / width, height_map_boundary_.capacity() / height, offsetX, offsetZ);
+    // Textures are decoded on the scene's worker threads
+    resman_.SetThreadPool(&scene_.GetThreadPool());
+    // Floor: one patch grid drawn at every level of detail, displaced by the heights
+    resman_.CreateTerrainGrid("TerrainGrid", 32);
+    resman_.CreateHeightTexture("PlaneHeights", height_map_, width, height);
+    // Boundary: mostly under the floor, so a static mesh of the parts that show is cheaper
+    resman_.CreateSimplifiedPlane("Boundary", height_map_boundary_, height, width, width / 2, height / 2, max_terrain_error_g, &height_map_);
+
+    const std::string normal_map = std::string(MATERIAL_DIRECTORY) + std::string("/normal_map");
+    resman_.LoadResource(Material, "NormalMapMaterial", normal_map.c_str());
+
+    // Shaded like the other normal-mapped meshes, only the vertex stage differs
+    std::string filename = std::string(MATERIAL_DIRECTORY) + std::string("/terrain_lod");
+    resman_.LoadMaterial("TerrainLodMaterial", filename.c_str(), normal_map.c_str());
+
+    // With OpenGL 4 the floor is tessellated on the GPU from a coarse patch grid instead (the
+    // boundary stays a simplified mesh)
+    if (GLEW_VERSION_4_0) {
+        resman_.CreatePatchGrid("TerrainPatchGrid", 16);
+        filename = std::string(MATERIAL_DIRECTORY) + std::string("/terrain_tess");
+        resman_.LoadMaterial("TerrainTessMaterial", filename.c_str(), normal_map.c_str());
+    }
 
-    std::string filename = std::string(MATERIAL_DIRECTORY) + std::string("/normal_map");
-    resman_.LoadResource(Material, "NormalMapMaterial", filename.c_str());
+    // Instanced props need OpenGL 3.3; without it the floor is left bare
+    if (GLEW_VERSION_3_3) {
+        filename = std::string(MATERIAL_DIRECTORY) + std::string("/prop_batch");
+        resman_.LoadResource(Material, "PropBatchMaterial", filename.c_str());
+    }
 
     // SCREENSPACE
     filename = std::string(MATERIAL_DIRECTORY) + std::string("/screen_space");
@@ -350,6 +400,11 @@ namespace game {
     // Create particles
     resman_.CreateSphereParticles("SphereParticles");
     resman_.CreateSphereParticles("SphereParticlesBubbles", 10);
+
+    // Resources used every frame
+    screen_material_ = resman_.GetMaterialHandle("ScreenSpaceMaterial");
+    bubble_texture_ = resman_.GetTextureHandle("BubbleTexture");
+    gear_texture_ = resman_.GetTextureHandle("GearTexture");
 }
 
 void Game::SetupScene(void)
@@ -361,82 +416,74 @@ void Game::SetupScene(void)
 }
 
 void Game::PopulateWorld(void) {
-    //scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite1", glm::vec3(10, 0, -10)));
-    //scene_.GetNode("Stalagmite1")->Rotate(glm::angleAxis(glm::pi<float>(), glm::vec3(0, 0, 1)));
-
-    scene_.AddNode(manipulator->ConstructSubmarine(&resman_, "Submarine", glm::vec3(-17, 7.5, -33)));
-    scene_.GetNode("Submarine")->Rotate(glm::angleAxis(glm::pi<float>(), glm::vec3(1, 1, 1)));
-
-    //CREATE COLLECTIBLE MECHANICAL PARTS
-    scene_.AddNode(manipulator->ConstructPart(&resman_, "Mechanical_Part1", glm::vec3(-23.5, 15.9, -73.3)));
-    scene_.AddNode(manipulator->ConstructPart(&resman_, "Mechanical_Part2", glm::vec3(-74.2, 5.0, 89.2)));
-    scene_.AddNode(manipulator->ConstructPart(&resman_, "Mechanical_Part3", glm::vec3(-74.07, 5.0, -75.85)));
-    scene_.AddNode(manipulator->ConstructPart(&resman_, "Mechanical_Part4", glm::vec3(19.44, 17.85, 83.95)));
-    scene_.AddNode(manipulator->ConstructPart(&resman_, "Mechanical_Part5", glm::vec3(81.98, 5.0, -26.343)));
-    
 
-   //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie", glm::vec3(0, 2, 0)));
+    // Everything placed in the world comes from the scene files (converted from world.txt)
+    // Objects that are always present (e.g. the bubbles following the player)
+    SceneFile world;
+    world.Open(material_directory_g + std::string("/world/world.scene"));
+    manipulator->ConstructWorld(&resman_, &scene_, world);
+    ScatterProps();
+
+    // The rest is streamed in chunks around the player
+    streamer_.Init(material_directory_g + std::string("/world/world"), world_chunk_size_g, glm::vec2(-plane_size_.x / 2, -plane_size_.y / 2), glm::vec2(plane_size_.x / 2, plane_size_.y / 2));
+    streamer_.SetRadius(75.0f, 100.0f);
+    // Height tiles raise the ground the camera walks on and collides with
+    streamer_.SetGround(&terrain_, &walk_field_);
+    streamer_.LoadAround(camera_.GetPosition(), &scene_, &resman_, manipulator);
+}
 
-  // scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie", glm::vec3(0, 2, 0)));
+void Game::ScatterProps(void) {
 
-    //scene_.AddNode(manipulator->ConstructSeaweed(&resman_, "Seaweed1", 4, glm::vec3(0, 0, -5)));
+    if (!resman_.GetResource("PropBatchMaterial")) {
+        return;
+    }
 
-    //PLACE GEORGE'S PLANT
-    
-    //
-    scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp1", 4, glm::vec3(3.84, 0.0, -38.37))); 
-    //scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp2", 4, glm::vec3(-42.6, 0.0, -13.96)));
-    scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp3", 4, glm::vec3(4.9, 0.0, 14.03)));
-    
-    //scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp4", 4, glm::vec3(74.54, 0.0, -86.53)));
-    scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp5", 4, glm::vec3(73.77, 0.0, 87.39)));
-    //scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp6", 4, glm::vec3(87.15, 0.0, 32.46)));
-    scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp7", 4, glm::vec3(-17.5, 0.0, 47.9)));
-    //scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp8", 4, glm::vec3(10.09, 0.0, -62.77)));
-    scene_.AddNode(manipulator->ConstructKelp(&resman_, "Kelp9", 4, glm::vec3(-69.82, 0.0, -35.23)));
-    //
-    //PLACE CORAL
-    scene_.AddNode(manipulator->ConstructCoral(&resman_, "Coral1", glm::vec3(-31.67, 1.6, 0.343))); //
-    //
-    //scene_.AddNode(manipulator->ConstructCoral(&resman_, "Coral2", glm::vec3(-11.26, 1.6, 9.43)));
-    scene_.AddNode(manipulator->ConstructCoral(&resman_, "Coral3", glm::vec3(62.44, 1.6, 62.33)));
-    //scene_.AddNode(manipulator->ConstructCoral(&resman_, "Coral4", glm::vec3(49.37, 1.6, 18.47)));
-    scene_.AddNode(manipulator->ConstructCoral(&resman_, "Coral5", glm::vec3(73.73, 1.6, -57.04)));
-    //scene_.AddNode(manipulator->ConstructCoral(&resman_, "Coral6", glm::vec3(-20.59, 1.6, 87.86)));
-    scene_.AddNode(manipulator->ConstructCoral(&resman_, "Coral7", glm::vec3(-81.3, 1.6, -6.87)));
-    //
-    //PLACE ANEMONIES
-    
-     // 
-    //scene_.AddNode(manipulator->ConstructSeaweed(&resman_, "Seaweed1", 4, glm::vec3(-3,0,6)));
-    //
-    //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie1", glm::vec3(14.49, 0, -33.57)));
-    scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie2", glm::vec3(-39.42, 0, 24.37)));
-    //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie3", glm::vec3(6.47, 0, 36.26)));
-    scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie4", glm::vec3(-40.20, 0, 74.84)));
-    //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie5", glm::vec3(-73.08, 0, 52.47)));
-    scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie6", glm::vec3(-61.06, 0, 4.78)));
-    //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie7", glm::vec3(19.41, 0, -86.87)));
-    scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie8", glm::vec3(88.29, 0, 74.85)));
-    //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie9", glm::vec3(86.76, 0, 70.89)));
-    scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie10", glm::vec3(53.37, 0, 85.80)));
-    //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie11", glm::vec3(20.32, 0, -32.43)));
-    scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie12", glm::vec3(9.75, 0, -34.95)));
-    //scene_.AddNode(manipulator->ConstructAnemonie(&resman_, "Anemonie13", glm::vec3(-36.17, 1, -24.05)));
-
-    manipulator->ConstructSeaweedPatch(&resman_, &scene_, 5, 20, 20, glm::vec3(40.87, 0, -55.81));
-    
-    // Create particles
-    //PARTICLE SYSTEM FOR MECHANICAL PARTS
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "ParticleStarInstance1", "ParticleStarMaterial", "StarTexture", glm::vec3(-23.5, 15.9, -73.3)));
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "ParticleStarInstance2", "ParticleStarMaterial", "StarTexture", glm::vec3(-74.2, 5.0, 89.2)));
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "ParticleStarInstance3", "ParticleStarMaterial", "StarTexture", glm::vec3(-74.07, 5.0, -75.85)));
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "ParticleStarInstance4", "ParticleStarMaterial", "StarTexture", glm::vec3(19.44, 17.85, 83.95)));
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "ParticleStarInstance5", "ParticleStarMaterial", "StarTexture", glm::vec3(81.98, 5.0, -26.343)));
-    //scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "ParticleInstance3", "ParticleGeyserMaterial", "SmokeTexture", glm::vec3(-3, 2, 0)));
-
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticlesBubbles", "BubbleParticles", "ParticleBubbleMaterial", "BubbleTexture", glm::vec3(0, 3, 0)));
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "FishMesh", "FishParticleInstance1", "MeshParticleMaterial", "FishTexture", glm::vec3(7, 10, 7)));
+    // Nothing grows where the collision map rises above the floor (walls and obstacles)
+    int width = terrain_.GetWidth();
+    int depth = terrain_.GetDepth();
+    std::vector<float> exclusion((size_t)(width - 1) * (depth - 1), 0.0f);
+    for (int z = 0; z < depth - 1; z++) {
+        for (int x = 0; x < width - 1; x++) {
+            for (int corner = 0; corner < 4; corner++) {
+                int i = (x + (corner & 1)) + width * (z + (corner >> 1));
+                if (height_map_collision_[i] > height_map_[i] + 0.1f) {
+                    exclusion[x + (width - 1) * z] = 1.0f;
+                }
+            }
+        }
+    }
+
+    for (int layer = 0; layer < sizeof(prop_layer_g) / sizeof(prop_layer_g[0]); layer++) {
+        const PropLayer& props = prop_layer_g[layer];
+
+        PropScatter scatter;
+        scatter.Init(PropScatter::DensityFromTerrain(terrain_, props.min_height, props.max_height, props.max_slope), width - 1, depth - 1, terrain_.GetOrigin());
+        scatter.Exclude(exclusion);
+        std::vector<glm::vec2> position;
+        scatter.Scatter(props.spacing, prop_seed_g + layer, &scene_.GetThreadPool(), position);
+        if (position.empty()) {
+            continue;
+        }
+
+        std::vector<float> x(position.size()), z(position.size()), ground(position.size());
+        for (int i = 0; i < position.size(); i++) {
+            x[i] = position[i].x;
+            z[i] = position[i].y;
+        }
+        terrain_.GetHeights(x.data(), z.data(), ground.data(), position.size());
+
+        std::mt19937 random(prop_seed_g + layer);
+        auto uniform = [&random](float low, float high) { return low + (high - low) * (float)(random() >> 8) * (1.0f / 16777216.0f); };
+        std::vector<PropInstance> instance(position.size());
+        for (int i = 0; i < position.size(); i++) {
+            PropInstance& prop = instance[i];
+            prop.scale = uniform(props.min_scale, props.max_scale);
+            prop.stretch = uniform(props.min_stretch, props.max_stretch);
+            prop.yaw = uniform(0.0f, glm::two_pi<float>());
+            prop.position = glm::vec3(x[i], ground[i] + props.lift * prop.scale * prop.stretch, z[i]);
+        }
+        scene_.AddNode(manipulator->ConstructPropField(&resman_, props.name, props.object, props.texture, instance, props.extent, props.color));
+    }
 }
 
 void Game::SetupGameScreen(void)
@@ -444,10 +491,14 @@ void Game::SetupGameScreen(void)
 
     camera_.SetTimer(500); // Starting player time limit / oxygen
 
+    // Collision index over the playing field (centred on the origin like the floor)
+    scene_.GetSpatialGrid().Init(glm::vec2(-plane_size_.x / 2, -plane_size_.y / 2), glm::vec2(plane_size_.x / 2, plane_size_.y / 2), 10.0f);
+
     scene_.SetBackgroundColor(viewport_background_color_g);
     scene_.AddNode(manipulator->ConstructSkyBox(&resman_, "Sky_Box", glm::vec3(0, 3, 0)));
 
-    scene_.AddNode(manipulator->ConstructPlane(&resman_)); // "Plane" | sandy floor
+    glm::vec2 origin(-plane_size_.x / 2, -plane_size_.y / 2); // Same place as the terrain
+    scene_.AddNode(manipulator->ConstructPlane(&resman_, height_map_, plane_size_.x, plane_size_.y, origin)); // "Plane" | sandy floor
 
     scene_.AddNode(manipulator->ConstructBoundary(&resman_)); // "Boundary" | stone walls
 
@@ -455,61 +506,9 @@ void Game::SetupGameScreen(void)
 
     PopulateWorld();
 
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticlesBubbles", "BubbleParticles", "ParticleBubbleMaterial", "BubbleTexture", glm::vec3(0, 3, 0)));
-
-
-    // Hydrothermal vents
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "Vent1", "ParticleGeyserMaterial", "BubbleTexture", glm::vec3(-71, 0, -23)));
-    scene_.GetNode("Vent1")->Scale(glm::vec3(15.0, 1.0, 15.0));
-    scene_.GetNode("Vent1")->SetType(CompositeNode::Type::Vent);
-    scene_.AddNode(manipulator->ConstructVentBase(&resman_, "VentBase1", glm::vec3(-71, 0, -23)));
-
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "Vent2", "ParticleGeyserMaterial", "BubbleTexture", glm::vec3(-79.7, 0, -23)));
-    scene_.GetNode("Vent2")->Scale(glm::vec3(15.0, 1.0, 15.0));
-    scene_.GetNode("Vent2")->SetType(CompositeNode::Type::Vent);
-    scene_.AddNode(manipulator->ConstructVentBase(&resman_, "VentBase2", glm::vec3(-79.7, 0, -23)));
-
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "Vent3", "ParticleGeyserMaterial", "BubbleTexture", glm::vec3(-79.6, 0, -44.2)));
-    scene_.GetNode("Vent3")->Scale(glm::vec3(15.0, 1.0, 15.0));
-    scene_.GetNode("Vent3")->SetType(CompositeNode::Type::Vent);
-    scene_.AddNode(manipulator->ConstructVentBase(&resman_, "VentBase3", glm::vec3(-79.6, 0, -44.2)));
-
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "Vent4", "ParticleGeyserMaterial", "BubbleTexture", glm::vec3(-70, 0, -44.2)));
-    scene_.GetNode("Vent4")->Scale(glm::vec3(15.0, 1.0, 15.0));
-    scene_.GetNode("Vent4")->SetType(CompositeNode::Type::Vent);
-    scene_.AddNode(manipulator->ConstructVentBase(&resman_, "VentBase4", glm::vec3(-70, 0, -44.2)));
-
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "Vent5", "ParticleGeyserMaterial", "BubbleTexture", glm::vec3(-69.3, 0, -61.7)));
-    scene_.GetNode("Vent5")->Scale(glm::vec3(15.0, 1.0, 15.0));
-    scene_.GetNode("Vent5")->SetType(CompositeNode::Type::Vent);
-    scene_.AddNode(manipulator->ConstructVentBase(&resman_, "VentBase5", glm::vec3(-69.3, 0, -61.7)));
-
-    scene_.AddNode(manipulator->ConstructParticleSystem(&resman_, "SphereParticles", "Vent6", "ParticleGeyserMaterial", "BubbleTexture", glm::vec3(-80.8, 0, -61.5)));
-    scene_.GetNode("Vent6")->Scale(glm::vec3(15.0, 1.0, 15.0));
-    scene_.GetNode("Vent6")->SetType(CompositeNode::Type::Vent);
-    scene_.AddNode(manipulator->ConstructVentBase(&resman_, "VentBase6", glm::vec3(-80.8, 0, -61.5)));
-    /*
-    // Stalagmites
-    scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite1", glm::vec3(85.2, 0, 19.2)));
-    scene_.GetNode("Stalagmite1")->Scale(glm::vec3(0.7, 0.9, 0.7));
-
-    scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite2", glm::vec3(88.6, 0, 3.9)));
-    scene_.GetNode("Stalagmite2")->Scale(glm::vec3(0.8, 0.8, 0.8));
-
-    scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite3", glm::vec3(79.5, 0, -1.5)));
-    scene_.GetNode("Stalagmite3")->Scale(glm::vec3(0.7, 0.7, 0.7));
-
-    scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite4", glm::vec3(80.5, 0, 7.5)));
-    scene_.GetNode("Stalagmite4")->Scale(glm::vec3(0.7, 0.9, 0.7));
-
-    scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite5", glm::vec3(75.5, 0, 13.5)));
-    scene_.GetNode("Stalagmite5")->Scale(glm::vec3(0.6, 1.0, 0.7));
-
-    scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite6", glm::vec3(78.5, 0, 22.5)));
-    scene_.GetNode("Stalagmite6")->Scale(glm::vec3(0.7, 0.7, 0.7));
-      */
-    scene_.AddNode(manipulator->ConstructStalagmite(&resman_, "Stalagmite7", glm::vec3(87.5, 0, -4.0)));
-    scene_.GetNode("Stalagmite7")->Scale(glm::vec3(0.7, 0.7, 0.7));    
+    // Ray queries need the final world transformations of the solids
+    scene_.UpdateTransforms();
+    scene_.GetBvh().Build(&scene_.GetRegistry());
 }
 
 void Game::SetupStartScreen(void)
@@ -518,13 +517,150 @@ void Game::SetupStartScreen(void)
     UpdateStartHUD();
 }
 
+void Game::SetupFrameGraph(void) {
+
+    // Camera movement and the timer only touch the camera
+    TaskGraph::TaskId camera = frame_graph_.AddTask("Camera", [this]() {
+        camera_.DecreaseTimer(frame_delta_); // Decrease remaining player time limit / oxygen
+        frame_last_position_ = camera_.GetPosition();
+        camera_.Update(frame_delta_);
+    });
+
+    // Removes collected parts and moves colliders in the spatial index
+    TaskGraph::TaskId scene_update = frame_graph_.AddTask("SceneUpdate", [this]() {
+        scene_.Update(&camera_, &resman_);
+    });
+
+    // Animators only change the child nodes of their entity, the part rotation only the
+    // orientation of the root, so this can overlap with the spatial index update
+    TaskGraph::TaskId animation = frame_graph_.AddTask("Animation", [this]() {
+        manipulator->AnimateAll(&scene_, frame_time_);
+
+        // rotate the machine parts
+        ComponentArray<Collectible>& parts = scene_.GetRegistry().collectible_;
+        for (int f = 0; f < parts.GetSize(); f++) {
+            parts[f].node->GetRoot()->Rotate(glm::angleAxis(0.1f, glm::vec3(0.2 * sin(frame_time_), 1, 0)));
+        }
+    });
+
+    // Bring in the chunks around the player and drop the ones left behind; uploads meshes,
+    // and adds and removes nodes, so it runs alone on the main thread
+    TaskGraph::TaskId stream = frame_graph_.AddTask("Stream", [this]() {
+        if (streamer_.Update(camera_.GetPosition(), frame_delta_, &scene_, &resman_, manipulator)) {
+            scene_.UpdateTransforms();
+            scene_.GetBvh().Build(&scene_.GetRegistry());
+        }
+    }, true);
+
+    // Stop the player in front of solid geometry (submarine hull, stalagmites) and of terrain
+    // it would pass through (walls while jumping)
+    TaskGraph::TaskId blocking = frame_graph_.AddTask("CameraBlocking", [this]() {
+        scene_.GetBvh().Refit();
+        glm::vec3 movement = camera_.GetPosition() - frame_last_position_;
+        float distance = glm::length(movement);
+        if (distance > 0.0f) {
+            glm::vec3 direction = movement / distance;
+            float reach = distance + camera_.GetRadius();
+            float nearest = INFINITY;
+            RayHit hit;
+            if (scene_.GetBvh().RayCast(frame_last_position_, direction, reach, hit, true)) {
+                nearest = hit.distance;
+            }
+            float ground;
+            if (terrain_.RayCast(frame_last_position_, direction, glm::min(reach, nearest), ground)) {
+                nearest = ground;
+            }
+            if (nearest < INFINITY) {
+                camera_.SetPosition(frame_last_position_ + direction * glm::max(0.0f, nearest - camera_.GetRadius()));
+            }
+        }
+    });
+
+    // Make particle systems such as the passive bubbles follow the player
+    TaskGraph::TaskId particles = frame_graph_.AddTask("Particles", [this]() {
+        ComponentArray<ParticleEmitter>& emitters = scene_.GetRegistry().emitter_;
+        for (int i = 0; i < emitters.GetSize(); i++) {
+            if (emitters[i].follow_camera) {
+                emitters[i].node->SetPosition(camera_.GetPosition() + emitters[i].offset);
+            }
+        }
+    });
+
+    // Check if player collided with any objects on its way this frame (only reads the local
+    // transforms of colliders)
+    TaskGraph::TaskId collision = frame_graph_.AddTask("Collision", [this]() {
+        collision_.CollisionEvents(&camera_, frame_last_position_, &scene_.GetRegistry(), &scene_.GetSpatialGrid());
+    });
+
+    // Hydrothermal vent collision switch, seen by the collision check of the next frame
+    // (the flag is also a shader uniform, so it is set before drawing)
+    TaskGraph::TaskId vents = frame_graph_.AddTask("Vents", [this]() {
+        ComponentArray<Hazard>& hazards = scene_.GetRegistry().hazard_;
+        if (int(frame_time_) % 6 == 0) { // On
+            for (int i = 0; i < hazards.GetSize(); i++) {
+                if (hazards[i].switched) {
+                    hazards[i].node->SetCollision(1);
+                }
+            }
+        }
+        else if (int(frame_time_) % 6 == 3) { // Off
+            for (int i = 0; i < hazards.GetSize(); i++) {
+                if (hazards[i].switched) {
+                    hazards[i].node->SetCollision(0);
+                }
+            }
+        }
+    });
+
+    // World transformations and the list of nodes to draw
+    TaskGraph::TaskId render_list = frame_graph_.AddTask("RenderList", [this]() {
+        scene_.BuildRenderList();
+    });
+
+    // OpenGL submission, sound and UI
+    TaskGraph::TaskId draw = frame_graph_.AddTask("Draw", [this]() {
+        // Names looked up every frame, hashed once at compile time
+        constexpr NameKey sun_key("Sun");
+
+        if (camera_.GetNumParts() != last_num_machine_parts_)
+        {
+            SoundEngine->play2D((MATERIAL_DIRECTORY + std::string("\\audio\\collect_sound.mp3")).c_str(), false);
+            last_num_machine_parts_ = camera_.GetNumParts();
+        }
+
+        SceneNode* world_light = scene_.GetNode(sun_key)->GetRoot();
+        scene_.DrawToTexture(&camera_, world_light);
+
+        const Resource* screen_material = resman_.Resolve(screen_material_);
+        if (screen_material) {
+            scene_.DisplayTexture(&camera_, screen_material->GetResource());
+        }
+
+        // Update ImGui UI
+        UpdateHUD();
+    }, true);
+
+    frame_graph_.AddDependency(camera, stream);
+    frame_graph_.AddDependency(scene_update, stream);
+    frame_graph_.AddDependency(animation, stream);
+    frame_graph_.AddDependency(stream, blocking);
+    frame_graph_.AddDependency(blocking, particles);
+    frame_graph_.AddDependency(blocking, collision);
+    frame_graph_.AddDependency(collision, vents);
+    frame_graph_.AddDependency(particles, render_list);
+    frame_graph_.AddDependency(render_list, draw);
+    frame_graph_.AddDependency(vents, draw);
+}
+
 void Game::MainLoop(void){
+
     double current_time = 0.0f;
     float delta_time = 0.0f;
-    float mytheta = glm::pi<float>() / 64;
     while (!glfwWindowShouldClose(window_)){
 
         current_time = glfwGetTime();
+        // Put in the textures decoded in the background
+        resman_.UpdateTextures();
         if (state_ == start) {
             UpdateStartHUD();
         } 
@@ -538,57 +674,22 @@ void Game::MainLoop(void){
             UpdateLoseHUD();
         }
         else if (state_ == ingame) {
-            SceneNode* world_light = scene_.GetNode("Sun")->GetRoot();
-            float delta_time = 0.0f;
             // Animate the scene
-
             if (animating_) {
-                delta_time = current_time - last_time_;
-
-                //if ((current_time - last_time_) > 0.05) {
-
-                camera_.DecreaseTimer(current_time - last_time_); // Decrease remaining player time limit / oxygen
-
-                scene_.Update(&camera_, &resman_);
-                manipulator->AnimateAll(&scene_, current_time, mytheta);
+                frame_time_ = current_time;
+                frame_delta_ = current_time - last_time_;
 
+                // Independent stages run in parallel, OpenGL work stays on this thread
+                frame_graph_.Run(scene_.GetThreadPool());
 
-                camera_.Update(delta_time);
-
-                scene_.GetNode("BubbleParticles")->SetPosition(camera_.GetPosition() + glm::vec3(0, -0.5, 0.08)); // Make passive bubble particles follow player
-
-                // Check if player collided with any objects
-                for (std::vector<CompositeNode*>::const_iterator iterator = scene_.begin(); iterator != scene_.end(); iterator++) {
-                    collision_.CollisionEventCompositeNode(&camera_, *iterator);
-
-                    if (camera_.GetNumParts() != last_num_machine_parts_)
-                    {
-                        SoundEngine->play2D((MATERIAL_DIRECTORY + std::string("\\audio\\collect_sound.mp3")).c_str(), false);
-                        last_num_machine_parts_ = camera_.GetNumParts();
-                    }
-                }
-                // rotate the machine parts
-                for (int f = 1; f < 6; f++) {
-                    std::string name = "Mechanical_Part";
-                    name += std::to_string(f);
-                    CompositeNode* part = scene_.GetNode(name);
-                    if (part != nullptr) {
-                        float theta = current_time * glm::pi<float>() / 8;
-                        part->GetRoot()->Rotate(glm::angleAxis(0.1f,glm::vec3(0.2*sin(current_time), 1, 0)));
-                    }
-                }
-
-                scene_.DrawToTexture(&camera_, world_light);
-
-                scene_.DisplayTexture(&camera_, resman_.GetResource("ScreenSpaceMaterial")->GetResource());
-
-                // Update ImGui UI
-                UpdateHUD();
+                // Free nodes destroyed this frame
+                scene_.EndFrame();
 
                 if (camera_.GetNumParts() == 5)
                 {
                     animating_ = false;
                     scene_.ClearObj();
+                    streamer_.Clear(&resman_);
                     state_ = win;
                 }
 
@@ -596,20 +697,9 @@ void Game::MainLoop(void){
                 {
                     animating_ = false;
                     scene_.ClearObj();
+                    streamer_.Clear(&resman_);
                     state_ = lose;
                 }
-                // Hydrothermal vent collision switch
-                if (int(current_time) % 6 == 0) { // On
-                    for (int i = 1; i < 7; i++) {
-                        scene_.GetNode("Vent" + std::to_string(i))->SetCollision(1);
-                    }
-                }
-                else if (int(current_time) % 6 == 3) { // Off
-                    for (int i = 1; i < 7; i++) {
-                        scene_.GetNode("Vent" + std::to_string(i))->SetCollision(0);
-                    }
-                }
-                
             }
         }
         glfwPollEvents();
@@ -676,7 +766,8 @@ void Game::KeyCallback(GLFWwindow* window, int key, int scancode, int action, in
                 << "\nFOR: " << forw
                 << "\nSID: " << side
                 << "\n UP: " << up
-                << "\nSPD: " << game->camera_.GetForwardSpeed() << std::endl;
+                << "\nSPD: " << game->camera_.GetForwardSpeed()
+                << "\nPAIRS: " << game->collision_.GetNumPairs() << " collision pairs tested last frame" << std::endl;
 
         }
 
@@ -910,13 +1001,13 @@ void Game::UpdateHUD() {
     // Start GUI effect ----------------------
 
     // First row
-    ImGui::Image((void*)resman_.GetResource("BubbleTexture")->GetResource(), ImVec2(50, 50)); // Bubble icon
+    ImGui::Image((void*)SceneNode::ResolveTexture(bubble_texture_), ImVec2(50, 50)); // Bubble icon
     ImGui::SameLine();
     ImGui::SetCursorPosY(ImGui::GetWindowSize().y * 0.15); // Text offset
     ImGui::Text("OXYGEN: %i", (int)camera_.GetTimer());
 
     // Second row
-    ImGui::Image((void*)resman_.GetResource("GearTexture")->GetResource(), ImVec2(50, 50)); // Gear icon
+    ImGui::Image((void*)SceneNode::ResolveTexture(gear_texture_), ImVec2(50, 50)); // Gear icon
     ImGui::SameLine();
     ImGui::SetCursorPosY(ImGui::GetWindowSize().y * 0.62); // Text offset
     ImGui::Text("PARTS: %i / 5", camera_.GetNumParts(), camera_.GetNumParts());
@@ -19,6 +19,9 @@
 #include "composite_node.h"
 #include "manipulator.h"
 #include "game_collision.h"
+#include "world_streamer.h"
+#include "task_graph.h"
+#include "terrain.h"
 
 namespace game {
 
@@ -50,6 +53,8 @@ namespace game {
             void SetupScene(void);
             //populate world function
             void PopulateWorld(void);
+            // Scatter the decorative props (prop_layer_g) over the floor
+            void ScatterProps(void);
             // Run the game: keep the application active
             void MainLoop(void); 
 
@@ -63,6 +68,10 @@ namespace game {
 
             // Resources available to the game
             ResourceManager resman_;
+            // Resources used every frame, resolved through their handles
+            MaterialHandle screen_material_;
+            TextureHandle bubble_texture_;
+            TextureHandle gear_texture_;
 
             // Camera abstraction
             Camera camera_;
@@ -70,6 +79,16 @@ namespace game {
             // Collision handler
             GameCollision collision_;
 
+            // Loads the world's objects in chunks around the player
+            WorldStreamer streamer_;
+
+            // Stages of an in-game frame, run on the scene's thread pool
+            TaskGraph frame_graph_;
+            // Inputs of the frame graph, set before every run
+            double frame_time_ = 0.0;
+            float frame_delta_ = 0.0f;
+            glm::vec3 frame_last_position_; // Camera position before moving this frame
+
             irrklang::ISoundEngine* SoundEngine;
 
             // Flag to turn animation on/off
@@ -82,11 +101,15 @@ namespace game {
 
             std::set<int> pressed_; // TBR
 
-            // Size of both planes
-            const glm::ivec2 plane_size_ = glm::ivec2(200,200);
+            // Size of both planes (samples of the height maps)
+            glm::ivec2 plane_size_ = glm::ivec2(200,200);
             std::vector<float> height_map_; // height map for the floor
             std::vector<float> height_map_boundary_; // height map for the boundary (stone walls)
             std::vector<float> height_map_collision_;
+            // Ground the player walks on (highest of the floor and the collision map)
+            Terrain terrain_;
+            // Walkability and distance to obstacles on the terrain
+            WalkField walk_field_;
 
             // ImGui io (to retain data)
             ImGuiIO imgui_io_;
@@ -107,6 +130,8 @@ namespace game {
 
             void SetupStartScreen();
             void SetupGameScreen();
+            // Declare the stages of an in-game frame and their dependencies
+            void SetupFrameGraph(void);
             // UI
             void UpdateHUD();
             void UpdateStartHUD();
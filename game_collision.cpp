@@ -6,43 +6,86 @@ namespace game
     GameCollision::GameCollision()
     {
         prev_collision_ = -1.0;
+        player_layer_ = LayerPlayer;
+        player_mask_ = LayerCollectible | LayerHazard;
     }
-    void GameCollision::CollisionEventCompositeNode(Camera* camera, CompositeNode* obj)
-    {
 
-        bool h = false;
-        glm::vec3 position_ = glm::vec3(obj->GetRoot()->GetPosition().x, camera->GetPosition().y, obj->GetRoot()->GetPosition().z);
+    void GameCollision::FindPairs(Camera* camera, glm::vec3 previous_position, EntityRegistry* registry, const SpatialGrid* grid)
+    {
+        // Sphere around the whole movement of this frame; the grid skips layers the player does not collide with
+        glm::vec3 middle = (previous_position + camera->GetPosition()) * 0.5f;
+        float reach = camera->GetRadius() + glm::length(camera->GetPosition() - previous_position) * 0.5f;
+        nearby_.clear();
+        grid->QueryRadius(middle, reach, nearby_, player_mask_);
 
-        if (glm::length(camera->GetPosition() - position_) <= (camera->GetRadius() + obj->GetRoot()->GetRadius()))
+        pairs_.clear();
+        for (int c = 0; c < nearby_.size(); c++)
         {
-            // If we collided with a machine part
-            if (obj->GetType() == 5 && obj->GetRoot()->GetCollision() == 1)
+            EntityHandle entity = nearby_[c];
+            Collider* collider = registry->collider_.Get(entity);
+            if (collider == NULL || !(collider->mask & player_layer_))
             {
-                PlayerMachinePartCollision(camera, obj);
-                return;
+                continue;
             }
+            CompositeNode* obj = collider->node;
 
-            if (obj->GetType() == CompositeNode::Type::Vent && obj->GetCollision() == 1) { // If player is hit by hydrothermal vent stream
-                camera->DecreaseTimer(1);
-                prev_collision_ = glfwGetTime();
+            if (!collider->hitboxes)
+            {
+                pairs_.push_back(CollisionPair{ entity, obj, -1 });
+            }
+            else if (registry->hazard_.Has(entity)) // Only hazards collide through hitboxes (spikes)
+            {
+                for (int i = 0; i < obj->hitboxes_.size(); i++)
+                {
+                    pairs_.push_back(CollisionPair{ entity, obj, i });
+                }
             }
-            
         }
+    }
 
-        if (obj->hitboxes_.size() != 0) { // If the object has a hitbox (for spikes)
+    void GameCollision::CollisionEvents(Camera* camera, glm::vec3 previous_position, EntityRegistry* registry, const SpatialGrid* grid)
+    {
+        FindPairs(camera, previous_position, registry, grid);
 
-            for (int i = 0; i < obj->hitboxes_.size(); i++) { // For each hitbox
+        // Narrowphase: sphere-to-sphere test of every candidate
+        spheres_.Clear();
+        for (int p = 0; p < pairs_.size(); p++)
+        {
+            const CollisionPair& pair = pairs_[p];
+            SceneNode* root = pair.node->GetRoot();
+            if (pair.hitbox < 0)
+            {
+                // Parts and vents are columns: the height difference is ignored
+                spheres_.Add(root->GetPosition(), root->GetRadius(), true);
+            }
+            else
+            {
+                SceneNode* hitbox = pair.node->hitboxes_[pair.hitbox];
+                spheres_.Add(root->GetPosition() + hitbox->GetPosition(), hitbox->GetRadius()); // "Canonical" position of hitbox
+            }
+        }
+        // Swept from the previous position so a long frame cannot skip over thin spheres
+        hits_.clear();
+        spheres_.Sweep(previous_position, camera->GetPosition(), camera->GetRadius(), hits_);
 
-                glm::vec3 hitbox_pos = obj->GetRoot()->GetPosition() + obj->hitboxes_[i]->GetPosition(); // Calculate "canonical" position of hitbox
+        for (int h = 0; h < hits_.size(); h++)
+        {
+            const CollisionPair& pair = pairs_[hits_[h].index];
+            CompositeNode* obj = pair.node;
+            Hazard* hazard = registry->hazard_.Get(pair.entity);
 
-                if (glm::length(camera->GetPosition() - hitbox_pos) <= (camera->GetRadius() + obj->hitboxes_[i]->GetRadius())) { // Sphere-to-sphere collision
+            // If we collided with a machine part
+            if (pair.hitbox < 0 && registry->collectible_.Has(pair.entity) && obj->GetRoot()->GetCollision() == 1)
+            {
+                PlayerMachinePartCollision(camera, obj);
+                continue;
+            }
 
-                    if (obj->GetType() == CompositeNode::Type::Stalagmite) {
-                        camera->DecreaseTimer(1);
-                        prev_collision_ = glfwGetTime();
-                    }
-                }
-                
+            // Spikes always hurt, the hydrothermal vent stream only while it is switched on
+            if (hazard != NULL && (pair.hitbox >= 0 || !hazard->switched || obj->GetCollision() == 1))
+            {
+                camera->DecreaseTimer(hazard->damage);
+                prev_collision_ = glfwGetTime();
             }
         }
 
@@ -54,7 +97,6 @@ namespace game
         {
             camera->SetHurt(false);
         }
-        
     }
 
     // If player collides with machine part, increase the number of parts we've collected
@@ -4,6 +4,9 @@
 #include "camera.h"
 #include "scene_node.h"
 #include "composite_node.h"
+#include "entity_registry.h"
+#include "spatial_grid.h"
+#include "sphere_batch.h"
 
 namespace game
 {
@@ -14,13 +17,37 @@ namespace game
 		// Constructor
 		GameCollision();
 
-		// Handler in the event the camera (player) collides with any object
-		void CollisionEventCompositeNode(Camera* camera, CompositeNode* obj);
+		// Handle the camera (player) colliding with any entity that has a collider on its way from
+		// previous_position to its current position (hits are handled in the order they happen)
+		// Runs the broadphase, then tests the candidate pairs it found
+		void CollisionEvents(Camera* camera, glm::vec3 previous_position, EntityRegistry* registry, const SpatialGrid* grid);
+
+		// Broadphase: collect the spheres near the player's path whose layers and masks match
+		void FindPairs(Camera* camera, glm::vec3 previous_position, EntityRegistry* registry, const SpatialGrid* grid);
+
+		// Layer of the player and the layers it collides with
+		void SetPlayerLayer(uint32_t layer, uint32_t mask) { player_layer_ = layer; player_mask_ = mask; }
+
+		// Number of candidate pairs tested in the last frame
+		int GetNumPairs(void) const { return pairs_.size(); }
 
 		// Handles collision if the player collides with a beacon (the beacon disappears if it's active)
 		void PlayerMachinePartCollision(Camera* camera, CompositeNode* obj);
 	private:
+		// A sphere of an entity that may touch the player
+		struct CollisionPair {
+			EntityHandle entity;
+			CompositeNode* node;
+			int hitbox; // Index in the node's hitboxes_, -1 for the root sphere
+		};
+
 		float prev_collision_;
+		uint32_t player_layer_;
+		uint32_t player_mask_;
+		std::vector<EntityHandle> nearby_; // Reused between frames
+		std::vector<CollisionPair> pairs_; // Candidates of the current frame
+		SphereBatch spheres_; // Sphere of every pair, same index
+		std::vector<SphereBatch::SweepHit> hits_; // Pairs the player touches, earliest first
 	};
 }
 
@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <ios>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The zlib decoder of the stb_image inside SOIL
+#include <SOIL/stb_image_aug.h>
+
+#include "height_map.h"
+
+namespace game {
+
+    HeightMap::HeightMap(void) : data_(NULL), size_(0), file_(NULL), mapping_(NULL), samples_(NULL), width_(0), depth_(0), format_(Unsigned8), sample_stride_(0), row_pitch_(0), max_value_(1.0f) {
+    }
+
+
+    HeightMap::~HeightMap() {
+
+        Close();
+    }
+
+
+    void HeightMap::Open(const std::string& filename) {
+
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw(std::ios_base::failure(std::string("Error opening file ") + filename));
+        }
+        file_ = file;
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        size_ = (size_t)size.QuadPart;
+        if (size_ > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                mapping_ = mapping;
+                data_ = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+        }
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw(std::ios_base::failure(std::string("Error opening file ") + filename));
+        }
+        file_ = (void*)(intptr_t)(fd + 1); // Keep NULL meaning "no file"
+
+        struct stat st;
+        size_ = (fstat(fd, &st) == 0) ? (size_t)st.st_size : 0;
+        if (size_ > 0) {
+            void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = (const unsigned char*)data;
+            }
+        }
+#endif
+
+        if (!data_) {
+            Close();
+            throw(std::ios_base::failure(std::string("Error mapping height map ") + filename));
+        }
+
+        // Pick the reader from the contents, raw floats have no header
+        const char* error;
+        if (size_ >= 2 && data_[0] == 'P' && (data_[1] == '5' || data_[1] == '2')) {
+            error = ReadPGM();
+        }
+        else if (size_ >= 8 && std::memcmp(data_, "\x89PNG\r\n\x1a\n", 8) == 0) {
+            error = ReadPNG();
+        }
+        else if (filename.size() >= 4 && (filename.compare(filename.size() - 4, 4, ".r32") == 0 || filename.compare(filename.size() - 4, 4, ".raw") == 0)) {
+            error = ReadRaw();
+        }
+        else {
+            error = "unknown format";
+        }
+        if (!error && (width_ < 1 || depth_ < 1)) {
+            error = "empty";
+        }
+        if (error) {
+            Close();
+            throw(std::ios_base::failure(std::string("Error loading height map ") + filename + std::string(": ") + std::string(error)));
+        }
+    }
+
+
+    void HeightMap::Close(void) {
+
+#ifdef _WIN32
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle((HANDLE)mapping_);
+        }
+        if (file_) {
+            CloseHandle((HANDLE)file_);
+        }
+#else
+        if (data_) {
+            munmap((void*)data_, size_);
+        }
+        if (file_) {
+            close((int)(intptr_t)file_ - 1);
+        }
+#endif
+        data_ = NULL;
+        size_ = 0;
+        file_ = NULL;
+        mapping_ = NULL;
+        decoded_.clear();
+        decoded_.shrink_to_fit();
+        samples_ = NULL;
+        width_ = 0;
+        depth_ = 0;
+    }
+
+
+    float HeightMap::GetHeight(int x, int z, float scale) const {
+
+        const unsigned char* sample = GetSampleData(x, z);
+        float value;
+        if (format_ == Unsigned8) {
+            value = (float)sample[0];
+        }
+        else if (format_ == Unsigned16) {
+            value = (float)((sample[0] << 8) | sample[1]);
+        }
+        else {
+            std::memcpy(&value, sample, sizeof(float));
+        }
+        // 255 / 8 over 255 is exactly 1 / 8, so 8 bit maps come out as they always did
+        return value * (scale / max_value_);
+    }
+
+
+    const char* HeightMap::ReadPGM(void) {
+
+        // Header: magic, width, height and maximum value separated by whitespace, with
+        // comments from # to the end of the line
+        size_t pos = 2;
+        long field[3];
+        for (int i = 0; i < 3; i++) {
+            for (;;) {
+                while (pos < size_ && std::strchr(" \t\r\n", data_[pos])) {
+                    pos++;
+                }
+                if (pos < size_ && data_[pos] == '#') {
+                    while (pos < size_ && data_[pos] != '\n') {
+                        pos++;
+                    }
+                    continue;
+                }
+                break;
+            }
+            long value = 0;
+            size_t start = pos;
+            while (pos < size_ && data_[pos] >= '0' && data_[pos] <= '9' && value < 1000000) {
+                value = value * 10 + (data_[pos++] - '0');
+            }
+            if (pos == start) {
+                return "invalid PGM header";
+            }
+            field[i] = value;
+        }
+        if (field[0] < 1 || field[1] < 1 || field[2] < 1 || field[2] > 65535) {
+            return "invalid PGM header";
+        }
+        width_ = (int)field[0];
+        depth_ = (int)field[1];
+        max_value_ = (float)field[2];
+        size_t count = (size_t)width_ * depth_;
+
+        if (data_[1] == '5') {
+            // Samples start after a single whitespace character and are used in place
+            pos++;
+            format_ = (field[2] < 256) ? Unsigned8 : Unsigned16;
+            sample_stride_ = (format_ == Unsigned8) ? 1 : 2;
+            row_pitch_ = sample_stride_ * width_;
+            if (pos > size_ || size_ - pos < row_pitch_ * depth_) {
+                return "PGM data ends early";
+            }
+            samples_ = data_ + pos;
+            return NULL;
+        }
+
+        // ASCII samples are parsed into floats
+        format_ = Float32;
+        sample_stride_ = sizeof(float);
+        row_pitch_ = sample_stride_ * width_;
+        decoded_.resize(count * sizeof(float));
+        float* out = (float*)decoded_.data();
+        for (size_t i = 0; i < count; i++) {
+            while (pos < size_ && std::strchr(" \t\r\n", data_[pos])) {
+                pos++;
+            }
+            long value = 0;
+            size_t start = pos;
+            while (pos < size_ && data_[pos] >= '0' && data_[pos] <= '9' && value <= 65535) {
+                value = value * 10 + (data_[pos++] - '0');
+            }
+            if (pos == start) {
+                return "PGM data ends early";
+            }
+            out[i] = (float)value;
+        }
+        samples_ = decoded_.data();
+        return NULL;
+    }
+
+
+    static uint32_t ReadBigEndian32(const unsigned char* p) {
+
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+
+
+    // CRC-32 of a PNG chunk (over its type and data)
+    static uint32_t Crc32(const unsigned char* data, size_t size) {
+
+        static uint32_t table[256];
+        static bool filled = false;
+        if (!filled) {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            filled = true;
+        }
+        uint32_t crc = 0xffffffffu;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc ^ 0xffffffffu;
+    }
+
+
+    // Adler-32 of the inflated data, stored at the end of the zlib stream
+    static uint32_t Adler32(const unsigned char* data, size_t size) {
+
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            // Sums stay below 2^32 for 5552 bytes between reductions
+            size_t block = std::min(size, (size_t)5552);
+            for (size_t i = 0; i < block; i++) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += block;
+            size -= block;
+        }
+        return (b << 16) | a;
+    }
+
+
+    const char* HeightMap::ReadPNG(void) {
+
+        // Chunks: length, type, data, CRC of type and data
+        size_t pos = 8;
+        int bit_depth = 0, color_type = -1;
+        std::vector<unsigned char> compressed;
+        bool header = false, end = false;
+        while (!end && pos + 12 <= size_) {
+            uint32_t length = ReadBigEndian32(data_ + pos);
+            const unsigned char* type = data_ + pos + 4;
+            const unsigned char* chunk = data_ + pos + 8;
+            if (length > size_ - pos - 12) {
+                return "PNG chunk ends early";
+            }
+            if (Crc32(type, length + 4) != ReadBigEndian32(chunk + length)) {
+                return "PNG chunk is damaged (CRC mismatch)";
+            }
+            if (std::memcmp(type, "IHDR", 4) == 0) {
+                if (length < 13) {
+                    return "invalid PNG header";
+                }
+                width_ = (int)ReadBigEndian32(chunk);
+                depth_ = (int)ReadBigEndian32(chunk + 4);
+                bit_depth = chunk[8];
+                color_type = chunk[9];
+                if (chunk[10] != 0 || chunk[11] != 0) {
+                    return "unknown PNG compression or filter";
+                }
+                if (chunk[12] != 0) {
+                    return "interlaced PNG is not supported";
+                }
+                header = true;
+            }
+            else if (std::memcmp(type, "IDAT", 4) == 0) {
+                compressed.insert(compressed.end(), chunk, chunk + length);
+            }
+            else if (std::memcmp(type, "IEND", 4) == 0) {
+                end = true;
+            }
+            pos += 12 + length;
+        }
+        if (!header || width_ < 1 || depth_ < 1 || width_ > (1 << 24) || depth_ > (1 << 24)) {
+            return "invalid PNG header";
+        }
+
+        int channels;
+        switch (color_type) {
+            case 0: channels = 1; break; // Gray
+            case 2: channels = 3; break; // RGB
+            case 4: channels = 2; break; // Gray and alpha
+            case 6: channels = 4; break; // RGBA
+            default: return "palette PNG is not supported";
+        }
+        if (bit_depth != 8 && bit_depth != 16) {
+            return "PNG must have 8 or 16 bits per sample";
+        }
+
+        // zlib stream: two header bytes, deflate data, Adler-32 of the inflated data
+        if (compressed.size() < 6 || (compressed[0] & 0x0f) != 8 || (compressed[1] & 0x20) || ((compressed[0] << 8) | compressed[1]) % 31 != 0) {
+            return "invalid PNG data";
+        }
+        size_t pixel_size = channels * bit_depth / 8;
+        size_t row_size = pixel_size * width_;
+        if ((row_size + 1) * depth_ > (size_t)INT32_MAX || compressed.size() > (size_t)INT32_MAX) {
+            return "PNG is too large";
+        }
+        // Exactly the filtered rows fit; more data than that is an error as well
+        std::vector<unsigned char> filtered((row_size + 1) * depth_);
+        int inflated = stbi_zlib_decode_buffer((char*)filtered.data(), (int)filtered.size(), (const char*)compressed.data(), (int)compressed.size());
+        if (inflated < 0) {
+            return "invalid PNG data";
+        }
+        if ((size_t)inflated < filtered.size()) {
+            return "PNG data ends early";
+        }
+        if (Adler32(filtered.data(), filtered.size()) != ReadBigEndian32(&compressed[compressed.size() - 4])) {
+            return "PNG data is damaged (Adler-32 mismatch)";
+        }
+
+        // Undo the filter of every row (each starts with its filter type)
+        decoded_.resize(row_size * depth_);
+        for (int z = 0; z < depth_; z++) {
+            const unsigned char* in = filtered.data() + (row_size + 1) * z + 1;
+            unsigned char* out = decoded_.data() + row_size * z;
+            const unsigned char* above = (z > 0) ? out - row_size : NULL;
+            int filter = in[-1];
+            for (size_t i = 0; i < row_size; i++) {
+                int a = (i >= pixel_size) ? out[i - pixel_size] : 0;
+                int b = above ? above[i] : 0;
+                int c = (above && i >= pixel_size) ? above[i - pixel_size] : 0;
+                int predictor;
+                switch (filter) {
+                    case 0: predictor = 0; break;
+                    case 1: predictor = a; break;
+                    case 2: predictor = b; break;
+                    case 3: predictor = (a + b) / 2; break;
+                    case 4: {
+                        int p = a + b - c;
+                        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+                        break;
+                    }
+                    default: return "invalid PNG filter";
+                }
+                out[i] = (unsigned char)(in[i] + predictor);
+            }
+        }
+
+        // The first channel is the height
+        format_ = (bit_depth == 8) ? Unsigned8 : Unsigned16;
+        max_value_ = (bit_depth == 8) ? 255.0f : 65535.0f;
+        sample_stride_ = pixel_size;
+        row_pitch_ = row_size;
+        samples_ = decoded_.data();
+        return NULL;
+    }
+
+
+    const char* HeightMap::ReadRaw(void) {
+
+        // No header: the map has to be square
+        size_t count = size_ / sizeof(float);
+        int side = 0;
+        while ((size_t)(side + 1) * (side + 1) <= count) {
+            side++;
+        }
+        if (count * sizeof(float) != size_ || (size_t)side * side != count) {
+            return "raw height map must be a square of 32-bit floats";
+        }
+        width_ = side;
+        depth_ = side;
+        format_ = Float32;
+        max_value_ = 1.0f;
+        sample_stride_ = sizeof(float);
+        row_pitch_ = sample_stride_ * width_;
+        samples_ = data_;
+        return NULL;
+    }
+
+} // namespace game
@@ -0,0 +1,79 @@
+/*
+ *
+ * Read-only height map file. The size and sample format are taken from the file:
+ *   - binary PGM (P5), 8 or 16 bits per sample
+ *   - ASCII PGM (P2)
+ *   - PNG, grayscale (or the first channel of a color image), 8 or 16 bits per sample
+ *     (inflated by the zlib decoder of SOIL's stb_image; chunk CRCs and the Adler-32 are checked)
+ *   - raw 32-bit floats (.r32 or .raw, little endian, square), heights in [0, 1]
+ *
+ * Files are memory-mapped. Binary PGM and raw samples are read in place (the view points into
+ * the mapping); ASCII PGM and PNG have to be decoded into memory first.
+ *
+ */
+#ifndef HEIGHT_MAP_H_
+#define HEIGHT_MAP_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace game {
+
+    class HeightMap {
+
+        public:
+            enum SampleFormat { Unsigned8, Unsigned16, Float32 };
+
+            HeightMap(void);
+            ~HeightMap();
+
+            HeightMap(const HeightMap&) = delete;
+            HeightMap& operator=(const HeightMap&) = delete;
+
+            // Map and decode a file; throws std::ios_base::failure
+            void Open(const std::string& filename);
+            void Close(void);
+
+            int GetWidth(void) const { return width_; }
+            int GetDepth(void) const { return depth_; }
+            SampleFormat GetFormat(void) const { return format_; }
+            // Sample value that stands for the full height (255 for 8 bits, 1 for floats, ...)
+            float GetMaxValue(void) const { return max_value_; }
+
+            // Raw sample at (x, z), 16 bit samples are big endian
+            const unsigned char* GetSampleData(int x, int z) const { return samples_ + row_pitch_ * z + sample_stride_ * x; }
+            // Sample at (x, z) scaled so that the maximum value becomes scale
+            float GetHeight(int x, int z, float scale) const;
+
+        private:
+            // The mapped file
+            const unsigned char* data_;
+            size_t size_;
+            // Platform handles of the mapping
+            void* file_;
+            void* mapping_;
+
+            // Decoded samples, when they cannot be used from the file directly
+            std::vector<unsigned char> decoded_;
+
+            // View of the samples
+            const unsigned char* samples_;
+            int width_;
+            int depth_;
+            SampleFormat format_;
+            size_t sample_stride_; // Bytes between samples of a row
+            size_t row_pitch_; // Bytes between rows
+            float max_value_;
+
+            // Format readers; return an error or NULL
+            const char* ReadPGM(void);
+            const char* ReadPNG(void);
+            const char* ReadRaw(void);
+
+    }; // class HeightMap
+
+} // namespace game
+
+#endif // HEIGHT_MAP_H_
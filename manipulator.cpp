@@ -1,11 +1,31 @@
 #include "manipulator.h"
+#include "prop_scatter.h"
+#include <cmath>
 #include <iostream>
+#include <random>
 
 namespace game {
 
     Manipulator::Manipulator() {}
     Manipulator::~Manipulator() {}
 
+    void Manipulator::SetRegistry(EntityRegistry* registry) {
+        registry_ = registry;
+    }
+
+    void Manipulator::SetTerrain(const Terrain* terrain) {
+        terrain_ = terrain;
+    }
+
+    EntityHandle Manipulator::CreateEntity(CompositeNode* node_) {
+        if (registry_ == nullptr) {
+            throw(GameException(std::string("Manipulator has no entity registry to build \"") + node_->GetName() + std::string("\"")));
+        }
+        EntityHandle entity = registry_->Create();
+        node_->SetHandle(entity);
+        return entity;
+    }
+
     // (1) Construct hierarchical objects
     CompositeNode* Manipulator::ConstructKelp(ResourceManager* resman_, std::string name_, int branch_complexity, glm::vec3 position_) {
 
@@ -87,18 +107,24 @@ namespace game {
                 }
             }
         }
+
+        // Gentle sway about the x and z axes (about 17 and 8 degrees)
+        SetupSway(kelp, glm::vec3(0.3f, 0.0f, 0.15f), 1.0f);
+        EntityHandle entity = CreateEntity(kelp);
+        registry_->animator_.Add(entity, Animator{ kelp, Animator::Sway });
         return kelp;
     }
 
 
-    CompositeNode* Manipulator::ConstructPlane(ResourceManager* resman_) {
+    CompositeNode* Manipulator::ConstructPlane(ResourceManager* resman_, const std::vector<float>& height_map, int width, int depth, glm::vec2 origin) {
         CompositeNode* plane = new CompositeNode("Plane");
 
-        SceneNode* root = CreateSceneNodeInstance("Root", "Plane", "NormalMapMaterial", "NormalMapSand", resman_);
+        SceneNode* root = CreateTerrainNodeInstance("Root", "PlaneHeights", "NormalMapSand", height_map, width, depth, origin, resman_);
         root->SetColor(glm::vec3(1, 0.9, 0.5));
         
         plane->SetRoot(root);
 
+        CreateEntity(plane);
         return plane;
     }
 
@@ -109,6 +135,7 @@ namespace game {
         root->SetColor(glm::vec3(0.6, 0.6, 0.7));
         boundary->SetRoot(root);
 
+        CreateEntity(boundary);
         return boundary;
     }
 
@@ -120,6 +147,7 @@ namespace game {
         root->SetPosition(position);
         sphere->SetRoot(root);
 
+        CreateEntity(sphere);
         return sphere;
     }
 
@@ -199,6 +227,12 @@ namespace game {
         tip->Translate(glm::vec3(0, 16.5, 0));
         stalagmite->AddNode(tip);
 
+        // Only the spikes (hitboxes) hurt
+        EntityHandle entity = CreateEntity(stalagmite);
+        registry_->collider_.Add(entity, Collider{ stalagmite, true, LayerHazard, LayerPlayer });
+        registry_->hazard_.Add(entity, Hazard{ stalagmite, 1.0f, false });
+        registry_->solid_.Add(entity, Solid{ stalagmite, true, false });
+
         return stalagmite;
     }
 
@@ -375,6 +409,10 @@ namespace game {
         light4->Translate(glm::vec3(6, 5.5, -6));
         Submarine->AddNode(light4);
 
+        EntityHandle entity = CreateEntity(Submarine);
+        registry_->animator_.Add(entity, Animator{ Submarine, Animator::Submarine });
+        registry_->solid_.Add(entity, Solid{ Submarine, true, false });
+
         return Submarine;
     }
 
@@ -471,6 +509,9 @@ namespace game {
         stem_prime->AddChild(stem11);
         coral->AddNode(stem11);
 
+        EntityHandle entity = CreateEntity(coral);
+        registry_->solid_.Add(entity, Solid{ coral, false, false });
+
         return coral;
     }
 
@@ -503,21 +544,50 @@ namespace game {
             last_piece = piece;
         }
 
+        SetupSway(seaweed, glm::vec3(0.3f, 0.0f, 0.15f), 1.0f);
+        EntityHandle entity = CreateEntity(seaweed);
+        registry_->animator_.Add(entity, Animator{ seaweed, Animator::Sway });
         return seaweed;
     }
   
-    void Manipulator::ConstructSeaweedPatch(ResourceManager* resman_, SceneGraph* scene_, int num_strands, int length, int width, glm::vec3 position_) {
+    EntityHandle Manipulator::ConstructSeaweedPatch(ResourceManager* resman_, SceneGraph* scene_, int num_strands, int length, int width, glm::vec3 position_) {
+
+        // Seeded from the position, so a patch grows the same every time its chunk is loaded
+        uint32_t seed = (uint32_t)(int)std::floor(position_.x) * 73856093u ^ (uint32_t)(int)std::floor(position_.z) * 19349663u;
+        std::mt19937 random(seed);
+
+        // Strands spread evenly over the patch, spaced so there are more spots than strands
+        std::vector<glm::vec2> spot;
+        PropScatter scatter;
+        scatter.Init(std::vector<float>((size_t)std::max(length, 1) * std::max(width, 1), 1.0f), std::max(length, 1), std::max(width, 1), glm::vec2(0.0f));
+        scatter.Scatter(std::sqrt(0.45f * scatter.GetWidth() * scatter.GetDepth() / std::max(num_strands, 1)), seed, NULL, spot);
+        for (int i = (int)spot.size() - 1; i > 0; i--) {
+            std::swap(spot[i], spot[random() % (i + 1)]);
+        }
+        // A small or crowded patch may not have enough spots; the rest of the strands go anywhere on it
+        std::uniform_real_distribution<float> along_x(0.0f, (float)scatter.GetWidth());
+        std::uniform_real_distribution<float> along_z(0.0f, (float)scatter.GetDepth());
+        while ((int)spot.size() < num_strands) {
+            float x = along_x(random);
+            spot.push_back(glm::vec2(x, along_z(random)));
+        }
 
+        EntityHandle first;
         for (int i = 0; i < num_strands; i++) {
-            int random_x = rand() % length + 1; // Random int between 1-length
-            int random_z = rand() % width + 1; // Random int between 1-width
-            int random_length = rand() % 6 + 1; // Random int between 1-6
-            CompositeNode* strand = ConstructSeaweed(resman_, "Seaweed", random_length, position_ + glm::vec3(random_x, 0, random_z));
+            int random_length = random() % 6 + 1; // Random int between 1-6
+            CompositeNode* strand = ConstructSeaweed(resman_, "Seaweed", random_length, position_ + glm::vec3(spot[i].x, 0, spot[i].y));
             strand->GetRoot()->SetSpecularPower(0.2);
             strand->GetRoot()->SetLambertianCoefficient(0.4);
             strand->GetRoot()->SetTileCount(12);
-            scene_->AddNode(strand);
+            EntityHandle entity = scene_->AddNode(strand);
+            if (first.IsNull()) {
+                first = entity;
+            }
+            else {
+                scene_->Link(first, entity);
+            }
         }
+        return first;
     }
 
     /// Creates a collectable machine part
@@ -557,6 +627,11 @@ namespace game {
         node1->AddChild(node3);
         part->AddNode(node3);
         part->Scale(glm::vec3(2));
+
+        EntityHandle entity = CreateEntity(part);
+        registry_->collider_.Add(entity, Collider{ part, false, LayerCollectible, LayerPlayer });
+        registry_->collectible_.Add(entity, Collectible{ part });
+        registry_->solid_.Add(entity, Solid{ part, false, true });
         return part;
     }
 
@@ -571,6 +646,8 @@ namespace game {
         system->SetRoot(particles);
 
 
+        EntityHandle entity = CreateEntity(system);
+        registry_->emitter_.Add(entity, ParticleEmitter{ system, false, glm::vec3(0.0) });
         return system;
 
 
@@ -623,7 +700,12 @@ namespace game {
                   an->AddNode(sub_branch);
               }
           }
+
+          // Tentacles are offset in phase so they do not all move together
+          SetupSway(an, glm::vec3(0.3f, 0.0f, 0.15f), 1.0f, 2.0f);
       
+          EntityHandle entity = CreateEntity(an);
+          registry_->animator_.Add(entity, Animator{ an, Animator::Sway });
           return an;
     }
 
@@ -639,6 +721,8 @@ namespace game {
         root->SetColor(glm::vec3(0.49, 0.498, 0.486));
         rock->SetRoot(root);
 
+        EntityHandle entity = CreateEntity(rock);
+        registry_->solid_.Add(entity, Solid{ rock, false, false });
         return rock;
 
     }
@@ -654,9 +738,118 @@ namespace game {
         root->SetColor(glm::vec3(1.0, 0.6, 0.4));
         vent->SetRoot(root);
 
+        EntityHandle entity = CreateEntity(vent);
+        registry_->solid_.Add(entity, Solid{ vent, false, false });
         return vent;
     }
 
+    CompositeNode* Manipulator::ConstructVent(ResourceManager* resman_, std::string name_, glm::vec3 position_) {
+        CompositeNode* vent = ConstructParticleSystem(resman_, "SphereParticles", name_, "ParticleGeyserMaterial", "BubbleTexture", position_);
+        vent->Scale(glm::vec3(15.0, 1.0, 15.0));
+        vent->SetType(CompositeNode::Type::Vent);
+
+        // The stream only hurts while the vent is switched on (see Game::MainLoop)
+        EntityHandle entity = vent->GetHandle();
+        registry_->collider_.Add(entity, Collider{ vent, false, LayerHazard, LayerPlayer });
+        registry_->hazard_.Add(entity, Hazard{ vent, 1.0f, true });
+        return vent;
+    }
+
+    CompositeNode* Manipulator::ConstructTerrainTile(ResourceManager* resman_, std::string name_, std::string object_name) {
+        CompositeNode* tile = new CompositeNode(name_);
+
+        // Same look as the boundary; the mesh is already in world coordinates
+        SceneNode* root = CreateSceneNodeInstance("Root", object_name, "NormalMapMaterial", "NormalMapStone", resman_);
+        root->SetColor(glm::vec3(0.6, 0.6, 0.7));
+        tile->SetRoot(root);
+
+        CreateEntity(tile);
+        return tile;
+    }
+
+    void Manipulator::ConstructWorld(ResourceManager* resman_, SceneGraph* scene_, const SceneFile& file_, std::vector<EntityHandle>* entities_, const std::vector<char>* skip_) {
+
+        // Entity of each record, for links
+        std::vector<EntityHandle> local;
+        std::vector<EntityHandle>& entity = entities_ ? *entities_ : local;
+        entity.assign(file_.GetNumRecords(), EntityHandle());
+
+        for (int i = 0; i < file_.GetNumRecords(); i++) {
+            if (skip_ && i < skip_->size() && (*skip_)[i]) {
+                continue;
+            }
+            const SceneRecord& record = file_.GetRecord(i);
+            std::string name(file_.GetString(record.name));
+            glm::vec3 position(record.position[0], record.position[1], record.position[2]);
+            if ((record.flags & RecordOnTerrain) && terrain_ != nullptr) {
+                position.y += terrain_->GetHeight(position.x, position.z);
+            }
+
+            CompositeNode* node = NULL;
+            switch (record.prefab) {
+                case PrefabSubmarine:
+                    node = ConstructSubmarine(resman_, name, position);
+                    break;
+                case PrefabPart:
+                    node = ConstructPart(resman_, name, position);
+                    break;
+                case PrefabKelp:
+                    node = ConstructKelp(resman_, name, (int)record.param[0], position);
+                    break;
+                case PrefabCoral:
+                    node = ConstructCoral(resman_, name, position);
+                    break;
+                case PrefabAnemonie:
+                    node = ConstructAnemonie(resman_, name, position);
+                    break;
+                case PrefabSeaweed:
+                    node = ConstructSeaweed(resman_, name, (int)record.param[0], position);
+                    break;
+                case PrefabSeaweedPatch:
+                    // Adds its strands to the scene itself
+                    entity[i] = ConstructSeaweedPatch(resman_, scene_, (int)record.param[0], (int)record.param[1], (int)record.param[2], position);
+                    break;
+                case PrefabRock:
+                    node = ConstructRock(resman_, name, position);
+                    break;
+                case PrefabStalagmite:
+                    node = ConstructStalagmite(resman_, name, position);
+                    break;
+                case PrefabVent:
+                    node = ConstructVent(resman_, name, position);
+                    break;
+                case PrefabVentBase:
+                    node = ConstructVentBase(resman_, name, position);
+                    break;
+                case PrefabParticles:
+                    node = ConstructParticleSystem(resman_, std::string(file_.GetString(record.string[0])), name,
+                        std::string(file_.GetString(record.string[1])), std::string(file_.GetString(record.string[2])), position);
+                    break;
+            }
+            if (!node) {
+                continue;
+            }
+
+            // Records without a rotation hold the identity (1, 0, 0, 0)
+            if (record.rotation[0] != 1.0f || record.rotation[1] != 0.0f || record.rotation[2] != 0.0f || record.rotation[3] != 0.0f) {
+                node->Rotate(glm::quat(record.rotation[0], record.rotation[1], record.rotation[2], record.rotation[3]));
+            }
+            glm::vec3 scale(record.scale[0], record.scale[1], record.scale[2]);
+            if (scale != glm::vec3(1.0f)) {
+                node->Scale(scale);
+            }
+
+            entity[i] = scene_->AddNode(node);
+
+            if (record.flags & RecordFollowCamera) {
+                registry_->emitter_.Add(entity[i], ParticleEmitter{ node, true, glm::vec3(record.param[0], record.param[1], record.param[2]) });
+            }
+            if (record.link >= 0 && !entity[record.link].IsNull()) {
+                scene_->Link(entity[record.link], entity[i]);
+            }
+        }
+    }
+
     CompositeNode* Manipulator::ConstructSkyBox(ResourceManager* resman_, std::string name_, glm::vec3 position_) {
 
         CompositeNode* box = new CompositeNode(name_);
@@ -667,43 +860,32 @@ namespace game {
         root->SetPosition(position_);
         box->SetRoot(root);
 
+        CreateEntity(box);
         return box;
 
     }
 
 
     // (2) Animate hierarchical objects
-    void Manipulator::AnimateAll(SceneGraph* scene_, double time_, float theta_) {
-        CompositeNode* current_;
-        for (int i = 0; i < scene_->GetSize(); i++) {
-            current_ = scene_->GetNode(i);
-            if (current_ != nullptr) {
-
-                // Animate all kelp instances
-                if (current_->GetType() == CompositeNode::Type::Kelp) {
-                    AnimateKelp(current_, time_, theta_);
-                }
-
-                else if (current_->GetType() == CompositeNode::Type::Seaweed) {
-                    AnimateKelp(current_, time_, theta_);
-                }
-
-                else if (current_->GetType() == CompositeNode::Type::Anemonie) {
-                    //std::cout << "In Anemonie if statement" << std::endl;
-                    AnimateAnemone(current_, time_, theta_);
-                }
-
-                else if (current_->GetType() == CompositeNode::Type::Submarine) {
-                    AnimateSubmarine(current_, time_, theta_);
-                }
-
-               
+    void Manipulator::AnimateAll(SceneGraph* scene_, double time_) {
+        // Only entities with an animator are visited; each one only animates its own nodes,
+        // so they can be handled in parallel
+        ComponentArray<Animator>& animators = scene_->GetRegistry().animator_;
+        scene_->GetThreadPool().ParallelFor(animators.GetSize(), [this, &animators, time_](int i) {
+            Animator& animator = animators[i];
+
+            // Kelp, seaweed and anemones
+            if (animator.kind == Animator::Sway) {
+                AnimateKelp(animator.node, time_);
+            }
 
+            else if (animator.kind == Animator::Submarine) {
+                AnimateSubmarine(animator.node, time_);
             }
-        }
+        });
     }
 
-    void Manipulator::AnimateSubmarine(CompositeNode* node_, double time_, float theta_) {
+    void Manipulator::AnimateSubmarine(CompositeNode* node_, double time_) {
         for (int i = 0; i < node_->GetRoot()->GetChildCount(); i++) {
             if (node_->GetRoot()->GetChild(i)->GetName() == "Light") { // Animate lights, they alternate between green and red
                 if ((int) time_ % 2 == 0) {
@@ -719,17 +901,22 @@ namespace game {
         }
     }
               
-    void Manipulator::AnimateKelp(CompositeNode * node_, double time_, float theta_) {
-        node_->Orbit(glm::angleAxis(theta_, glm::vec3(0.1 * sin(time_), 0, 0.05 * sin(1 - time_))));
+    void Manipulator::AnimateKelp(CompositeNode * node_, double time_) {
+        node_->GetRoot()->Sway(time_);
         for (int i = 0; i < node_->GetRoot()->GetChildCount(); i++) {
-            node_->GetRoot()->GetChild(i)->Orbit(glm::angleAxis(theta_, glm::vec3(0.1 * sin(time_), 0, 0.05 * sin(1 - time_))));
+            node_->GetRoot()->GetChild(i)->Sway(time_);
         }
     }
 
-    void Manipulator::AnimateAnemone(CompositeNode* node_, double time_, float theta_) {
-        node_->Orbit(glm::angleAxis(theta_, glm::vec3(0.1 * sin(time_), 0, 0.05 * sin(1 - time_))));
+    void Manipulator::AnimateAnemone(CompositeNode* node_, double time_) {
+        // Same as kelp; the per-tentacle phase offset is stored in the nodes
+        AnimateKelp(node_, time_);
+    }
+
+    void Manipulator::SetupSway(CompositeNode* node_, glm::vec3 amplitude, float frequency, float phase_step) {
+        node_->GetRoot()->SetSway(amplitude, frequency, 0.0f);
         for (int i = 0; i < node_->GetRoot()->GetChildCount(); i++) {
-            node_->GetRoot()->GetChild(i)->Orbit(glm::angleAxis(theta_, glm::vec3(0.1 * sin(time_ + (2 * i)), 0, 0.05 * sin(1 - (time_ + (2 * i))))));
+            node_->GetRoot()->GetChild(i)->SetSway(amplitude, frequency, i * phase_step);
         }
     }
 
@@ -759,4 +946,44 @@ namespace game {
         SceneNode* obj = new SceneNode(entity_name, geom, mat, tex, 0);
         return obj;
     }
+
+    CompositeNode* Manipulator::ConstructPropField(ResourceManager* resman_, std::string name_, std::string object_name, std::string texture_name, const std::vector<PropInstance>& instances, float extent, glm::vec3 color) {
+        CompositeNode* field = new CompositeNode(name_);
+
+        const char* names[3] = { object_name.c_str(), "PropBatchMaterial", texture_name.c_str() };
+        Resource* res[3];
+        for (int i = 0; i < 3; i++) {
+            res[i] = resman_->GetResource(names[i]);
+            if (!res[i]) {
+                throw(GameException(std::string("Could not find resource \"") + names[i] + std::string("\"")));
+            }
+        }
+        SceneNode* root = new PropBatchNode("Root", res[0], res[1], res[2], instances, extent);
+        root->SetColor(color);
+        field->SetRoot(root);
+
+        CreateEntity(field);
+        return field;
+    }
+
+    SceneNode* Manipulator::CreateTerrainNodeInstance(std::string entity_name, std::string height_texture_name, std::string texture_name,
+        const std::vector<float>& height_map, int width, int depth, glm::vec2 origin, ResourceManager* resman_) {
+
+        // Every terrain shares the grid mesh and the material; the tessellated ones are only
+        // there when the hardware can tessellate
+        bool tessellated = resman_->GetResource("TerrainTessMaterial") != NULL;
+        const char* names[4] = { tessellated ? "TerrainPatchGrid" : "TerrainGrid", tessellated ? "TerrainTessMaterial" : "TerrainLodMaterial", height_texture_name.c_str(), texture_name.c_str() };
+        Resource* res[4];
+        for (int i = 0; i < 4; i++) {
+            res[i] = resman_->GetResource(names[i]);
+            if (!res[i]) {
+                throw(GameException(std::string("Could not find resource \"") + names[i] + std::string("\"")));
+            }
+        }
+
+        if (tessellated) {
+            return new TessTerrainNode(entity_name, res[0], res[1], res[3], res[2], height_map, width, depth, origin);
+        }
+        return new TerrainNode(entity_name, res[0], res[1], res[3], res[2], height_map, width, depth, origin);
+    }
 }
\ No newline at end of file
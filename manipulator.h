@@ -2,6 +2,10 @@
 #define MANIPULATOR_H
 
 #include "game.h"
+#include "scene_file.h"
+#include "terrain_node.h"
+#include "tess_terrain_node.h"
+#include "prop_batch_node.h"
 
 /*
 The Manipulator class has two primary functions:
@@ -15,39 +19,70 @@ namespace game {
 			Manipulator();
 			~Manipulator();
 
+			// Registry that the builders create entities (and their components) in
+			void SetRegistry(EntityRegistry* registry);
+			// Ground that scene records flagged RecordOnTerrain are placed on
+			void SetTerrain(const Terrain* terrain);
+
 			// (1) Construct hierarchical objects
 			CompositeNode* ConstructKelp(ResourceManager* resman_, std::string name_, int branch_complexity = 4, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructStalagmite(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructSubmarine(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructCoral(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructSeaweed(ResourceManager* resman_, std::string name_, int length_ = 4, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
-			void ConstructSeaweedPatch(ResourceManager* resman_, SceneGraph* scene_, int num_strands, int length, int width, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0)); // Makes a group of seaweed objects based on the given parameters
+			// Makes a group of seaweed objects based on the given parameters and adds them to the scene
+			// Returns the first strand; the others are linked to it so the patch is destroyed as a whole
+			EntityHandle ConstructSeaweedPatch(ResourceManager* resman_, SceneGraph* scene_, int num_strands, int length, int width, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructPart(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructAnemonie(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructParticleSystem(ResourceManager* resman_, std::string entity_name, std::string object_name, std::string material_name, std::string texture_name = std::string(""), glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructRock(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* ConstructVentBase(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
+			// Many copies of one mesh drawn with "PropBatchMaterial" (see PropBatchNode); extent is the mesh's reach from its origin
+			CompositeNode* ConstructPropField(ResourceManager* resman_, std::string name_, std::string object_name, std::string texture_name, const std::vector<PropInstance>& instances, float extent, glm::vec3 color);
+			// Hydrothermal vent stream; hurts the player while switched on
+			CompositeNode* ConstructVent(ResourceManager* resman_, std::string name_, glm::vec3 position_ = glm::vec3(0.0, 0.0, 0.0));
 			CompositeNode* Manipulator::ConstructSkyBox(ResourceManager* resman_, std::string name_, glm::vec3 position_);
 
 
 
-			// Create the sand floor
-			CompositeNode* ConstructPlane(ResourceManager* resman_);
-			// Create the stone boundary/wall
+			// Create the sand floor (a level of detail terrain over the height map)
+			CompositeNode* ConstructPlane(ResourceManager* resman_, const std::vector<float>& height_map, int width, int depth, glm::vec2 origin);
+			// Create the stone boundary/wall (a simplified mesh, see ResourceManager::CreateSimplifiedPlane)
 			CompositeNode* ConstructBoundary(ResourceManager* resman_);
       // Create light source
 			CompositeNode* ConstructSun(ResourceManager* resman, glm::vec3 position_ = glm::vec3(0.0, 20.0, 0.0));
+			// Create a streamed terrain tile from a mesh made with ResourceManager::CreateSimplifiedPlane
+			CompositeNode* ConstructTerrainTile(ResourceManager* resman_, std::string name_, std::string object_name);
+			// Create every object listed in a scene file and add it to the scene
+			// entities_ receives the entity of each record (null if none); records flagged in skip_ are left out
+			void ConstructWorld(ResourceManager* resman_, SceneGraph* scene_, const SceneFile& file_, std::vector<EntityHandle>* entities_ = NULL, const std::vector<char>* skip_ = NULL);
 
 
 			// (2) Animate hierarchical objects
-			void AnimateAll(SceneGraph* scene_, double time_, float theta_);
-			void AnimateKelp(CompositeNode* node_, double time_, float theta_);
-			void AnimateAnemone(CompositeNode* node_, double time_, float theta_);
-			void AnimateSubmarine(CompositeNode* node_, double time_, float theta_);
+			// Runs every entity's Animator component
+			void AnimateAll(SceneGraph* scene_, double time_);
+			void AnimateKelp(CompositeNode* node_, double time_);
+			void AnimateAnemone(CompositeNode* node_, double time_);
+			void AnimateSubmarine(CompositeNode* node_, double time_);
 	
 		private:
+			EntityRegistry* registry_ = nullptr;
+			const Terrain* terrain_ = nullptr;
+
+			// Create the entity for a newly built node
+			EntityHandle CreateEntity(CompositeNode* node_);
+
+			// Give the root and the root's children of a node their sway parameters
+			// Child i is offset in phase by i * phase_step
+			void SetupSway(CompositeNode* node_, glm::vec3 amplitude, float frequency, float phase_step = 0.0f);
+
 			// Copied from game.cpp
 			SceneNode* CreateSceneNodeInstance(std::string entity_name, std::string object_name, std::string material_name, std::string texture_name, ResourceManager* resman_);
+			// Terrain node drawing the height map: tessellated on "TerrainPatchGrid" with "TerrainTessMaterial"
+			// if that material was loaded, otherwise CDLOD on "TerrainGrid" with "TerrainLodMaterial"
+			SceneNode* CreateTerrainNodeInstance(std::string entity_name, std::string height_texture_name, std::string texture_name,
+				const std::vector<float>& height_map, int width, int depth, glm::vec2 origin, ResourceManager* resman_);
 
 	};
 }
@@ -0,0 +1,171 @@
+/*
+ *
+ * Open-addressing hash index from names to objects, used to find scene nodes and resources
+ * by name without scanning whole lists. Lookups take a std::string_view (no temporary strings)
+ * or a NameKey whose hash was computed ahead of time.
+ *
+ */
+#ifndef NAME_INDEX_H_
+#define NAME_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace game {
+
+    // FNV-1a hash of a name
+    constexpr uint32_t HashName(std::string_view name) {
+        uint32_t hash = 2166136261u;
+        for (char c : name) {
+            hash = (hash ^ (unsigned char)c) * 16777619u;
+        }
+        return hash;
+    }
+
+    // A name together with its precomputed hash
+    // e.g. constexpr NameKey sun_key("Sun"); computes the hash at compile time
+    struct NameKey {
+        std::string_view name;
+        uint32_t hash;
+
+        constexpr NameKey(std::string_view n) : name(n), hash(HashName(n)) {}
+    };
+
+    // Maps names to (non-owned) pointers. When the same name is inserted twice the first
+    // entry is kept, matching the "first match" behaviour of a linear scan.
+    template <typename T>
+    class NameIndex {
+
+        public:
+            NameIndex(void) { slot_.resize(16); }
+
+            // Add an entry; returns false (and keeps the old entry) if the name is already present
+            bool Insert(std::string_view name, T* value) {
+                return Insert(NameKey(name), value, false);
+            }
+
+            // Add an entry, replacing any existing entry with the same name
+            void Set(std::string_view name, T* value) {
+                Insert(NameKey(name), value, true);
+            }
+
+            // Find the entry for a name, or NULL
+            T* Find(std::string_view name) const {
+                return Find(NameKey(name));
+            }
+
+            T* Find(const NameKey& key) const {
+                int i = Probe(key);
+                return (i >= 0) ? slot_[i].value : NULL;
+            }
+
+            // Remove the entry for a name, if any
+            void Erase(std::string_view name) {
+                int i = Probe(NameKey(name));
+                if (i >= 0) {
+                    slot_[i].state = Deleted;
+                    slot_[i].key.clear();
+                    slot_[i].value = NULL;
+                    size_--;
+                }
+            }
+
+            void Clear(void) {
+                slot_.assign(16, Slot());
+                size_ = 0;
+                used_ = 0;
+            }
+
+            int GetSize(void) const { return size_; }
+
+        private:
+            enum SlotState { Empty, Full, Deleted };
+
+            struct Slot {
+                std::string key;
+                uint32_t hash = 0;
+                T* value = NULL;
+                SlotState state = Empty;
+            };
+
+            std::vector<Slot> slot_; // Capacity is always a power of two
+            int size_ = 0; // Full slots
+            int used_ = 0; // Full + deleted slots (deleted slots still lengthen probes)
+
+            // Index of the slot holding the key, or -1
+            int Probe(const NameKey& key) const {
+                uint32_t mask = slot_.size() - 1;
+                for (uint32_t i = key.hash & mask; ; i = (i + 1) & mask) {
+                    const Slot& s = slot_[i];
+                    if (s.state == Empty) {
+                        return -1;
+                    }
+                    if (s.state == Full && s.hash == key.hash && s.key == key.name) {
+                        return i;
+                    }
+                }
+            }
+
+            bool Insert(const NameKey& key, T* value, bool replace) {
+                int found = Probe(key);
+                if (found >= 0) {
+                    if (replace) {
+                        slot_[found].value = value;
+                    }
+                    return replace;
+                }
+
+                // Keep the table at most 70% used so probe sequences stay short
+                if ((used_ + 1) * 10 > slot_.size() * 7) {
+                    Rehash((size_ + 1) * 10 > slot_.size() * 5 ? slot_.size() * 2 : slot_.size());
+                }
+
+                uint32_t mask = slot_.size() - 1;
+                uint32_t i = key.hash & mask;
+                while (slot_[i].state == Full) {
+                    i = (i + 1) & mask;
+                }
+                if (slot_[i].state == Empty) {
+                    used_++;
+                }
+                slot_[i].key = std::string(key.name);
+                slot_[i].hash = key.hash;
+                slot_[i].value = value;
+                slot_[i].state = Full;
+                size_++;
+                return true;
+            }
+
+            // Rebuild the table with the given capacity, dropping deleted slots
+            void Rehash(size_t capacity) {
+                std::vector<Slot> old;
+                old.swap(slot_);
+                slot_.resize(capacity);
+                size_ = 0;
+                used_ = 0;
+
+                uint32_t mask = capacity - 1;
+                for (int n = 0; n < old.size(); n++) {
+                    if (old[n].state != Full) {
+                        continue;
+                    }
+                    uint32_t i = old[n].hash & mask;
+                    while (slot_[i].state == Full) {
+                        i = (i + 1) & mask;
+                    }
+                    slot_[i].key.swap(old[n].key);
+                    slot_[i].hash = old[n].hash;
+                    slot_[i].value = old[n].value;
+                    slot_[i].state = Full;
+                    size_++;
+                    used_++;
+                }
+            }
+
+    }; // class NameIndex
+
+} // namespace game
+
+#endif // NAME_INDEX_H_
@@ -0,0 +1,91 @@
+/*
+ *
+ * Slab allocator for scene objects. Objects are carved out of large blocks (slabs) instead of
+ * being allocated one by one, so nodes built together sit next to each other in memory, freeing
+ * a node is just pushing it on a free list, and a whole world can be released in one go.
+ *
+ * Not thread-safe: nodes are only created and deleted on the main thread.
+ *
+ */
+#ifndef NODE_POOL_H_
+#define NODE_POOL_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace game {
+
+    template <typename T, int SlabSize = 256>
+    class NodePool {
+
+        public:
+            NodePool(void) {}
+            ~NodePool() { FreeSlabs(); }
+
+            // Memory for one object
+            void* Allocate(void) {
+                if (free_ == nullptr) {
+                    AddSlab();
+                }
+                Slot* slot = free_;
+                free_ = slot->next;
+                live_++;
+                return slot;
+            }
+
+            // Give back memory from Allocate (the object must already be destroyed)
+            void Free(void* p) {
+                Slot* slot = static_cast<Slot*>(p);
+                slot->next = free_;
+                free_ = slot;
+                live_--;
+            }
+
+            // Return all slabs to the system once every object has been freed
+            // Returns false (and keeps the slabs) if objects are still alive
+            bool Release(void) {
+                if (live_ != 0) {
+                    return false;
+                }
+                FreeSlabs();
+                return true;
+            }
+
+            int GetLive(void) const { return live_; }
+
+        private:
+            union Slot {
+                Slot* next;
+                alignas(T) unsigned char storage[sizeof(T)];
+            };
+
+            std::vector<Slot*> slab_;
+            Slot* free_ = nullptr; // Free list threaded through unused slots
+            int live_ = 0; // Allocated objects
+
+            void AddSlab(void) {
+                Slot* slab = static_cast<Slot*>(::operator new(sizeof(Slot) * SlabSize));
+                slab_.push_back(slab);
+
+                // Link in address order so consecutive allocations are contiguous
+                for (int i = 0; i < SlabSize - 1; i++) {
+                    slab[i].next = &slab[i + 1];
+                }
+                slab[SlabSize - 1].next = free_;
+                free_ = slab;
+            }
+
+            void FreeSlabs(void) {
+                for (int i = 0; i < slab_.size(); i++) {
+                    ::operator delete(slab_[i]);
+                }
+                slab_.clear();
+                free_ = nullptr;
+            }
+
+    }; // class NodePool
+
+} // namespace game
+
+#endif // NODE_POOL_H_
@@ -34,8 +34,9 @@ void main()
     vec2 coord = tile_count * vertex_uv; // multiply by a constant (10) to tile the texture
 
     coord.y = 1.0 - coord.y;
-    N = (texture2D(texture_map, coord).rgb);
-    N = normalize(N * 2.0 - 1.0); // change scale from 0 to 1 --> -1 to 1
+    N.xy = texture2D(texture_map, coord).rg * 2.0 - 1.0; // change scale from 0 to 1 --> -1 to 1
+    N.z = sqrt(max(1.0 - dot(N.xy, N.xy), 0.0)); // compressed normal maps only keep x and y
+    N = normalize(N);
     
     V = normalize(view_vector);
     L = normalize(light_vector);
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "prop_batch_node.h"
+
+namespace game {
+
+    // Read straight from the instance buffer as a vec4 and a vec2
+    static_assert(sizeof(PropInstance) == 6 * sizeof(GLfloat), "PropInstance must be tightly packed");
+
+    PropBatchNode::PropBatchNode(const std::string name, const Resource* geometry, const Resource* material, const Resource* texture,
+        const std::vector<PropInstance>& instance, float extent, float cell_size) : SceneNode(name, geometry, material, texture, 0) {
+
+        if (geometry->GetType() != Mesh) {
+            throw(std::invalid_argument(std::string("Props must be meshes")));
+        }
+        if (cell_size <= 0.0f) {
+            throw(std::invalid_argument(std::string("Invalid prop cell size")));
+        }
+
+        instance_buffer_ = 0;
+        num_instances_ = instance.size();
+        draw_distance_ = 150.0f;
+        if (instance.empty()) {
+            return;
+        }
+
+        // Sort the instances into cells
+        glm::vec2 min_position(INFINITY);
+        for (int i = 0; i < instance.size(); i++) {
+            min_position = glm::min(min_position, glm::vec2(instance[i].position.x, instance[i].position.z));
+        }
+        std::vector<std::pair<long long, int>> key(instance.size());
+        for (int i = 0; i < instance.size(); i++) {
+            long long cell_x = (long long)((instance[i].position.x - min_position.x) / cell_size);
+            long long cell_z = (long long)((instance[i].position.z - min_position.y) / cell_size);
+            key[i] = std::make_pair((cell_z << 32) | cell_x, i);
+        }
+        std::sort(key.begin(), key.end());
+
+        std::vector<PropInstance> sorted(instance.size());
+        for (int i = 0; i < key.size(); i++) {
+            const PropInstance& prop = instance[key[i].second];
+            sorted[i] = prop;
+            glm::vec3 reach(extent * prop.scale);
+            reach.y *= std::max(prop.stretch, 1.0f);
+            if (i == 0 || key[i].first != key[i - 1].first) {
+                Cell cell;
+                cell.first = i;
+                cell.count = 0;
+                cell.min_corner = prop.position - reach;
+                cell.max_corner = prop.position + reach;
+                cell_.push_back(cell);
+            }
+            Cell& cell = cell_.back();
+            cell.count++;
+            cell.min_corner = glm::min(cell.min_corner, prop.position - reach);
+            cell.max_corner = glm::max(cell.max_corner, prop.position + reach);
+        }
+
+        glGenBuffers(1, &instance_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+        glBufferData(GL_ARRAY_BUFFER, sorted.size() * sizeof(PropInstance), sorted.data(), GL_STATIC_DRAW);
+    }
+
+
+    PropBatchNode::~PropBatchNode() {
+
+        if (instance_buffer_) {
+            glDeleteBuffers(1, &instance_buffer_);
+        }
+    }
+
+
+    void PropBatchNode::Draw(Camera* camera, SceneNode* light) {
+
+        if (cell_.empty() || !HasResources()) {
+            return;
+        }
+
+        // Cells are tested in the space of the node
+        glm::mat4 to_local = glm::inverse(GetWorldTransf());
+        glm::vec3 eye = glm::vec3(to_local * glm::vec4(camera->GetPosition(), 1.0f));
+        glm::vec3 forward = glm::vec3(to_local * glm::vec4(camera->GetForward(), 0.0f));
+
+        GLuint program = GetMaterial();
+        glUseProgram(program);
+        glBindBuffer(GL_ARRAY_BUFFER, GetArrayBuffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetElementArrayBuffer());
+        camera->SetupShader(program);
+        SetupShader(program, camera, light);
+
+        // Per instance attributes, advanced once per instance instead of per vertex
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+        GLint instance_att = glGetAttribLocation(program, "instance");
+        GLint shape_att = glGetAttribLocation(program, "instance_shape");
+        glEnableVertexAttribArray(instance_att);
+        glEnableVertexAttribArray(shape_att);
+        glVertexAttribDivisor(instance_att, 1);
+        glVertexAttribDivisor(shape_att, 1);
+
+        for (int i = 0; i < cell_.size(); i++) {
+            const Cell& cell = cell_[i];
+            glm::vec3 offset = glm::clamp(eye, cell.min_corner, cell.max_corner) - eye;
+            if (glm::dot(offset, offset) > draw_distance_ * draw_distance_) {
+                continue;
+            }
+            glm::vec3 farthest(forward.x >= 0.0f ? cell.max_corner.x : cell.min_corner.x, forward.y >= 0.0f ? cell.max_corner.y : cell.min_corner.y, forward.z >= 0.0f ? cell.max_corner.z : cell.min_corner.z);
+            if (glm::dot(farthest - eye, forward) < 0.0f) {
+                continue;
+            }
+
+            size_t first = cell.first * sizeof(PropInstance);
+            glVertexAttribPointer(instance_att, 4, GL_FLOAT, GL_FALSE, sizeof(PropInstance), (void*)first);
+            glVertexAttribPointer(shape_att, 2, GL_FLOAT, GL_FALSE, sizeof(PropInstance), (void*)(first + offsetof(PropInstance, yaw)));
+            glDrawElementsInstanced(GL_TRIANGLES, GetSize(), GL_UNSIGNED_INT, 0, cell.count);
+        }
+
+        // Other nodes draw without instancing
+        glVertexAttribDivisor(instance_att, 0);
+        glVertexAttribDivisor(shape_att, 0);
+        glDisableVertexAttribArray(instance_att);
+        glDisableVertexAttribArray(shape_att);
+    }
+
+} // namespace game
@@ -0,0 +1,57 @@
+/*
+ *
+ * Scene node that draws one mesh at many places with instancing (OpenGL 3.3). Every instance
+ * has a position, a scale, a turn about the vertical axis and a vertical stretch, kept in one
+ * buffer sorted into square cells of the floor; each cell is drawn with one instanced call,
+ * and cells behind the camera or past the draw distance are skipped. Meant for scattered
+ * props (PropScatter) that do not animate or collide.
+ *
+ */
+#ifndef PROP_BATCH_NODE_H_
+#define PROP_BATCH_NODE_H_
+
+#include <vector>
+
+#include "scene_node.h"
+
+namespace game {
+
+    struct PropInstance {
+        glm::vec3 position;
+        float scale;
+        float yaw; // Radians about the vertical axis
+        float stretch; // Extra scale along the vertical axis
+    };
+
+    class PropBatchNode : public SceneNode {
+
+        public:
+            // geometry is drawn once per instance; extent is the largest distance of the mesh
+            // from its origin (for the bounds of the cells)
+            PropBatchNode(const std::string name, const Resource* geometry, const Resource* material, const Resource* texture,
+                const std::vector<PropInstance>& instance, float extent = 1.0f, float cell_size = 32.0f);
+            virtual ~PropBatchNode();
+
+            // Cells farther than this are not drawn
+            void SetDrawDistance(float distance) { draw_distance_ = distance; }
+            int GetNumInstances(void) const { return num_instances_; }
+
+            virtual void Draw(Camera* camera, SceneNode* light);
+
+        private:
+            struct Cell {
+                int first; // Instances
+                int count;
+                glm::vec3 min_corner;
+                glm::vec3 max_corner;
+            };
+            std::vector<Cell> cell_;
+            GLuint instance_buffer_;
+            int num_instances_;
+            float draw_distance_;
+
+    }; // class PropBatchNode
+
+} // namespace game
+
+#endif // PROP_BATCH_NODE_H_
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#include "prop_scatter.h"
+
+namespace game {
+
+    PropScatter::PropScatter(void) : width_(0), depth_(0), origin_(0.0f) {
+    }
+
+
+    void PropScatter::Init(std::vector<float> density, int width, int depth, glm::vec2 origin) {
+
+        if (width < 1 || depth < 1 || density.size() < (size_t)width * depth) {
+            throw(std::invalid_argument(std::string("Invalid density map size")));
+        }
+        density_ = std::move(density);
+        width_ = width;
+        depth_ = depth;
+        origin_ = origin;
+    }
+
+
+    void PropScatter::Exclude(const std::vector<float>& exclusion) {
+
+        if (exclusion.size() < density_.size()) {
+            throw(std::invalid_argument(std::string("Exclusion map smaller than the density map")));
+        }
+        for (size_t i = 0; i < density_.size(); i++) {
+            if (exclusion[i] != 0.0f) {
+                density_[i] = 0.0f;
+            }
+        }
+    }
+
+
+    std::vector<float> PropScatter::DensityFromTerrain(const Terrain& terrain, float min_height, float max_height, float max_slope, float fade) {
+
+        int width = terrain.GetWidth() - 1;
+        int depth = terrain.GetDepth() - 1;
+        std::vector<float> density((size_t)std::max(width, 0) * std::max(depth, 0), 0.0f);
+        for (int z = 0; z < depth; z++) {
+            for (int x = 0; x < width; x++) {
+                if (terrain.GetCellSlope(x, z) > max_slope) {
+                    continue;
+                }
+                float height = (terrain.GetSample(x, z) + terrain.GetSample(x + 1, z) + terrain.GetSample(x, z + 1) + terrain.GetSample(x + 1, z + 1)) * 0.25f;
+                float outside = std::max(min_height - height, height - max_height);
+                density[x + width * z] = (outside <= 0.0f) ? 1.0f : std::max(1.0f - outside / fade, 0.0f);
+            }
+        }
+        return density;
+    }
+
+
+    void PropScatter::Scatter(float spacing, uint32_t seed, ThreadPool* pool, std::vector<glm::vec2>& result) const {
+
+        if (density_.empty() || spacing <= 0.0f) {
+            return;
+        }
+
+        // Background grid with at most one point per cell (its diagonal is the spacing), so a
+        // point closer than the spacing is at most two cells away
+        float cell = spacing / std::sqrt(2.0f);
+        int grid_width = (int)std::ceil(width_ / cell);
+        int grid_depth = (int)std::ceil(depth_ / cell);
+        std::vector<glm::vec2> grid_point((size_t)grid_width * grid_depth);
+        std::vector<char> grid_used((size_t)grid_width * grid_depth, 0);
+
+        // Tiles of about 16 units, and at least two cells so that the checks of a tile never
+        // reach past its neighbours
+        int tile_cells = std::max(2, (int)std::ceil(16.0f / cell));
+        int tiles_x = (grid_width + tile_cells - 1) / tile_cells;
+        int tiles_z = (grid_depth + tile_cells - 1) / tile_cells;
+        std::vector<std::vector<glm::vec2>> kept((size_t)tiles_x * tiles_z);
+
+        auto fill_tile = [&](int tile_x, int tile_z) {
+
+            std::mt19937 random(seed ^ ((uint32_t)tile_x * 73856093u) ^ ((uint32_t)tile_z * 19349663u));
+            auto uniform = [&random]() { return (float)(random() >> 8) * (1.0f / 16777216.0f); };
+
+            int cell_x0 = tile_x * tile_cells, cell_x1 = std::min(cell_x0 + tile_cells, grid_width);
+            int cell_z0 = tile_z * tile_cells, cell_z1 = std::min(cell_z0 + tile_cells, grid_depth);
+            float x0 = cell_x0 * cell, x1 = std::min(cell_x1 * cell, (float)width_);
+            float z0 = cell_z0 * cell, z1 = std::min(cell_z1 * cell, (float)depth_);
+            float spacing2 = spacing * spacing;
+
+            // Enough darts that the tile is close to full
+            int darts = 8 * (cell_x1 - cell_x0) * (cell_z1 - cell_z0);
+            std::vector<glm::vec2>& tile = kept[tile_x + tiles_x * tile_z];
+            for (int i = 0; i < darts; i++) {
+                glm::vec2 p(x0 + uniform() * (x1 - x0), z0 + uniform() * (z1 - z0));
+                float keep = uniform();
+                int gx = std::min((int)(p.x / cell), grid_width - 1);
+                int gz = std::min((int)(p.y / cell), grid_depth - 1);
+                if (grid_used[gx + grid_width * gz]) {
+                    continue;
+                }
+                bool free = true;
+                for (int nz = std::max(gz - 2, 0); nz <= std::min(gz + 2, grid_depth - 1) && free; nz++) {
+                    for (int nx = std::max(gx - 2, 0); nx <= std::min(gx + 2, grid_width - 1); nx++) {
+                        glm::vec2 d = grid_point[nx + grid_width * nz] - p;
+                        if (grid_used[nx + grid_width * nz] && glm::dot(d, d) < spacing2) {
+                            free = false;
+                            break;
+                        }
+                    }
+                }
+                if (!free) {
+                    continue;
+                }
+                grid_point[gx + grid_width * gz] = p;
+                grid_used[gx + grid_width * gz] = 1;
+
+                // Thinning keeps the spacing; dropped points still block their neighbourhood
+                int density_x = std::min((int)p.x, width_ - 1);
+                int density_z = std::min((int)p.y, depth_ - 1);
+                if (keep < density_[density_x + width_ * density_z]) {
+                    tile.push_back(p + origin_);
+                }
+            }
+        };
+
+        for (int pass = 0; pass < 4; pass++) {
+            int first_x = pass & 1;
+            int first_z = pass >> 1;
+            int count_x = (tiles_x - first_x + 1) / 2;
+            int count_z = (tiles_z - first_z + 1) / 2;
+            auto fill = [&](int i) {
+                fill_tile(first_x + 2 * (i % count_x), first_z + 2 * (i / count_x));
+            };
+            if (count_x * count_z == 0) {
+                continue;
+            }
+            if (pool) {
+                pool->ParallelFor(count_x * count_z, fill);
+            }
+            else {
+                for (int i = 0; i < count_x * count_z; i++) {
+                    fill(i);
+                }
+            }
+        }
+
+        for (int i = 0; i < kept.size(); i++) {
+            result.insert(result.end(), kept[i].begin(), kept[i].end());
+        }
+    }
+
+} // namespace game
@@ -0,0 +1,56 @@
+/*
+ *
+ * Scatters props over the sea floor. Placements are a Poisson disk sample (no two closer than
+ * the spacing) thinned by a density map, so props are spread evenly where the density is high
+ * and get sparse where it falls off. The field is cut into square tiles filled in four passes;
+ * the tiles of one pass are at least a tile apart, so they are filled in parallel. Every tile
+ * has its own generator seeded from the seed and the tile, so a seed always gives the same
+ * placements however many threads there are.
+ *
+ */
+#ifndef PROP_SCATTER_H_
+#define PROP_SCATTER_H_
+
+#include <cstdint>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+#include "thread_pool.h"
+
+namespace game {
+
+    class PropScatter {
+
+        public:
+            PropScatter(void);
+
+            // Take over a density in [0, 1] for each of width x depth cells of one unit (row by
+            // row along z); cell (0, 0) starts at origin (x, z)
+            void Init(std::vector<float> density, int width, int depth, glm::vec2 origin);
+            // Leave out the cells where exclusion (same size as the density) is nonzero
+            void Exclude(const std::vector<float>& exclusion);
+
+            // Density over the cells of a terrain: 1 between min_height and max_height on cells
+            // no steeper than max_slope, fading out over fade units of height outside the range
+            static std::vector<float> DensityFromTerrain(const Terrain& terrain, float min_height, float max_height, float max_slope, float fade = 1.0f);
+
+            // Add positions (x, z) at least spacing apart to result, tile by tile; the pool may
+            // be NULL
+            void Scatter(float spacing, uint32_t seed, ThreadPool* pool, std::vector<glm::vec2>& result) const;
+
+            int GetWidth(void) const { return width_; }
+            int GetDepth(void) const { return depth_; }
+
+        private:
+            std::vector<float> density_;
+            int width_;
+            int depth_;
+            glm::vec2 origin_;
+
+    }; // class PropScatter
+
+} // namespace game
+
+#endif // PROP_SCATTER_H_
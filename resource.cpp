@@ -9,6 +9,8 @@ Resource::Resource(ResourceType type, std::string name, GLuint resource, GLsizei
     name_ = name;
     resource_ = resource;
     size_ = size;
+    slot_ = 0xFFFFFFFF;
+    generation_ = 0;
 }
 
 
@@ -18,6 +20,8 @@ Resource::Resource(ResourceType type, std::string name, GLuint array_buffer, GLu
     array_buffer_ = array_buffer;
     element_array_buffer_ = element_array_buffer;
     size_ = size;
+    slot_ = 0xFFFFFFFF;
+    generation_ = 0;
 }
 
 
@@ -61,4 +65,37 @@ GLsizei Resource::GetSize(void) const {
     return size_;
 }
 
+
+MeshHandle Resource::GetMeshHandle(void) const {
+
+    MeshHandle handle;
+    if (type_ == Mesh || type_ == PointSet){
+        handle.index = slot_;
+        handle.generation = generation_;
+    }
+    return handle;
+}
+
+
+MaterialHandle Resource::GetMaterialHandle(void) const {
+
+    MaterialHandle handle;
+    if (type_ == Material){
+        handle.index = slot_;
+        handle.generation = generation_;
+    }
+    return handle;
+}
+
+
+TextureHandle Resource::GetTextureHandle(void) const {
+
+    TextureHandle handle;
+    if (type_ == Texture){
+        handle.index = slot_;
+        handle.generation = generation_;
+    }
+    return handle;
+}
+
 } // namespace game
@@ -6,6 +6,8 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "resource_handle.h"
+
 namespace game {
 
     // Possible resource types
@@ -27,6 +29,10 @@ namespace game {
                 };
             };
             GLsizei size_; // Number of primitives in geometry
+            // Where the ResourceManager keeps it
+            uint32_t slot_;
+            uint32_t generation_;
+            friend class ResourceManager;
 
         public:
             Resource(ResourceType type, std::string name, GLuint resource, GLsizei size);
@@ -39,6 +45,11 @@ namespace game {
             GLuint GetElementArrayBuffer(void) const;
             GLsizei GetSize(void) const;
 
+            // Handles to this resource; null if it is of another type
+            MeshHandle GetMeshHandle(void) const;
+            MaterialHandle GetMaterialHandle(void) const;
+            TextureHandle GetTextureHandle(void) const;
+
     }; // class Resource
 
 } // namespace game
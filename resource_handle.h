@@ -0,0 +1,40 @@
+/*
+ *
+ * Typed handles to resources of the ResourceManager. A handle is a slot in the manager's slot
+ * table and the generation of the slot when the handle was issued, so resolving it is one index
+ * and one compare. Reloading a resource keeps its handles valid (they resolve to the new OpenGL
+ * objects); removing it starts a new generation, so old handles stop resolving instead of
+ * pointing at whatever takes the slot next. The tag keeps a texture handle from being used
+ * where a mesh is expected.
+ *
+ */
+#ifndef RESOURCE_HANDLE_H_
+#define RESOURCE_HANDLE_H_
+
+#include <cstdint>
+
+namespace game {
+
+    template <typename Tag>
+    struct ResourceHandle {
+        uint32_t index = 0xFFFFFFFF; // Slot in the manager's slot table
+        uint32_t generation = 0; // Generation of the slot when the handle was issued
+
+        // True for a handle that was never assigned
+        inline bool IsNull(void) const { return index == 0xFFFFFFFF; }
+
+        inline bool operator==(const ResourceHandle& other) const { return index == other.index && generation == other.generation; }
+        inline bool operator!=(const ResourceHandle& other) const { return !(*this == other); }
+    };
+
+    struct MeshTag {};
+    struct MaterialTag {};
+    struct TextureTag {};
+
+    typedef ResourceHandle<MeshTag> MeshHandle; // Meshes and point sets
+    typedef ResourceHandle<MaterialTag> MaterialHandle;
+    typedef ResourceHandle<TextureTag> TextureHandle;
+
+} // namespace game
+
+#endif // RESOURCE_HANDLE_H_
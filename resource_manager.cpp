@@ -2,44 +2,111 @@
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stdexcept>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iterator>
+#include <mutex>
 #include <SOIL/SOIL.h>
 #include <glm/gtx/string_cast.hpp>
 
 #include "resource_manager.h"
 #include "model_loader.h"
+#include "texture_file.h"
 
 namespace game {
 
 ResourceManager::ResourceManager(void){
+
+    pool_ = NULL;
 }
 
 
 ResourceManager::~ResourceManager(){
+
+    // Decoding jobs still write into the loads
+    if (pool_){
+        pool_->WaitUntil([this]() { return texture_jobs_.IsDone(); });
+    }
 }
 
 
 void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size){
 
-    Resource *res;
+    AddResource(new Resource(type, name, resource, size));
+}
+
+
+void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
+
+    AddResource(new Resource(type, name, array_buffer, element_array_buffer, size));
+}
+
+
+void ResourceManager::AddResource(Resource* res){
 
-    res = new Resource(type, name, resource, size);
+    // Reuse the slot of a removed resource (its generation has moved on already)
+    if (free_slot_.empty()){
+        free_slot_.push_back(slot_.size());
+        slot_.push_back(Slot());
+    }
+    res->slot_ = free_slot_.back();
+    free_slot_.pop_back();
+    res->generation_ = slot_[res->slot_].generation;
+    slot_[res->slot_].resource = res;
 
     resource_.push_back(res);
+    index_.Insert(res->GetName(), res);
 }
 
 
-void ResourceManager::AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size){
+void ResourceManager::DeleteObjects(const Resource* res){
 
-    Resource *res;
+    if (res->GetType() == Mesh || res->GetType() == PointSet){
+        GLuint buffer[2] = { res->GetArrayBuffer(), res->GetElementArrayBuffer() };
+        glDeleteBuffers(2, buffer);
+    } else if (res->GetType() == Texture){
+        GLuint texture = res->GetResource();
+        glDeleteTextures(1, &texture);
+    } else if (res->GetType() == Material){
+        glDeleteProgram(res->GetResource());
+    }
+}
 
-    res = new Resource(type, name, array_buffer, element_array_buffer, size);
 
-    resource_.push_back(res);
+void ResourceManager::RemoveResource(std::string_view name){
+
+    Resource *res = index_.Find(name);
+    if (!res){
+        return;
+    }
+
+    DeleteObjects(res);
+
+    // Handles to the slot stop resolving
+    Slot& slot = slot_[res->slot_];
+    slot.resource = NULL;
+    slot.generation++;
+    free_slot_.push_back(res->slot_);
+
+    resource_.erase(std::find(resource_.begin(), resource_.end(), res));
+    index_.Erase(name);
+    delete res;
+
+    // Another resource with the same name takes over the name
+    for (int i = 0; i < resource_.size(); i++){
+        if (resource_[i]->GetName() == name){
+            index_.Insert(resource_[i]->GetName(), resource_[i]);
+            break;
+        }
+    }
 }
 
+
 void ResourceManager::LoadResource(ResourceType type, const std::string name, const char *filename){
 
     // Call appropriate method depending on type of resource
@@ -56,26 +123,94 @@ void ResourceManager::LoadResource(ResourceType type, const std::string name, co
 }
 
 
-Resource *ResourceManager::GetResource(const std::string name) const {
+Resource *ResourceManager::GetResource(std::string_view name) const {
 
     // Find resource with the specified name
-    for (int i = 0; i < resource_.size(); i++){
-        if (resource_[i]->GetName() == name){
-            return resource_[i];
+    return index_.Find(name);
+}
+
+
+Resource *ResourceManager::GetResource(const NameKey& key) const {
+
+    return index_.Find(key);
+}
+
+
+MeshHandle ResourceManager::GetMeshHandle(std::string_view name) const {
+
+    Resource *res = index_.Find(name);
+    return res ? res->GetMeshHandle() : MeshHandle();
+}
+
+
+MaterialHandle ResourceManager::GetMaterialHandle(std::string_view name) const {
+
+    Resource *res = index_.Find(name);
+    return res ? res->GetMaterialHandle() : MaterialHandle();
+}
+
+
+TextureHandle ResourceManager::GetTextureHandle(std::string_view name) const {
+
+    Resource *res = index_.Find(name);
+    return res ? res->GetTextureHandle() : TextureHandle();
+}
+
+
+void ResourceManager::ReloadResource(ResourceType type, const std::string name, const char *filename){
+
+    Resource *res = index_.Find(name);
+    if (!res){
+        LoadResource(type, name, filename);
+        return;
+    }
+    if (res->GetType() != type){
+        throw(std::invalid_argument(std::string("Cannot reload ") + name + std::string(" as another type of resource")));
+    }
+
+    // Load under a name of its own first, so a failure leaves the old resource alone
+    std::string temporary_name = name + std::string("#reload");
+    LoadResource(type, temporary_name, filename);
+    if (type == Texture){
+        // Textures load in the background; take over the finished one
+        try {
+            FinishTextures();
+        }
+        catch (...){
+            RemoveResource(temporary_name);
+            throw;
         }
     }
-    return NULL;
+    Resource *fresh = index_.Find(temporary_name);
+
+    // The existing resource (and its slot) takes over the new objects
+    DeleteObjects(res);
+    if (type == Mesh || type == PointSet){
+        res->array_buffer_ = fresh->array_buffer_;
+        res->element_array_buffer_ = fresh->element_array_buffer_;
+    } else {
+        res->resource_ = fresh->resource_;
+    }
+    res->size_ = fresh->size_;
+
+    Slot& slot = slot_[fresh->slot_];
+    slot.resource = NULL;
+    slot.generation++;
+    free_slot_.push_back(fresh->slot_);
+    resource_.erase(std::find(resource_.begin(), resource_.end(), fresh));
+    index_.Erase(temporary_name);
+    delete fresh;
 }
 
 
-void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
+void ResourceManager::LoadMaterial(const std::string name, const char *prefix, const char *fragment_prefix){
 
     // Load vertex program source code
     std::string filename = std::string(prefix) + std::string(VERTEX_PROGRAM_EXTENSION);
     std::string vp = LoadTextFile(filename.c_str());
 
     // Load fragment program source code
-    filename = std::string(prefix) + std::string(FRAGMENT_PROGRAM_EXTENSION);
+    filename = std::string(fragment_prefix ? fragment_prefix : prefix) + std::string(FRAGMENT_PROGRAM_EXTENSION);
     std::string fp = LoadTextFile(filename.c_str());
 
     // Create a shader from the vertex program source code
@@ -107,33 +242,36 @@ void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
         throw(std::ios_base::failure(std::string("Error compiling fragment shader: ") + std::string(buffer)));
     }
 
-    // Try to also load a geometry shader
-    filename = std::string(prefix) + std::string(GEOMETRY_PROGRAM_EXTENSION);
-    bool geometry_program = false;
-    std::string gp = "";
-    GLuint gs;
-    try {
-        gp = LoadTextFile(filename.c_str());
-        geometry_program = true;
-    }
-    catch (std::exception& e) {
-    }
+    // Try to also load the optional stages: geometry, tessellation control and evaluation
+    const int num_optional = 3;
+    const GLenum optional_type[num_optional] = { GL_GEOMETRY_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER };
+    const char* optional_extension[num_optional] = { GEOMETRY_PROGRAM_EXTENSION, TESS_CONTROL_PROGRAM_EXTENSION, TESS_EVALUATION_PROGRAM_EXTENSION };
+    const char* optional_name[num_optional] = { "geometry", "tessellation control", "tessellation evaluation" };
+    GLuint optional_shader[num_optional] = { 0, 0, 0 };
+    for (int i = 0; i < num_optional; i++) {
+        filename = std::string(prefix) + std::string(optional_extension[i]);
+        std::string source;
+        try {
+            source = LoadTextFile(filename.c_str());
+        }
+        catch (std::exception& e) {
+            continue;
+        }
 
-    if (geometry_program) {
-        // Create a shader from the geometry program source code
-        gs = glCreateShader(GL_GEOMETRY_SHADER);
-        const char* source_gp = gp.c_str();
-        glShaderSource(gs, 1, &source_gp, NULL);
-        glCompileShader(gs);
+        // Create a shader from the program source code
+        GLuint shader = glCreateShader(optional_type[i]);
+        const char* source_op = source.c_str();
+        glShaderSource(shader, 1, &source_op, NULL);
+        glCompileShader(shader);
 
         // Check if shader compiled successfully
-        GLint status;
-        glGetShaderiv(gs, GL_COMPILE_STATUS, &status);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
         if (status != GL_TRUE) {
             char buffer[512];
-            glGetShaderInfoLog(gs, 512, NULL, buffer);
-            throw(std::ios_base::failure(std::string("Error compiling geometry shader: ") + std::string(buffer)));
+            glGetShaderInfoLog(shader, 512, NULL, buffer);
+            throw(std::ios_base::failure(std::string("Error compiling ") + optional_name[i] + std::string(" shader: ") + std::string(buffer)));
         }
+        optional_shader[i] = shader;
     }
 
     // Create a shader program linking both vertex and fragment shaders
@@ -141,8 +279,10 @@ void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
     GLuint sp = glCreateProgram();
     glAttachShader(sp, vs);
     glAttachShader(sp, fs);
-    if (geometry_program) {
-        glAttachShader(sp, gs);
+    for (int i = 0; i < num_optional; i++) {
+        if (optional_shader[i]) {
+            glAttachShader(sp, optional_shader[i]);
+        }
     }
     glLinkProgram(sp);
 
@@ -158,8 +298,10 @@ void ResourceManager::LoadMaterial(const std::string name, const char *prefix){
     // and linked
     glDeleteShader(vs);
     glDeleteShader(fs);
-    if (geometry_program) {
-        glDeleteShader(gs);
+    for (int i = 0; i < num_optional; i++) {
+        if (optional_shader[i]) {
+            glDeleteShader(optional_shader[i]);
+        }
     }
 
     // Add a resource for the shader program
@@ -621,205 +763,315 @@ void ResourceManager::CreateTorus(std::string object_name, float loop_radius, fl
     AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
 }
 
-void ResourceManager::CreatePlane(std::string object_name, std::vector<float> height_map, int length, int width, int offsetX, int offsetZ) {
-
-    const GLuint vertex_num = length * width;
-    const GLuint face_num = length * width * 2;
-
-    const int vertex_att = 11; // attributes
-    const int face_att = 3;
-
-    GLfloat* vertex = NULL; // data buffers
-    GLuint* face = NULL;
-
-    // Allocate memory for buffers
-    try {
-        vertex = new GLfloat[vertex_num * vertex_att]; // 11 attributes per vertex: 3D position (3), 3D normal (3), RGB color (3), 2D texture coordinates (2)
-        face = new GLuint[face_num * face_att]; // 3 indices per face
-    }
-    catch (std::exception& e) {
-        throw e;
-    }
-
-    // Create vertices 
-    float uv_x = 0.0f;
-    float uv_z = 0.0f; // UV coordinates (z becomes y)
-    glm::vec3 vertex_position = glm::vec3(0,0,0);
-    glm::vec3 vertex_normal = glm::vec3(0,0,0);
-    glm::vec3 vertex_color = glm::vec3(0,0,0); // store tangent
-    glm::vec2 vertex_coord = glm::vec2(0,0); // uv mapping
-
-    glm::vec3 edge_U = glm::vec3(0, 0, 0);
-    glm::vec3 edge_V = glm::vec3(0, 0, 0);
-
-    int iter_length = height_map.size() / width;
-    int iter_width = height_map.size() / length;
+// Right-triangulated irregular network (RTIN, as in Evans et al. and "Martini"): the plane is
+// split into right triangles by recursively halving the hypotenuse. The error of a split
+// point is the height difference to the interpolated hypotenuse, raised to the errors of
+// every split point below it, so cutting the recursion where the error is small enough never
+// leaves a crack
+class PlaneSimplifier {
+
+    public:
+        PlaneSimplifier(const std::vector<float>& height_map, int length, int width, float max_error, const std::vector<float>* cover)
+            : height_(height_map.data()), length_(length), width_(width), max_error_(max_error) {
+
+            // The triangulation needs a square of 2^k + 1 samples; triangles that cross the
+            // edge of a smaller map are always split, the ones past it are dropped
+            size_ = 2;
+            while (size_ - 1 < std::max(length, width) - 1) {
+                size_ = (size_ - 1) * 2 + 1;
+            }
 
-    std::vector<glm::vec3> adjacent_vertices;
-    adjacent_vertices.reserve(8);
+            // Samples covered by the other surface, counted per rectangle with a summed table
+            if (cover) {
+                covered_.assign((size_t)(length_ + 1) * (width_ + 1), 0);
+                for (int z = 0; z < length_; z++) {
+                    for (int x = 0; x < width_; x++) {
+                        int hidden = (height_[x + width_ * z] + max_error_ < (*cover)[x + width_ * z]) ? 1 : 0;
+                        covered_[(x + 1) + (width_ + 1) * (z + 1)] = hidden + covered_[x + (width_ + 1) * (z + 1)] + covered_[(x + 1) + (width_ + 1) * z] - covered_[x + (width_ + 1) * z];
+                    }
+                }
+            }
 
-    std::vector<glm::vec3> edges;
-    edges.reserve(8);
+            ComputeErrors();
+        }
 
-    int dx = 0;
-    int dz = 0;
+        // Append the triangles to face; vertex_sample receives the map sample (x + width * z)
+        // of each vertex they index
+        void Extract(std::vector<GLuint>& face, std::vector<int>& vertex_sample) {
 
-    for (int _z = 0; _z < iter_length; _z++) { // z coordinate loop | [0,1,2,...,length-1]
-        uv_z = (float)_z / (float)(length-1); // 0 to 1
-        for (int _x = 0; _x < iter_width; _x++) { // x coordinate loop | [0,1,2,...,width-1]
-            uv_x = (float)_x / (float)(width-1); // 0 to 1
+            index_.assign((size_t)length_ * width_, -1);
+            face_ = &face;
+            vertex_sample_ = &vertex_sample;
+            int last = size_ - 1;
+            Split(0, 0, last, last, last, 0);
+            Split(last, last, 0, 0, 0, last);
+        }
 
-            vertex_position = glm::vec3(_x, height_map[_x + width*_z], _z);
-            vertex_coord = glm::vec2(uv_x, uv_z); // uv coordinates
-            adjacent_vertices.clear();
-            
-            //                right                 bottom right
-            int order_x[8] = { 1,  1,  0, -1, -1, -1, 0, 1 };
-            int order_z[8] = { 0, -1, -1, -1,  0,  1, 1, 1 };
-            
+    private:
+        const float* height_;
+        int length_;
+        int width_;
+        float max_error_;
+        int size_;
+        std::vector<float> error_; // Per split point, size_ x size_
+        std::vector<int> covered_; // Summed table of hidden samples, (width_ + 1) x (length_ + 1)
+        std::vector<int> index_; // Vertex of each map sample, or -1
+        std::vector<GLuint>* face_;
+        std::vector<int>* vertex_sample_;
+
+        float Height(int x, int z) const {
+
+            return height_[std::min(x, width_ - 1) + width_ * std::min(z, length_ - 1)];
+        }
 
-            // Iterate over neighbours counter clockwise
-            // Iteration has a different start depending on the case
-            dx = 0;
-            dz = 0;
-
-            // TOP LEFT n = 3
-            if (_x == 0 && _z == 0) {
-                for (int i = 0; i < 3; i++) {
-                    dx = order_x[(i+6)%8];
-                    dz = order_z[(i+6)%8];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
+        void ComputeErrors(void) {
+
+            // Every triangle has an id (1 and 0 below the two halves of the square, children
+            // 2 * id and 2 * id + 1); going through them from the smallest up makes sure the
+            // errors of both triangles sharing a split point are in before their parents use them
+            int last = size_ - 1;
+            long long num_triangles = (long long)last * last * 2 - 2;
+            long long num_parents = num_triangles - (long long)last * last;
+            error_.assign((size_t)size_ * size_, 0.0f);
+            for (long long i = num_triangles - 1; i >= 0; i--) {
+                long long id = i + 2;
+                int ax = 0, az = 0, bx = 0, bz = 0, cx = 0, cz = 0;
+                if (id & 1) {
+                    bx = bz = cx = last;
                 }
-            }
-            // TOP n = 5
-            else if (_x > 0 && _x < width - 1 && _z == 0) {
-                for (int i = 0; i < 5; i++) {
-                    dx = order_x[(i + 4) % 8];
-                    dz = order_z[(i + 4) % 8];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
+                else {
+                    ax = az = cz = last;
                 }
-            }
-            // TOP RIGHT n = 3
-            else if (_x == width - 1 && _z == length - 1) {
-                for (int i = 0; i < 3; i++) {
-                    dx = order_x[(i + 4) % 8];
-                    dz = order_z[(i + 4) % 8];
-                    if (_x + dx + width * (_z + dz) < height_map.capacity() && _x + dx + width * (_z + dz) >= 0) {
-                        adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
+                while ((id >>= 1) > 1) {
+                    int mx = (ax + bx) >> 1;
+                    int mz = (az + bz) >> 1;
+                    if (id & 1) {
+                        bx = ax; bz = az;
+                        ax = cx; az = cz;
                     }
+                    else {
+                        ax = bx; az = bz;
+                        bx = cx; bz = cz;
+                    }
+                    cx = mx;
+                    cz = mz;
                 }
-            }
-            // LEFT n = 5
-            else if (_x == 0 && _z > 0 && _z < length - 1) {
-                for (int i = 0; i < 5; i++) {
-                    dx = order_x[(i + 6) % 8];
-                    dz = order_z[(i + 6) % 8];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
-                }
-            }
-            // MIDDLE n = 8
-            else if (_x > 0 && _x < width - 1 && _z > 0 && _z < length - 1) {
-                for (int i = 0; i < 8; i++) {
-                    dx = order_x[i];
-                    dz = order_z[i];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
+
+                int mx = (ax + bx) >> 1;
+                int mz = (az + bz) >> 1;
+                float& error = error_[mx + size_ * mz];
+                if (std::min(std::min(ax, bx), cx) < width_ - 1 && std::max(std::max(ax, bx), cx) > width_ - 1) {
+                    error = INFINITY;
                 }
-            }
-            // RIGHT n = 5
-            else if (_x == width - 1 && _z > 0 && _z < length - 1) {
-                for (int i = 0; i < 5; i++) {
-                    dx = order_x[(i + 2) % 8];
-                    dz = order_z[(i + 2) % 8];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
+                if (std::min(std::min(az, bz), cz) < length_ - 1 && std::max(std::max(az, bz), cz) > length_ - 1) {
+                    error = INFINITY;
                 }
-            }
-            // BOTTOM LEFT n = 3
-            else if (_x == 0 && _z == length - 1) {
-                for (int i = 0; i < 3; i++) {
-                    dx = order_x[i];
-                    dz = order_z[i];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
+                error = std::max(error, std::abs((Height(ax, az) + Height(bx, bz)) * 0.5f - Height(mx, mz)));
+                if (i < num_parents) {
+                    error = std::max(error, error_[((ax + cx) >> 1) + size_ * ((az + cz) >> 1)]);
+                    error = std::max(error, error_[((bx + cx) >> 1) + size_ * ((bz + cz) >> 1)]);
                 }
             }
-            // BOTTOM n = 5
-            else if (_x > 0 && _x < width - 1 && _z == length - 1) {
-                for (int i = 0; i < 5; i++) {
-                    dx = order_x[i];
-                    dz = order_z[i];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
-                }
+        }
+
+        // True if every map sample in the box around the triangle is under the other surface
+        // (the part of the box on the map, that is)
+        bool IsHidden(int ax, int az, int bx, int bz, int cx, int cz) const {
+
+            if (covered_.empty()) {
+                return false;
             }
-            // BOTTOM RIGHT n = 3
-            else if (_x == width - 1 && _z == length - 1) {
-                for (int i = 0; i < 3; i++) {
-                    dx = order_x[(i+2)%8];
-                    dz = order_z[(i+2)%8];
-                    adjacent_vertices.push_back(glm::vec3(_x + dx, height_map[_x + dx + width * (_z + dz)], _z + dz));
-                }
+            int x0 = std::min(std::min(ax, bx), cx), x1 = std::min(std::max(std::max(ax, bx), cx), width_ - 1);
+            int z0 = std::min(std::min(az, bz), cz), z1 = std::min(std::max(std::max(az, bz), cz), length_ - 1);
+            int w = width_ + 1;
+            int hidden = covered_[(x1 + 1) + w * (z1 + 1)] - covered_[x0 + w * (z1 + 1)] - covered_[(x1 + 1) + w * z0] + covered_[x0 + w * z0];
+            return hidden == (x1 - x0 + 1) * (z1 - z0 + 1);
+        }
+
+        int GetVertex(int x, int z) {
+
+            int& index = index_[x + width_ * z];
+            if (index < 0) {
+                index = (int)vertex_sample_->size();
+                vertex_sample_->push_back(x + width_ * z);
             }
-            
-            edges.clear();
+            return index;
+        }
 
+        // Triangle with hypotenuse a-b and right angle at c
+        void Split(int ax, int az, int bx, int bz, int cx, int cz) {
 
-            if (adjacent_vertices.size() >= 2) {
-                for (size_t n = 0; n < adjacent_vertices.size() - 1; n++) {
-                    
-                    edge_U = adjacent_vertices[n] - vertex_position; //edge 1
-                    edge_V = adjacent_vertices[n + 1] - vertex_position; // edge 2
-                    edges.insert(edges.end(), {edge_U, edge_V});
+            // Past the edge of the map
+            if (std::min(std::min(ax, bx), cx) >= width_ - 1 || std::min(std::min(az, bz), cz) >= length_ - 1) {
+                return;
+            }
+            if (IsHidden(ax, az, bx, bz, cx, cz)) {
+                return;
+            }
+            int mx = (ax + bx) >> 1;
+            int mz = (az + bz) >> 1;
+            if (std::abs(ax - cx) + std::abs(az - cz) > 1 && error_[mx + size_ * mz] > max_error_) {
+                Split(cx, cz, ax, az, mx, mz);
+                Split(bx, bz, cx, cz, mx, mz);
+                return;
+            }
 
-                    vertex_normal += glm::normalize(glm::cross(edge_U, edge_V));
-                    
-                }
+            // Same facing as the terrain grid
+            int ia = GetVertex(ax, az), ib = GetVertex(bx, bz), ic = GetVertex(cx, cz);
+            if ((bx - ax) * (cz - az) - (bz - az) * (cx - ax) > 0) {
+                std::swap(ib, ic);
             }
-            vertex_normal = glm::normalize(vertex_normal);
+            face_->insert(face_->end(), { (GLuint)ia, (GLuint)ib, (GLuint)ic });
+        }
 
-            // Calculate tangent
-            if (adjacent_vertices.size() >= 2) {
+}; // class PlaneSimplifier
 
-                // No idea why this one needs to be told what to do
-                if (_x == 1 && _z == 0) {
-                    vertex_color = glm::cross(vertex_normal, adjacent_vertices[1]);
-                    vertex_color = glm::normalize(vertex_color);
-                    //continue;
-                }
-                
-                else {
-                    vertex_color = glm::cross(vertex_normal, adjacent_vertices[0]);
-                    vertex_color = glm::normalize(vertex_color);
-                }
-            }
-            vertex_color = (vertex_color * 0.5f) + 0.5f;
 
-            // move to offset position (centered at 0,0)
-            vertex_position.x -= offsetX;
-            vertex_position.z -= offsetZ;
+void ResourceManager::CreateSimplifiedPlane(std::string object_name, const std::vector<float>& height_map, int length, int width, int offsetX, int offsetZ, float max_error, const std::vector<float>* cover) {
 
-            // Add vectors to the data buffer
-            for (int k = 0; k < 3; k++) {
-                vertex[(_z * width + _x) * vertex_att + k] = vertex_position[k];
-                vertex[(_z * width + _x) * vertex_att + k + 3] = vertex_normal[k];
-                vertex[(_z * width + _x) * vertex_att + k + 6] = vertex_color[k];
-            }
-            vertex[(_z * width + _x) * vertex_att + 9] = vertex_coord[0];
-            vertex[(_z * width + _x) * vertex_att + 10] = vertex_coord[1];
+    if (length < 2 || width < 2 || height_map.size() < (size_t)length * width) {
+        throw(std::invalid_argument(std::string("Height map too small for plane ") + object_name));
+    }
+    if (cover && cover->size() < (size_t)length * width) {
+        throw(std::invalid_argument(std::string("Covering height map too small for plane ") + object_name));
+    }
+
+    std::vector<GLuint> face;
+    std::vector<int> vertex_sample;
+    PlaneSimplifier(height_map, length, width, max_error, cover).Extract(face, vertex_sample);
+
+    // Number the vertices in map order, so the vertices of a row of the map are consecutive
+    std::vector<int> order(vertex_sample.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (int)i;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return vertex_sample[a] < vertex_sample[b]; });
+    std::vector<GLuint> renumber(order.size());
+    std::vector<int> sample(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        renumber[order[i]] = (GLuint)i;
+        sample[i] = vertex_sample[order[i]];
+    }
+    for (size_t i = 0; i < face.size(); i++) {
+        face[i] = renumber[face[i]];
+    }
+
+    // Vertex layout of the other meshes (tangent in place of the color), with normals and
+    // tangents from central differences of the heights, at the samples that are left
+    const int vertex_att = 11;
+    std::vector<GLfloat> vertex(sample.size() * vertex_att);
+    const float* height = height_map.data();
+    GLfloat* vertex_data = vertex.data();
+    const int* sample_data = sample.data();
+    const int num_samples = sample.size();
+
+    // Every row only reads its own and the two neighbouring rows of the height map and writes
+    // its own vertices, so rows can be built in any order
+    auto build_row = [=](int z) {
+
+        const int* first = std::lower_bound(sample_data, sample_data + num_samples, z * width);
+        const int* last = std::lower_bound(first, sample_data + num_samples, (z + 1) * width);
+        if (first == last) {
+            return;
+        }
+
+        // Central differences; one-sided on the border of the map
+        const float* row = height + (size_t)z * width;
+        const float* above = height + (size_t)std::max(z - 1, 0) * width;
+        const float* below = height + (size_t)std::min(z + 1, length - 1) * width;
+        const float scale_z = 1.0f / (float)(std::min(z + 1, length - 1) - std::max(z - 1, 0));
+
+        // Work on the whole row as separate arrays first so the loops below vectorize
+        std::vector<float> scratch(width * 4);
+        float* dx = &scratch[0];
+        float* dz = &scratch[width];
+        float* inv_normal = &scratch[width * 2];
+        float* inv_tangent = &scratch[width * 3];
+
+        dx[0] = row[1] - row[0];
+        for (int x = 1; x < width - 1; x++) {
+            dx[x] = (row[x + 1] - row[x - 1]) * 0.5f;
+        }
+        dx[width - 1] = row[width - 1] - row[width - 2];
+
+        for (int x = 0; x < width; x++) {
+            dz[x] = (below[x] - above[x]) * scale_z;
+            // The normal is (-dx, 1, -dz) and the tangent along u is (1, dx, 0)
+            inv_normal[x] = 1.0f / std::sqrt(dx[x] * dx[x] + dz[x] * dz[x] + 1.0f);
+            inv_tangent[x] = 1.0f / std::sqrt(dx[x] * dx[x] + 1.0f);
+        }
+
+        // Interleave the samples that are left into the vertex layout, moved to the offset
+        // position (centered at 0,0)
+        const float pos_z = (float)(z - offsetZ);
+        const float v = (float)z / (float)(length - 1);
+        for (const int* it = first; it != last; it++) {
+            int x = *it - z * width;
+            GLfloat* out = vertex_data + (size_t)(it - sample_data) * vertex_att;
+            out[0] = (float)(x - offsetX);
+            out[1] = row[x];
+            out[2] = pos_z;
+            out[3] = -dx[x] * inv_normal[x];
+            out[4] = inv_normal[x];
+            out[5] = -dz[x] * inv_normal[x];
+            out[6] = inv_tangent[x] * 0.5f + 0.5f;
+            out[7] = dx[x] * inv_tangent[x] * 0.5f + 0.5f;
+            out[8] = 0.5f;
+            out[9] = (float)x / (float)(width - 1);
+            out[10] = v;
+        }
+    };
+
+    if (pool_) {
+        pool_->ParallelFor(length, build_row);
+    } else {
+        for (int z = 0; z < length; z++) {
+            build_row(z);
         }
     }
 
-    // Create triangles
-    for (int i = 0; i < length - 1; i++) {
-        for (int j = 0; j < width - 1; j++) {
-            // Two triangles per quad
-            glm::vec3 t1(((i + 1) % length) * width + j,
-                i * width + ((j + 1) % width),
-                i * width + j);
-            glm::vec3 t2(((i + 1) % length) * width + j,
-                ((i + 1) % length) * width + ((j + 1) % width),
-                i * width + ((j + 1) % width));
-            // Add two triangles to the data buffer
-            for (int k = 0; k < 3; k++) {
-                face[(i * width + j) * face_att * 2 + k] = (GLuint)t1[k];
-                face[(i * width + j) * face_att * 2 + k + face_att] = (GLuint)t2[k];
+    GLuint vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertex.size() * sizeof(GLfloat), vertex.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face.size() * sizeof(GLuint), face.data(), GL_STATIC_DRAW);
+
+    // Create resource
+    AddResource(Mesh, object_name, vbo, ebo, (GLsizei)face.size());
+}
+
+
+void ResourceManager::CreateTerrainGrid(std::string object_name, int cells) {
+
+    if (cells < 2 || cells % 2 != 0) {
+        throw(std::invalid_argument(std::string("Terrain grid needs an even number of cells: ") + object_name));
+    }
+
+    const int side = cells + 1;
+    const int half = cells / 2;
+
+    std::vector<GLfloat> vertex(side * side * 2);
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            vertex[(z * side + x) * 2] = (float)x / (float)cells;
+            vertex[(z * side + x) * 2 + 1] = (float)z / (float)cells;
+        }
+    }
+
+    // Cells split like the cells of Terrain, one quarter after the other
+    std::vector<GLuint> face;
+    face.reserve(cells * cells * 6);
+    for (int quarter = 0; quarter < 4; quarter++) {
+        int start_x = (quarter & 1) * half;
+        int start_z = (quarter >> 1) * half;
+        for (int z = start_z; z < start_z + half; z++) {
+            for (int x = start_x; x < start_x + half; x++) {
+                GLuint top = z * side + x;
+                GLuint bottom = top + side;
+                face.insert(face.end(), { bottom, top + 1, top, bottom, bottom + 1, top + 1 });
             }
         }
     }
@@ -827,18 +1079,74 @@ void ResourceManager::CreatePlane(std::string object_name, std::vector<float> he
     GLuint vbo, ebo;
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertex_num * vertex_att * sizeof(GLfloat), vertex, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertex.size() * sizeof(GLfloat), vertex.data(), GL_STATIC_DRAW);
 
     glGenBuffers(1, &ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face_num * face_att * sizeof(GLuint), face, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face.size() * sizeof(GLuint), face.data(), GL_STATIC_DRAW);
 
-    // Free data buffers
-    delete[] vertex;
-    delete[] face;
+    AddResource(Mesh, object_name, vbo, ebo, (GLsizei)face.size());
+}
 
-    // Create resource
-    AddResource(Mesh, object_name, vbo, ebo, face_num * face_att);
+
+void ResourceManager::CreatePatchGrid(std::string object_name, int cells) {
+
+    if (cells < 1) {
+        throw(std::invalid_argument(std::string("Patch grid needs at least one cell: ") + object_name));
+    }
+
+    const int side = cells + 1;
+
+    std::vector<GLfloat> vertex(side * side * 2);
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            vertex[(z * side + x) * 2] = (float)x / (float)cells;
+            vertex[(z * side + x) * 2 + 1] = (float)z / (float)cells;
+        }
+    }
+
+    // Corners (x, z), (x + 1, z), (x + 1, z + 1), (x, z + 1) of every cell
+    std::vector<GLuint> face;
+    face.reserve(cells * cells * 4);
+    for (int z = 0; z < cells; z++) {
+        for (int x = 0; x < cells; x++) {
+            GLuint top = z * side + x;
+            GLuint bottom = top + side;
+            face.insert(face.end(), { top, top + 1, bottom + 1, bottom });
+        }
+    }
+
+    GLuint vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertex.size() * sizeof(GLfloat), vertex.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, face.size() * sizeof(GLuint), face.data(), GL_STATIC_DRAW);
+
+    AddResource(Mesh, object_name, vbo, ebo, (GLsizei)face.size());
+}
+
+
+void ResourceManager::CreateHeightTexture(std::string object_name, const std::vector<float>& height_map, int width, int depth) {
+
+    if (width < 1 || depth < 1 || height_map.size() < (size_t)width * depth) {
+        throw(std::invalid_argument(std::string("Height map too small for texture ") + object_name));
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, depth, 0, GL_RED, GL_FLOAT, height_map.data());
+    // Heights between samples are interpolated like on the plane mesh
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    AddResource(Texture, object_name, texture, 0);
 }
 
 void ResourceManager::CreateSphere(std::string object_name, float radius, int num_samples_theta, int num_samples_phi){
@@ -1124,16 +1432,277 @@ void ResourceManager::CreateSphereParticles(std::string object_name, int num_par
     AddResource(PointSet, object_name, vbo, 0, num_particles);
 }
 
+// Bytes uploaded a frame at most (one texture always goes)
+static const size_t texture_upload_budget_g = 16 * 1024 * 1024;
+
+
+// Sampling of every loaded texture
+static void SetTextureSampling(void) {
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+}
+
+
 void ResourceManager::LoadTexture(const std::string name, const char* filename) {
 
-    // Load texture from file
-    GLuint texture = SOIL_load_OGL_texture(filename, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, 0);
-    if (!texture) {
-        throw(std::ios_base::failure(std::string("Error loading texture ") + std::string(filename) + std::string(": ") + std::string(SOIL_last_result())));
+    // A missing file fails here, a file that does not decode in UpdateTextures
+    std::ifstream f;
+    f.open(filename, std::ios::binary);
+    if (f.fail()) {
+        throw(std::ios_base::failure(std::string("Error loading texture ") + std::string(filename) + std::string(": cannot open file")));
     }
+    f.close();
 
-    // Create resource
-    AddResource(Texture, name, texture, 0);
+    // Until the image is on the GPU the resource is a single texel, a flat normal for the
+    // normal maps, so handles can be taken and nodes drawn right away
+    const GLubyte placeholder[4] = { 128, 128, 255, 255 };
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    SetTextureSampling();
+
+    Resource *res = new Resource(Texture, name, texture, 0);
+    AddResource(res);
+
+    TextureLoad *load = new TextureLoad();
+    load->filename = filename;
+    load->handle = res->GetTextureHandle();
+    load->s3tc = GLEW_EXT_texture_compression_s3tc;
+    load->rgtc = GLEW_ARB_texture_compression_rgtc;
+    texture_load_.push_back(std::unique_ptr<TextureLoad>(load));
+    // Decoding takes milliseconds, so it stays out of the way of the frame's jobs
+    if (pool_) {
+        pool_->SubmitBackground([load]() { DecodeTexture(load); }, &texture_jobs_);
+    } else {
+        DecodeTexture(load);
+    }
+}
+
+
+void ResourceManager::DecodeTexture(TextureLoad* load) {
+
+    if (ReadCompressedTexture(load)) {
+        load->decoded.store(true, std::memory_order_release);
+        return;
+    }
+
+    // The file is read in parallel; decoding is not, since SOIL reports errors through one
+    // global message that another worker's load would overwrite
+    std::ifstream f(load->filename, std::ios::binary);
+    if (f.fail()) {
+        load->error = "cannot open file"; // Removed after LoadTexture checked it
+        load->decoded.store(true, std::memory_order_release);
+        return;
+    }
+    std::vector<unsigned char> file((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    static std::mutex soil_mutex;
+    std::lock_guard<std::mutex> lock(soil_mutex);
+    int channels = 0;
+    unsigned char *pixels = SOIL_load_image_from_memory(file.data(), (int)file.size(), &load->width, &load->height, &channels, SOIL_LOAD_AUTO);
+    if (pixels && channels < 3) {
+        // Grey images are spread over the colour channels, as SOIL_load_OGL_texture does
+        SOIL_free_image_data(pixels);
+        pixels = SOIL_load_image_from_memory(file.data(), (int)file.size(), &load->width, &load->height, &channels, SOIL_LOAD_RGBA);
+        channels = 4;
+    }
+    if (pixels) {
+        load->data.assign(pixels, pixels + (size_t)load->width * load->height * channels);
+        load->format = (channels == 3) ? GL_RGB : GL_RGBA;
+        SOIL_free_image_data(pixels);
+    } else {
+        load->error = SOIL_last_result();
+    }
+    load->decoded.store(true, std::memory_order_release);
+}
+
+
+bool ResourceManager::ReadCompressedTexture(TextureLoad* load) {
+
+    // Not used when the image was changed after it was converted
+    std::string filename = DdsFilename(load->filename);
+    std::error_code error;
+    std::filesystem::file_time_type converted = std::filesystem::last_write_time(filename, error);
+    if (error) {
+        return false;
+    }
+    std::filesystem::file_time_type image = std::filesystem::last_write_time(load->filename, error);
+    if (!error && image > converted) {
+        return false;
+    }
+
+    std::ifstream f;
+    f.open(filename, std::ios::binary);
+    uint32_t magic = 0;
+    DdsHeader header;
+    f.read((char*)&magic, sizeof(magic));
+    f.read((char*)&header, sizeof(header));
+    if (f.fail() || magic != dds_magic_g || header.size != sizeof(DdsHeader) || !(header.pixel_format.flags & DdsFourCC) || header.width == 0 || header.height == 0) {
+        return false;
+    }
+
+    // Formats the GPU cannot read fall back to the image
+    uint32_t four_cc = header.pixel_format.four_cc;
+    if (four_cc == dds_dxt1_g && load->s3tc) {
+        load->format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    } else if (four_cc == dds_dxt5_g && load->s3tc) {
+        load->format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    } else if (four_cc == dds_ati2_g && load->rgtc) {
+        load->format = GL_COMPRESSED_RG_RGTC2;
+    } else {
+        return false;
+    }
+
+    // No more levels than down to 1x1
+    int levels = (header.flags & DdsMipMapCount) ? std::max(header.mip_map_count, 1u) : 1;
+    int max_levels = 1;
+    while ((std::max(header.width, header.height) >> max_levels) > 0) {
+        max_levels++;
+    }
+    levels = std::min(levels, max_levels);
+    size_t size = 0;
+    for (int level = 0; level < levels; level++) {
+        size += DdsLevelBytes(std::max(header.width >> level, 1u), std::max(header.height >> level, 1u), DdsBlockBytes(four_cc));
+    }
+    load->data.resize(size);
+    f.read((char*)load->data.data(), size);
+    if (f.fail()) {
+        load->data.clear();
+        return false;
+    }
+    load->width = header.width;
+    load->height = header.height;
+    load->levels = levels;
+    return true;
+}
+
+
+void ResourceManager::UploadTexture(TextureLoad* load) {
+
+    // Copy the data into a pixel buffer; the texture is filled from it without the driver
+    // holding on to our memory
+    GLsizeiptr size = load->data.size();
+    glGenBuffers(1, &load->buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, load->buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void *destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (destination) {
+        memcpy(destination, load->data.data(), size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    } else {
+        glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, size, load->data.data());
+    }
+    std::vector<unsigned char>().swap(load->data);
+
+    glGenTextures(1, &load->texture);
+    glBindTexture(GL_TEXTURE_2D, load->texture);
+    if (load->format == GL_RGB || load->format == GL_RGBA) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Rows of RGB images are not padded
+        glTexImage2D(GL_TEXTURE_2D, 0, (load->format == GL_RGB) ? GL_RGB8 : GL_RGBA8, load->width, load->height, 0, load->format, GL_UNSIGNED_BYTE, (void*)0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        // Mipmaps are made once here rather than every time the texture is bound
+        glGenerateMipmap(GL_TEXTURE_2D);
+    } else {
+        // Compressed levels come with the file
+        GLuint block_bytes = (load->format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
+        size_t offset = 0;
+        for (int level = 0; level < load->levels; level++) {
+            GLsizei width = std::max(load->width >> level, 1);
+            GLsizei height = std::max(load->height >> level, 1);
+            GLsizei level_size = DdsLevelBytes(width, height, block_bytes);
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, load->format, width, height, 0, level_size, (void*)offset);
+            offset += level_size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, load->levels - 1);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    SetTextureSampling();
+
+    // Without fences the driver orders the upload before any draw that uses the texture
+    if (GLEW_ARB_sync) {
+        load->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+
+bool ResourceManager::ProcessTextureLoads(bool wait) {
+
+    size_t uploaded = 0;
+    int i = 0;
+    while (i < texture_load_.size()) {
+        TextureLoad *load = texture_load_[i].get();
+
+        if (!load->texture) {
+            if (!load->decoded.load(std::memory_order_acquire) || (!wait && uploaded >= texture_upload_budget_g)) {
+                i++;
+                continue;
+            }
+            if (load->data.empty()) {
+                // Mid-game the texture keeps its placeholder instead of ending the game
+                std::string message = std::string("Error loading texture ") + load->filename + std::string(": ") + load->error;
+                texture_load_.erase(texture_load_.begin() + i);
+                if (wait) {
+                    throw(std::ios_base::failure(message));
+                }
+                std::cout << message << std::endl;
+                continue;
+            }
+            uploaded += load->data.size();
+            UploadTexture(load);
+        }
+
+        if (load->fence) {
+            GLenum status = glClientWaitSync(load->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+            // A failed wait only loses the early release of the pixel buffer; the driver still
+            // orders the upload before any draw that uses the texture
+            if (status == GL_WAIT_FAILED && wait) {
+                throw(std::runtime_error(std::string("Error waiting for texture ") + load->filename));
+            }
+            if (status == GL_TIMEOUT_EXPIRED) {
+                if (!wait) {
+                    i++;
+                }
+                continue;
+            }
+            glDeleteSync(load->fence);
+            load->fence = 0;
+        }
+
+        // The upload is done: the resource takes over the texture, unless it was removed
+        glDeleteBuffers(1, &load->buffer);
+        const TextureHandle& handle = load->handle;
+        Resource *res = (handle.index < slot_.size() && slot_[handle.index].generation == handle.generation) ? slot_[handle.index].resource : NULL;
+        if (res) {
+            glDeleteTextures(1, &res->resource_);
+            res->resource_ = load->texture;
+        } else {
+            glDeleteTextures(1, &load->texture);
+        }
+        texture_load_.erase(texture_load_.begin() + i);
+    }
+
+    return !texture_load_.empty();
+}
+
+
+bool ResourceManager::UpdateTextures(void) {
+
+    return ProcessTextureLoads(false);
+}
+
+
+void ResourceManager::FinishTextures(void) {
+
+    if (pool_) {
+        pool_->Wait(texture_jobs_);
+    }
+    ProcessTextureLoads(true);
 }
 
 void ResourceManager::LoadMesh(const std::string name, const char* filename) {
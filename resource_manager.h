@@ -1,6 +1,8 @@
 #ifndef RESOURCE_MANAGER_H_
 #define RESOURCE_MANAGER_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 #define GLEW_STATIC
@@ -8,11 +10,15 @@
 #include <GLFW/glfw3.h>
 
 #include "resource.h"
+#include "name_index.h"
+#include "thread_pool.h"
 
 // Default extensions for different shader source files
 #define VERTEX_PROGRAM_EXTENSION "_vp.glsl"
 #define FRAGMENT_PROGRAM_EXTENSION "_fp.glsl"
 #define GEOMETRY_PROGRAM_EXTENSION "_gp.glsl"
+#define TESS_CONTROL_PROGRAM_EXTENSION "_tc.glsl"
+#define TESS_EVALUATION_PROGRAM_EXTENSION "_te.glsl"
 
 namespace game {
 
@@ -26,10 +32,38 @@ namespace game {
             // Add a resource that was already loaded and allocated to memory
             void AddResource(ResourceType type, const std::string name, GLuint resource, GLsizei size);
             void AddResource(ResourceType type, const std::string name, GLuint array_buffer, GLuint element_array_buffer, GLsizei size);
+            // Free a resource and its OpenGL objects; handles to it stop resolving
+            void RemoveResource(std::string_view name);
             // Load a resource from a file, according to the specified type
             void LoadResource(ResourceType type, const std::string name, const char *filename);
+            // Load a resource again (or for the first time); handles to it stay valid and resolve
+            // to the new OpenGL objects. On failure the old resource is left as it was
+            void ReloadResource(ResourceType type, const std::string name, const char *filename);
+            // Load a shader program; the fragment stage comes from <fragment_prefix>_fp.glsl when
+            // given, so programs with their own vertex stages can share the shading of another
+            void LoadMaterial(const std::string name, const char *prefix, const char *fragment_prefix = NULL);
+            // Pool used to decode textures and build plane rows in parallel (optional)
+            void SetThreadPool(ThreadPool* pool) { pool_ = pool; }
+            // Textures are decoded on the idle workers of the pool and show a placeholder until
+            // they are on the GPU. Upload the textures decoded since the last call and put in
+            // those whose upload has finished; call once a frame. A texture that fails to decode
+            // is reported and keeps its placeholder. Returns true while textures are loading
+            bool UpdateTextures(void);
+            // Wait until every texture is loaded; throws if one fails to decode
+            void FinishTextures(void);
             // Get the resource with the specified name
-            Resource *GetResource(const std::string name) const;
+            Resource *GetResource(std::string_view name) const;
+            Resource *GetResource(const NameKey& key) const;
+
+            // Handles to the resource with the specified name; null if there is none of that type
+            MeshHandle GetMeshHandle(std::string_view name) const;
+            MaterialHandle GetMaterialHandle(std::string_view name) const;
+            TextureHandle GetTextureHandle(std::string_view name) const;
+            // The resource of a handle, or NULL once it was removed
+            template <typename Tag>
+            const Resource *Resolve(ResourceHandle<Tag> handle) const {
+                return (handle.index < slot_.size() && slot_[handle.index].generation == handle.generation) ? slot_[handle.index].resource : NULL;
+            }
 
             // Methods to create specific resources
             // Create the geometry for a torus and add it to the list of resources
@@ -43,9 +77,23 @@ namespace game {
             // Create the geometry for a cone
             void CreateCone(std::string object_name, float height = 1.0, float radius = 0.6, int num_samples_theta = 90, int num_samples_phi = 45);
 
-            // Create the geometry for a plane
-            // Used to make the floor and the boundaries of the game
-            void CreatePlane(std::string object_name, std::vector<float>, int length = 100, int width = 100, int offsetX = 50, int offsetZ = 50);
+            // Create the geometry for a plane from a height map of length rows by width columns,
+            // used for the boundaries of the game and the streamed height tiles. Triangles are
+            // split only where the surface would be more than max_error off the height map
+            // (measured at the split points). Where cover is given (a height map of the same
+            // size), cells whose samples are all under it are left out. The vertices are built
+            // row by row on the thread pool, if there is one
+            void CreateSimplifiedPlane(std::string object_name, const std::vector<float>& height_map, int length, int width, int offsetX, int offsetZ, float max_error, const std::vector<float>* cover = NULL);
+
+            // Create a square grid of cells x cells quads over [0, 1] (2 floats per vertex) for
+            // TerrainNode; the triangles of each quarter of the grid are stored one after the
+            // other (-x-z, +x-z, -x+z, +x+z) so quarters can be drawn on their own
+            void CreateTerrainGrid(std::string object_name, int cells = 32);
+            // Create a grid of cells x cells quad patches over [0, 1] (2 floats per vertex, 4
+            // indices per patch) for tessellation
+            void CreatePatchGrid(std::string object_name, int cells);
+            // Upload a height map of width x depth samples as a one-channel float texture
+            void CreateHeightTexture(std::string object_name, const std::vector<float>& height_map, int width, int depth);
 
             // Create particles distributed over a sphere
             void CreateSphereParticles(std::string object_name, int num_particles = 500);
@@ -54,13 +102,55 @@ namespace game {
            
             // List storing all resources
             std::vector<Resource*> resource_; 
+            // Name lookup for resource_
+            NameIndex<Resource> index_;
+            // Slots that handles refer to; a slot's generation changes whenever its resource is removed
+            struct Slot {
+                Resource* resource = NULL;
+                uint32_t generation = 0;
+            };
+            std::vector<Slot> slot_;
+            std::vector<uint32_t> free_slot_;
+            // Not owned, may be NULL
+            ThreadPool* pool_;
+
+            // A texture decoded on a worker and uploaded through a pixel buffer
+            struct TextureLoad {
+                std::string filename;
+                TextureHandle handle; // Resource showing the placeholder
+                bool s3tc = false; // Compressed formats the GPU can read
+                bool rgtc = false;
+                std::vector<unsigned char> data; // Pixels, or a compressed mip chain
+                GLenum format = 0; // GL_RGB, GL_RGBA or a compressed format
+                int width = 0;
+                int height = 0;
+                int levels = 1;
+                std::string error;
+                std::atomic<bool> decoded{false};
+                GLuint buffer = 0;
+                GLuint texture = 0; // Replaces the placeholder once the fence signals
+                GLsync fence = 0;
+            };
+            std::vector<std::unique_ptr<TextureLoad>> texture_load_;
+            JobCounter texture_jobs_;
  
+            // Give a new resource a slot and a name
+            void AddResource(Resource* res);
+            // Free the OpenGL objects of a resource
+            void DeleteObjects(const Resource* res);
+
             // Methods to load specific types of resources
             // Load shaders programs
-            void LoadMaterial(const std::string name, const char *prefix);
 
             // Load a texture from an image file: png, jpg, etc.
             void LoadTexture(const std::string name, const char* filename);
+            // Runs on a worker
+            static void DecodeTexture(TextureLoad* load);
+            // Read the converted file of the image if there is a usable one (texture_file.h)
+            static bool ReadCompressedTexture(TextureLoad* load);
+            void UploadTexture(TextureLoad* load);
+            // Advance the texture loads; with wait, finish them all now
+            bool ProcessTextureLoads(bool wait);
 
             // Load a mesh from an obj file
             void LoadMesh(const std::string name, const char* filename);
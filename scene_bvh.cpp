@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cmath>
+
+#include "scene_bvh.h"
+
+namespace game {
+
+    // Floats per vertex in the buffers created by the resource manager (position, normal, color, uv)
+    static const int vertex_stride_g = 11;
+
+
+    SceneBvh::SceneBvh(void) : registry_(NULL) {
+    }
+
+
+    void SceneBvh::Clear(void) {
+
+        bvh_ = Bvh();
+        item_.clear();
+        bounds_.clear();
+        mesh_.clear();
+        mesh_cache_.clear();
+        registry_ = NULL;
+    }
+
+
+    void SceneBvh::GetGeometryNodes(CompositeNode* node, std::vector<SceneNode*>& result) {
+
+        result.clear();
+        if (node->GetRoot()) {
+            result.push_back(node->GetRoot());
+        }
+        for (SceneNode* n : node->GetAllNodes()) {
+            // Hitboxes are invisible collision helpers, not geometry
+            if (std::find(node->hitboxes_.begin(), node->hitboxes_.end(), n) != node->hitboxes_.end()) {
+                continue;
+            }
+            result.push_back(n);
+        }
+
+        // Only triangle meshes take part (no particle systems)
+        result.erase(std::remove_if(result.begin(), result.end(), [](SceneNode* n) {
+            return n->GetMode() != GL_TRIANGLES || n->GetSize() == 0;
+        }), result.end());
+    }
+
+
+    const SceneBvh::MeshData& SceneBvh::GetMeshData(const SceneNode* node) {
+
+        GLuint vbo = node->GetArrayBuffer();
+        auto it = mesh_cache_.find(vbo);
+        if (it != mesh_cache_.end()) {
+            return it->second;
+        }
+
+        // Read the geometry back from the buffers once; meshes are shared between nodes
+        MeshData& mesh = mesh_cache_[vbo];
+
+        GLint vbo_size = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vbo_size);
+        std::vector<GLfloat> vertex(vbo_size / sizeof(GLfloat));
+        if (!vertex.empty()) {
+            glGetBufferSubData(GL_ARRAY_BUFFER, 0, vertex.size() * sizeof(GLfloat), vertex.data());
+        }
+
+        mesh.position.resize(vertex.size() / vertex_stride_g);
+        for (int i = 0; i < mesh.position.size(); i++) {
+            mesh.position[i] = glm::vec3(vertex[i * vertex_stride_g], vertex[i * vertex_stride_g + 1], vertex[i * vertex_stride_g + 2]);
+            mesh.bounds.Grow(mesh.position[i]);
+        }
+
+        mesh.index.resize(node->GetSize());
+        if (!mesh.index.empty()) {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, node->GetElementArrayBuffer());
+            glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, mesh.index.size() * sizeof(GLuint), mesh.index.data());
+        }
+
+        // Drop triangles referencing vertices outside the buffer
+        std::vector<GLuint> valid;
+        valid.reserve(mesh.index.size());
+        for (int i = 0; i + 2 < mesh.index.size(); i += 3) {
+            if (mesh.index[i] < mesh.position.size() && mesh.index[i + 1] < mesh.position.size() && mesh.index[i + 2] < mesh.position.size()) {
+                valid.insert(valid.end(), mesh.index.begin() + i, mesh.index.begin() + i + 3);
+            }
+        }
+        mesh.index.swap(valid);
+
+        return mesh;
+    }
+
+
+    AABB SceneBvh::GetBounds(CompositeNode* node) {
+
+        AABB bounds;
+        std::vector<SceneNode*> nodes;
+        GetGeometryNodes(node, nodes);
+        for (SceneNode* n : nodes) {
+            bounds.Grow(TransformAABB(GetMeshData(n).bounds, n->GetWorldTransf()));
+        }
+        return bounds;
+    }
+
+
+    void SceneBvh::BuildTriangles(CompositeNode* node, TriangleMesh& mesh) {
+
+        std::vector<SceneNode*> nodes;
+        GetGeometryNodes(node, nodes);
+        for (SceneNode* n : nodes) {
+            const MeshData& data = GetMeshData(n);
+            const glm::mat4& transf = n->GetWorldTransf();
+            for (int i = 0; i < data.index.size(); i++) {
+                mesh.vertex.push_back(glm::vec3(transf * glm::vec4(data.position[data.index[i]], 1.0f)));
+            }
+        }
+
+        std::vector<AABB> bounds(mesh.vertex.size() / 3);
+        for (int i = 0; i < bounds.size(); i++) {
+            bounds[i].Grow(mesh.vertex[i * 3]);
+            bounds[i].Grow(mesh.vertex[i * 3 + 1]);
+            bounds[i].Grow(mesh.vertex[i * 3 + 2]);
+        }
+        mesh.bvh.Build(bounds);
+    }
+
+
+    void SceneBvh::Build(EntityRegistry* registry) {
+
+        // Meshes read back earlier stay cached, so rebuilding after objects were added is cheap
+        bvh_ = Bvh();
+        item_.clear();
+        bounds_.clear();
+        mesh_.clear();
+        registry_ = registry;
+
+        for (int i = 0; i < registry_->solid_.GetSize(); i++) {
+            const Solid& solid = registry_->solid_[i];
+
+            Item item;
+            item.entity = registry_->solid_.GetEntity(i);
+            item.mesh = -1;
+            item.dynamic = solid.dynamic;
+            item.removed = false;
+
+            // Moving objects would need their triangles rebuilt every frame; they keep their box
+            if (solid.triangles && !solid.dynamic) {
+                item.mesh = mesh_.size();
+                mesh_.push_back(TriangleMesh());
+                BuildTriangles(solid.node, mesh_.back());
+            }
+
+            item_.push_back(item);
+            bounds_.push_back(GetBounds(solid.node));
+        }
+        bvh_.Build(bounds_);
+    }
+
+
+    void SceneBvh::Refit(void) {
+
+        if (!registry_) {
+            return;
+        }
+
+        bool changed = false;
+        for (int i = 0; i < item_.size(); i++) {
+            Item& item = item_[i];
+            if (item.removed) {
+                continue;
+            }
+            Solid* solid = registry_->solid_.Get(item.entity);
+            if (!solid) {
+                // Destroyed: an empty box is never hit
+                item.removed = true;
+                bounds_[i] = AABB();
+                bvh_.SetBounds(i, bounds_[i]);
+                changed = true;
+            }
+            else if (item.dynamic) {
+                bounds_[i] = GetBounds(solid->node);
+                bvh_.SetBounds(i, bounds_[i]);
+                changed = true;
+            }
+        }
+        if (changed) {
+            bvh_.Refit();
+        }
+    }
+
+
+    // Möller-Trumbore ray/triangle test, returns the hit distance or INFINITY
+    static float IntersectTriangle(const Ray& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+
+        const float epsilon = 1e-7f;
+        glm::vec3 e1 = v1 - v0;
+        glm::vec3 e2 = v2 - v0;
+        glm::vec3 p = glm::cross(ray.direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < epsilon) {
+            return INFINITY;
+        }
+        float inv_det = 1.0f / det;
+        glm::vec3 s = ray.origin - v0;
+        float u = glm::dot(s, p) * inv_det;
+        if (u < 0.0f || u > 1.0f) {
+            return INFINITY;
+        }
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(ray.direction, q) * inv_det;
+        if (v < 0.0f || u + v > 1.0f) {
+            return INFINITY;
+        }
+        float t = glm::dot(e2, q) * inv_det;
+        return (t >= 0.0f) ? t : INFINITY;
+    }
+
+
+    bool SceneBvh::RayCast(glm::vec3 origin, glm::vec3 direction, float max_distance, RayHit& hit, bool triangles_only) const {
+
+        if (bvh_.IsEmpty() || glm::length(direction) == 0.0f) {
+            return false;
+        }
+
+        Ray ray(origin, glm::normalize(direction));
+        float t_max = max_distance;
+        int item = bvh_.RayCast(ray, t_max, [&](int i, float t_limit) -> float {
+            if (item_[i].removed) {
+                return INFINITY;
+            }
+            if (item_[i].mesh < 0) {
+                if (triangles_only) {
+                    return INFINITY;
+                }
+                const AABB& box = bounds_[i];
+                return Bvh::IntersectBox(ray, &box.min[0], &box.max[0], t_limit);
+            }
+
+            const TriangleMesh& mesh = mesh_[item_[i].mesh];
+            const std::vector<glm::vec3>& v = mesh.vertex;
+            float t = t_limit;
+            int triangle = mesh.bvh.RayCast(ray, t, [&](int tri, float) -> float {
+                return IntersectTriangle(ray, v[tri * 3], v[tri * 3 + 1], v[tri * 3 + 2]);
+            });
+            return (triangle >= 0) ? t : INFINITY;
+        });
+
+        if (item < 0) {
+            return false;
+        }
+
+        hit.entity = item_[item].entity;
+        hit.distance = t_max;
+        hit.point = ray.origin + ray.direction * t_max;
+        return true;
+    }
+
+
+    bool SceneBvh::SegmentCast(glm::vec3 from, glm::vec3 to, RayHit& hit, bool triangles_only) const {
+
+        return RayCast(from, to - from, glm::length(to - from), hit, triangles_only);
+    }
+
+} // namespace game
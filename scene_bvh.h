@@ -0,0 +1,89 @@
+/*
+ *
+ * Ray and segment queries against the solid objects of the scene (entities with a Solid component).
+ * The top level is a BVH over the world-space bounds of each object. Objects marked for triangle
+ * tests get a second BVH over their mesh triangles, read back once from the vertex/index buffers
+ * that the resource manager created.
+ *
+ */
+#ifndef SCENE_BVH_H_
+#define SCENE_BVH_H_
+
+#include <vector>
+#include <unordered_map>
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "bvh.h"
+#include "entity_registry.h"
+#include "composite_node.h"
+
+namespace game {
+
+    struct RayHit {
+        EntityHandle entity;
+        float distance; // Along the (normalized) ray direction
+        glm::vec3 point;
+    };
+
+    class SceneBvh {
+
+        public:
+            SceneBvh(void);
+
+            // Build over all solids in the registry; world transformations must be up to date
+            // Call again whenever solids are added
+            void Build(EntityRegistry* registry);
+            // Update the bounds of dynamic solids and drop destroyed ones, keeping the tree shape
+            void Refit(void);
+            void Clear(void);
+
+            // Closest solid hit by the ray within max_distance
+            // With triangles_only, solids that are only tested by their bounding box are ignored
+            bool RayCast(glm::vec3 origin, glm::vec3 direction, float max_distance, RayHit& hit, bool triangles_only = false) const;
+            // Closest solid between two points
+            bool SegmentCast(glm::vec3 from, glm::vec3 to, RayHit& hit, bool triangles_only = false) const;
+
+        private:
+            // Positions and triangle indices of a mesh, in model space
+            struct MeshData {
+                AABB bounds;
+                std::vector<glm::vec3> position;
+                std::vector<GLuint> index;
+            };
+
+            // World-space triangles of one solid (3 vertices per triangle) and a BVH over them
+            struct TriangleMesh {
+                std::vector<glm::vec3> vertex;
+                Bvh bvh;
+            };
+
+            struct Item {
+                EntityHandle entity;
+                int mesh; // Index in mesh_, or -1 for a box-only solid
+                bool dynamic;
+                bool removed;
+            };
+
+            EntityRegistry* registry_;
+            Bvh bvh_; // Over item_
+            std::vector<Item> item_;
+            std::vector<AABB> bounds_; // World-space bounds of each item
+            std::vector<TriangleMesh> mesh_;
+
+            // Meshes already read back, by array buffer
+            std::unordered_map<GLuint, MeshData> mesh_cache_;
+
+            const MeshData& GetMeshData(const SceneNode* node);
+            // World-space bounds of every node of an object
+            AABB GetBounds(CompositeNode* node);
+            void BuildTriangles(CompositeNode* node, TriangleMesh& mesh);
+
+            // All drawable nodes of an object (root and composite nodes, without hitboxes)
+            static void GetGeometryNodes(CompositeNode* node, std::vector<SceneNode*>& result);
+
+    }; // class SceneBvh
+
+} // namespace game
+
+#endif // SCENE_BVH_H_
@@ -0,0 +1,147 @@
+#include <cstring>
+#include <cstdint>
+#include <ios>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "scene_file.h"
+
+namespace game {
+
+    SceneFile::SceneFile(void) : data_(NULL), size_(0), header_(NULL), records_(NULL), file_(NULL), mapping_(NULL) {
+    }
+
+
+    SceneFile::~SceneFile() {
+
+        Close();
+    }
+
+
+    void SceneFile::Open(const std::string& filename) {
+
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw(std::ios_base::failure(std::string("Error opening file ") + filename));
+        }
+        file_ = file;
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        size_ = (size_t)size.QuadPart;
+        if (size_ > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                mapping_ = mapping;
+                data_ = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+        }
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw(std::ios_base::failure(std::string("Error opening file ") + filename));
+        }
+        file_ = (void*)(intptr_t)(fd + 1); // Keep NULL meaning "no file"
+
+        struct stat st;
+        size_ = (fstat(fd, &st) == 0) ? (size_t)st.st_size : 0;
+        if (size_ > 0) {
+            void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = (const char*)data;
+            }
+        }
+#endif
+
+        if (!data_) {
+            Close();
+            throw(std::ios_base::failure(std::string("Error mapping scene file ") + filename));
+        }
+
+        // Validate everything once, so records can be used without checks afterwards
+        const SceneFileHeader* header = (const SceneFileHeader*)data_;
+        const char* error = NULL;
+        if (size_ < sizeof(SceneFileHeader) || std::memcmp(header->magic, "BJSC", 4) != 0) {
+            error = "not a scene file";
+        }
+        else if (header->version != scene_file_version_g || header->record_size != sizeof(SceneRecord)) {
+            error = "unsupported version, convert it again";
+        }
+        else if ((uint64_t)header->num_records * sizeof(SceneRecord) > size_ - sizeof(SceneFileHeader) ||
+                 header->strings_offset < sizeof(SceneFileHeader) + (uint64_t)header->num_records * sizeof(SceneRecord) ||
+                 (uint64_t)header->strings_offset + header->strings_size > size_ ||
+                 header->strings_size == 0 || data_[header->strings_offset + header->strings_size - 1] != '\0') {
+            error = "truncated or corrupt";
+        }
+        else {
+            const SceneRecord* records = (const SceneRecord*)(data_ + sizeof(SceneFileHeader));
+            for (uint32_t i = 0; i < header->num_records && !error; i++) {
+                if (records[i].prefab >= PrefabCount) {
+                    error = "unknown prefab";
+                }
+                else if (records[i].link >= (int32_t)i) {
+                    error = "record linked to a later record";
+                }
+            }
+        }
+        if (error) {
+            Close();
+            throw(std::ios_base::failure(std::string("Error loading scene file ") + filename + std::string(": ") + std::string(error)));
+        }
+
+        header_ = header;
+        records_ = (const SceneRecord*)(data_ + sizeof(SceneFileHeader));
+    }
+
+
+    void SceneFile::Close(void) {
+
+#ifdef _WIN32
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle((HANDLE)mapping_);
+        }
+        if (file_) {
+            CloseHandle((HANDLE)file_);
+        }
+#else
+        if (data_) {
+            munmap((void*)data_, size_);
+        }
+        if (file_) {
+            close((int)(intptr_t)file_ - 1);
+        }
+#endif
+        data_ = NULL;
+        size_ = 0;
+        header_ = NULL;
+        records_ = NULL;
+        file_ = NULL;
+        mapping_ = NULL;
+    }
+
+
+    std::string_view SceneFile::GetString(uint32_t offset) const {
+
+        if (!header_ || offset >= header_->strings_size) {
+            return std::string_view();
+        }
+        // The table ends with a null character (checked in Open)
+        return std::string_view(data_ + header_->strings_offset + offset);
+    }
+
+} // namespace game
@@ -0,0 +1,117 @@
+/*
+ *
+ * Binary scene description: the objects placed in the world (prefab type, transformation and
+ * parameters), loaded at startup instead of being compiled into the game.
+ *
+ * Layout (little endian, all fields 4 bytes):
+ *   SceneFileHeader
+ *   SceneRecord[num_records]
+ *   string table (null-terminated strings, referenced by offset; offset 0 is the empty string)
+ *
+ * The file is memory-mapped and records are read in place. It is produced from a text
+ * description by tools/scene_converter.
+ *
+ */
+#ifndef SCENE_FILE_H_
+#define SCENE_FILE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace game {
+
+    // Bump whenever SceneRecord or the meaning of its fields changes
+    const uint32_t scene_file_version_g = 1;
+
+    // Object types a record can create (see Manipulator::ConstructWorld)
+    enum ScenePrefab : uint32_t {
+        PrefabSubmarine = 0,
+        PrefabPart,
+        PrefabKelp,          // param[0]: branch complexity
+        PrefabCoral,
+        PrefabAnemonie,
+        PrefabSeaweed,       // param[0]: length
+        PrefabSeaweedPatch,  // param[0..2]: strands, length, width
+        PrefabRock,
+        PrefabStalagmite,
+        PrefabVent,
+        PrefabVentBase,
+        PrefabParticles,     // string[0..2]: object, material, texture
+        PrefabCount
+    };
+
+    // Names used in the text description, indexed by ScenePrefab
+    const char* const scene_prefab_names_g[PrefabCount] = {
+        "submarine", "part", "kelp", "coral", "anemone", "seaweed", "seaweed_patch",
+        "rock", "stalagmite", "vent", "vent_base", "particles"
+    };
+
+    // Record flags
+    enum SceneRecordFlags : uint32_t {
+        RecordFollowCamera = 1, // Particle system stays at the camera position plus param[0..2]
+        RecordOnTerrain = 2 // position[1] is the height above the terrain (see Manipulator::SetTerrain)
+    };
+
+    struct SceneFileHeader {
+        char magic[4]; // "BJSC"
+        uint32_t version;
+        uint32_t num_records;
+        uint32_t record_size; // sizeof(SceneRecord) when written
+        uint32_t strings_offset; // From the start of the file
+        uint32_t strings_size;
+    };
+
+    struct SceneRecord {
+        uint32_t prefab;
+        uint32_t flags;
+        uint32_t name; // String offset
+        int32_t link; // Record destroyed together with this one (e.g. a part and its sparkles), or -1
+        float position[3];
+        float rotation[4]; // Quaternion applied after construction (w, x, y, z)
+        float scale[3]; // Applied after construction
+        float param[4];
+        uint32_t string[3];
+    };
+
+    static_assert(sizeof(SceneFileHeader) == 24, "Scene file header must be packed");
+    static_assert(sizeof(SceneRecord) == 84, "Scene records must be packed");
+
+
+    // Read-only memory mapping of a scene file
+    class SceneFile {
+
+        public:
+            SceneFile(void);
+            ~SceneFile();
+
+            SceneFile(const SceneFile&) = delete;
+            SceneFile& operator=(const SceneFile&) = delete;
+
+            // Map and validate a file; throws std::ios_base::failure
+            void Open(const std::string& filename);
+            void Close(void);
+
+            int GetNumRecords(void) const { return header_ ? header_->num_records : 0; }
+            const SceneRecord& GetRecord(int i) const { return records_[i]; }
+            // Size of the mapped file in bytes
+            size_t GetSize(void) const { return size_; }
+            // String from the string table ("" for an invalid offset)
+            std::string_view GetString(uint32_t offset) const;
+
+        private:
+            const char* data_;
+            size_t size_;
+            const SceneFileHeader* header_;
+            const SceneRecord* records_;
+
+            // Platform handles of the mapping
+            void* file_;
+            void* mapping_;
+
+    }; // class SceneFile
+
+} // namespace game
+
+#endif // SCENE_FILE_H_
@@ -31,22 +31,99 @@ glm::vec3 SceneGraph::GetBackgroundColor(void) const {
     return background_color_;
 }
 
-void SceneGraph::AddNode(CompositeNode *node){
+EntityHandle SceneGraph::AddNode(CompositeNode *node){
+
+    EntityHandle handle = node->GetHandle();
+    if (!registry_.IsAlive(handle)) {
+        handle = registry_.Create();
+        node->SetHandle(handle);
+    }
+
+    // Every node is transformed and drawn
+    registry_.transform_.Add(handle, Transform{ node });
+    registry_.renderable_.Add(handle, Renderable{ node });
+
+    if (handle.index >= slot_.size()) {
+        slot_.resize(handle.index + 1);
+    }
+    slot_[handle.index].node = node;
+    slot_[handle.index].dense = node_.size();
+    slot_[handle.index].dying = false;
+    slot_[handle.index].links.clear();
 
     node_.push_back(node);
+    node_slot_.push_back(handle.index);
+    index_.Insert(node->GetName(), node);
+    return handle;
 }
 
 
-CompositeNode *SceneGraph::GetNode(std::string node_name) const {
+CompositeNode* SceneGraph::GetNode(EntityHandle handle) const {
 
-    // Find node with the specified name
-    for (int i = 0; i < node_.size(); i++){
-        if (node_[i]->GetName() == node_name){
-            return node_[i];
-        }
+    if (!IsAlive(handle)) {
+        return NULL;
     }
-    return NULL;
+    return slot_[handle.index].node;
+}
+
+
+bool SceneGraph::IsAlive(EntityHandle handle) const {
+
+    return registry_.IsAlive(handle) && handle.index < slot_.size() && slot_[handle.index].node != NULL;
+}
+
+
+bool SceneGraph::IsDying(EntityHandle handle) const {
+
+    return IsAlive(handle) && slot_[handle.index].dying;
+}
+
+
+void SceneGraph::Destroy(EntityHandle handle) {
+
+    if (!IsAlive(handle) || slot_[handle.index].dying) {
+        return;
+    }
+    slot_[handle.index].dying = true;
+    dying_.push_back(handle);
+
+    // Anything linked goes with it
+    for (int i = 0; i < slot_[handle.index].links.size(); i++) {
+        Destroy(slot_[handle.index].links[i]);
+    }
+}
+
+
+void SceneGraph::Link(EntityHandle owner, EntityHandle dependent) {
+
+    if (!IsAlive(owner) || !IsAlive(dependent)) {
+        return;
+    }
+    slot_[owner.index].links.push_back(dependent);
+}
+
+
+void SceneGraph::EndFrame(void) {
+
+    for (int i = 0; i < dying_.size(); i++) {
+        EraseNode(dying_[i]);
+    }
+    dying_.clear();
+    // The list may point to freed nodes now
+    render_list_.clear();
+}
+
+
+CompositeNode *SceneGraph::GetNode(std::string_view node_name) const {
+
+    // Find node with the specified name
+    return index_.Find(node_name);
+}
+
+
+CompositeNode *SceneGraph::GetNode(const NameKey& key) const {
 
+    return index_.Find(key);
 }
   
 CompositeNode* SceneGraph::GetNode(int index) const {
@@ -64,13 +141,24 @@ void SceneGraph::ClearObj()
 
     for (int i = 0; i < node_.size(); i++)
     {
-        for (SceneNode* node : node_[i]->GetAllNodes())
-        {
-            delete node;
-        }
+        DeleteNode(node_[i]);
         delete node_[i];
     }
     node_.clear();
+    node_slot_.clear();
+    index_.Clear();
+
+    // Every outstanding handle becomes stale
+    registry_.Clear();
+    grid_.Clear();
+    bvh_.Clear();
+    slot_.clear();
+    dying_.clear();
+    render_list_.clear();
+
+    // With the whole world gone the node pools can hand their memory back at once
+    SceneNode::ReleasePool();
+    CompositeNode::ReleasePool();
 }
 
 std::vector<CompositeNode *>::const_iterator SceneGraph::begin() const { return node_.begin(); }
@@ -87,9 +175,11 @@ void SceneGraph::Draw(Camera *camera, SceneNode* light){
                  background_color_[2], 0.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Draw all scene nodes
-    for (int i = 0; i < node_.size(); i++){
-        node_[i]->Draw(camera, light);
+    // Transformations are computed up front so drawing only submits to OpenGL
+    BuildRenderList();
+
+    for (int i = 0; i < render_list_.size(); i++) {
+        render_list_[i]->Draw(camera, light);
     }
 }
 
@@ -118,45 +208,110 @@ void SceneGraph::DeleteNode(CompositeNode* node)
 }
 // Handles movement, collisions, and geometric changes
 int SceneGraph::Update(Camera* camera, ResourceManager* resman) {
-    int val = 0;
-    int index = 0;
-    std::string name;
-    std::string particle = "ParticleStarInstance";
-    for (int i = 0; i < node_.size(); i++) {
+
+    // Parallel phase: every composite node is independent of the others
+    pool_.ParallelFor(node_.size(), [this, camera](int i) {
         node_[i]->Update(camera);
-    }
+    });
 
-     while (index < node_.size())
-     {
-         if (node_[index]->GetRoot()->GetCollision() == 2)
-         {
-             name = node_[index]->GetName();
-             if (name.find("Mechanical_Part") != std::string::npos)
-             {
-                 char last = name.back();
-
-                 for (int i = 0; i < node_.size(); i++)
-                 {
-                     if (node_[i]->GetName().compare(particle + last) == 0)
-                     {
-                         DeleteNode(node_[i]);
-                         node_.erase(node_.begin() + i);
-                         break;
-                     }
-                 }
-             }
-
-             DeleteNode(node_[index]);
-             node_.erase(node_.begin() + index);
-             continue;
-         }
-         index = index + 1;
+    // Collected parts are removed (with their linked effects) at the end of the frame
+    for (int i = 0; i < registry_.collectible_.GetSize(); i++) {
+        if (registry_.collectible_[i].node->GetRoot()->GetCollision() == 2) {
+            Destroy(registry_.collectible_.GetEntity(i));
+        }
     }
 
+    UpdateSpatialIndex();
+
     return 0;
 }
 
 
+void SceneGraph::UpdateSpatialIndex(void) {
+
+    for (int i = 0; i < registry_.collider_.GetSize(); i++) {
+        const Collider& collider = registry_.collider_[i];
+        glm::vec3 center = collider.node->GetRoot()->GetPosition();
+        float radius = collider.node->GetRoot()->GetRadius();
+
+        // Objects that collide through hitboxes need a sphere around all of them
+        if (collider.hitboxes) {
+            for (int h = 0; h < collider.node->hitboxes_.size(); h++) {
+                SceneNode* hitbox = collider.node->hitboxes_[h];
+                radius = glm::max(radius, glm::length(hitbox->GetPosition()) + hitbox->GetRadius());
+            }
+        }
+
+        grid_.Update(registry_.collider_.GetEntity(i), center, radius, collider.layer);
+    }
+}
+
+
+void SceneGraph::EraseNode(EntityHandle handle) {
+
+    if (!IsAlive(handle)) {
+        return;
+    }
+    Slot& slot = slot_[handle.index];
+    CompositeNode* node = slot.node;
+
+    // Swap and pop: the last node takes the freed position
+    int index = slot.dense;
+    int last = node_.size() - 1;
+    node_[index] = node_[last];
+    node_slot_[index] = node_slot_[last];
+    slot_[node_slot_[index]].dense = index;
+    node_.pop_back();
+    node_slot_.pop_back();
+
+    // Names are not unique; if this node was the one indexed, another node with
+    // the same name takes its place
+    std::string name = node->GetName();
+    if (index_.Find(name) == node) {
+        index_.Erase(name);
+        for (int i = 0; i < node_.size(); i++) {
+            if (node_[i]->GetName() == name) {
+                index_.Insert(name, node_[i]);
+                break;
+            }
+        }
+    }
+
+    // Drop the components; this invalidates every handle to the entity
+    grid_.Remove(handle);
+    slot.node = NULL;
+    slot.dense = -1;
+    slot.dying = false;
+    slot.links.clear();
+    registry_.Destroy(handle);
+
+    DeleteNode(node);
+    delete node;
+}
+
+
+void SceneGraph::UpdateTransforms(void) {
+
+    pool_.ParallelFor(registry_.transform_.GetSize(), [this](int i) {
+        registry_.transform_[i].node->UpdateTransforms();
+    });
+}
+
+
+void SceneGraph::BuildRenderList(void) {
+
+    UpdateTransforms();
+
+    // All renderable nodes (destroyed ones are only waiting to be freed)
+    render_list_.clear();
+    for (int i = 0; i < registry_.renderable_.GetSize(); i++) {
+        if (!slot_[registry_.renderable_.GetEntity(i).index].dying) {
+            render_list_.push_back(registry_.renderable_[i].node);
+        }
+    }
+}
+
+
 void SceneGraph::SetupDrawToTexture(void) {
 
     // Set up frame buffer
@@ -224,9 +379,8 @@ void SceneGraph::DrawToTexture(Camera* camera, SceneNode* light) {
         background_color_[2], 0.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Draw all scene nodes
-    for (int i = 0; i < node_.size(); i++) {
-        node_[i]->Draw(camera, light);
+    for (int i = 0; i < render_list_.size(); i++) {
+        render_list_[i]->Draw(camera, light);
     }
 
     // Reset frame buffer
@@ -12,6 +12,12 @@
 #include "resource.h"
 #include "resource_manager.h"
 #include "camera.h"
+#include "thread_pool.h"
+#include "name_index.h"
+#include "entity_handle.h"
+#include "entity_registry.h"
+#include "spatial_grid.h"
+#include "scene_bvh.h"
 
 // Size of the texture that we will draw
 #define FRAME_BUFFER_WIDTH 1280
@@ -27,7 +33,37 @@ namespace game {
             glm::vec3 background_color_;
 
             // Scene nodes to render (now only accepts composite nodes)
+            // Kept densely packed: removing a node moves the last node into its place
             std::vector<CompositeNode *> node_;
+            // Slot of every entry in node_
+            std::vector<uint32_t> node_slot_;
+
+            // Entities and their components; handles of the nodes in node_ come from here
+            EntityRegistry registry_;
+
+            // Per-entity bookkeeping, indexed by EntityHandle::index
+            struct Slot {
+                CompositeNode* node = NULL;
+                int dense = -1; // Position in node_, -1 when the entity has no node
+                bool dying = false; // Destroy() was called, node is freed at the end of the frame
+                std::vector<EntityHandle> links; // Entities destroyed together with this one
+            };
+            std::vector<Slot> slot_;
+            // Entities waiting to be destroyed at the end of the frame
+            std::vector<EntityHandle> dying_;
+
+            // Colliders by location, kept up to date by Update
+            SpatialGrid grid_;
+            // Solids for ray and segment queries, built once the world is populated
+            SceneBvh bvh_;
+            // Name lookup for node_ (first node added under a name wins, as with a linear search)
+            NameIndex<CompositeNode> index_;
+
+            // Workers for per-node updates; each composite node is handled by one thread at a time
+            ThreadPool pool_;
+            // Nodes to draw this frame, made by BuildRenderList
+            std::vector<CompositeNode*> render_list_;
+
 
             // Frame buffer for drawing to texture
             GLuint frame_buffer_;
@@ -43,8 +79,14 @@ namespace game {
             ~SceneGraph();
             // Getters
             int GetSize() { return node_.size(); }
-            CompositeNode* GetNode(std::string node_name) const;
+            CompositeNode* GetNode(std::string_view node_name) const;
+            CompositeNode* GetNode(const NameKey& key) const;
             CompositeNode* GetNode(int index) const;
+            CompositeNode* GetNode(EntityHandle handle) const;
+            // True if the handle refers to a node that has not been destroyed yet
+            bool IsAlive(EntityHandle handle) const;
+            // True if the node is alive but queued for destruction this frame
+            bool IsDying(EntityHandle handle) const;
 
             // Create a scene node from the specified resources
             CompositeNode* CreateNode(std::string node_name, Resource* geometry, Resource* material, Resource* texture = NULL);
@@ -53,30 +95,56 @@ namespace game {
             void SetBackgroundColor(glm::vec3 color);
             glm::vec3 GetBackgroundColor(void) const;
             
-            // Add an already-created node
-            void AddNode(CompositeNode *node);
+            // Add an already-created node, returns the handle it can be found by
+            // Nodes made by the Manipulator builders already have an entity; others get one here
+            EntityHandle AddNode(CompositeNode *node);
+            // Queue a node (and everything linked to it) for destruction at the end of the frame
+            void Destroy(EntityHandle handle);
+            // Destroy dependent whenever owner is destroyed (e.g. a part and its sparkle effect)
+            void Link(EntityHandle owner, EntityHandle dependent);
+            // Free everything queued by Destroy; call once per frame after drawing
+            void EndFrame(void);
             // Get node const iterator
             std::vector<CompositeNode *>::const_iterator begin() const;
             std::vector<CompositeNode *>::const_iterator end() const;
 
-            // Draw the entire scene
+            // Draw the entire scene (builds the render list first)
             void Draw(Camera *camera, SceneNode* light);
             void Draw();
             // Update entire scene
             int Update(Camera *camera, ResourceManager *resman);
+            // Compute world transformations of every node (runs in parallel, done before drawing)
+            void UpdateTransforms(void);
+            // CPU side of drawing: update the transformations and collect the nodes to draw.
+            // Does not use OpenGL, so it can run on any thread
+            void BuildRenderList(void);
+            // Thread pool shared by the per-node update phases
+            inline ThreadPool& GetThreadPool(void) { return pool_; }
+            // Components of the nodes in the scene
+            inline EntityRegistry& GetRegistry(void) { return registry_; }
+            // Spatial index of every entity with a collider
+            inline SpatialGrid& GetSpatialGrid(void) { return grid_; }
+            // Ray queries against every entity with a solid component
+            inline SceneBvh& GetBvh(void) { return bvh_; }
+            // Insert/move all colliders in the spatial index (done by Update)
+            void UpdateSpatialIndex(void);
 
             void ClearObj();
             void DeleteNode(CompositeNode* node);
             // Drawing from/to a texture
             // Setup the texture
             void SetupDrawToTexture(void);
-            // Draw the scene into a texture
+            // Draw the render list into a texture (call BuildRenderList first)
             void DrawToTexture(Camera* camera, SceneNode* light);
             // Process and draw the texture on the screen
             void DisplayTexture(Camera* camera, GLuint program);
             // Save texture to a file in ppm format
             void SaveTexture(char* filename);
 
+        private:
+            // Remove a node from node_ and the name index, then free it
+            void EraseNode(EntityHandle handle);
+
     }; // class SceneGraph
 
 } // namespace game
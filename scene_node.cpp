@@ -4,9 +4,62 @@
 #include <time.h>
 
 #include "scene_node.h"
+#include "node_pool.h"
+#include "resource_manager.h"
 
 namespace game {
 
+    static NodePool<SceneNode>& GetSceneNodePool(void) {
+
+        static NodePool<SceneNode> pool;
+        return pool;
+    }
+
+
+    void* SceneNode::operator new(std::size_t size) {
+
+        // Anything that is not exactly a SceneNode goes through the global allocator
+        if (size != sizeof(SceneNode)) {
+            return ::operator new(size);
+        }
+        return GetSceneNodePool().Allocate();
+    }
+
+
+    void SceneNode::operator delete(void* p, std::size_t size) {
+
+        if (p == nullptr) {
+            return;
+        }
+        if (size != sizeof(SceneNode)) {
+            ::operator delete(p);
+            return;
+        }
+        GetSceneNodePool().Free(p);
+    }
+
+
+    void SceneNode::ReleasePool(void) {
+
+        GetSceneNodePool().Release();
+    }
+
+
+    static const ResourceManager* resource_manager_g = NULL;
+
+    void SceneNode::SetResourceManager(const ResourceManager* resman) {
+
+        resource_manager_g = resman;
+    }
+
+
+    GLuint SceneNode::ResolveTexture(TextureHandle texture) {
+
+        const Resource* res = resource_manager_g ? resource_manager_g->Resolve(texture) : NULL;
+        return res ? res->GetResource() : 0;
+    }
+
+
     SceneNode::SceneNode(const std::string name, const Resource* geometry, const Resource* material, const Resource* texture, int collision = 0) {
 
         // Set name of scene node
@@ -23,23 +76,18 @@ namespace game {
             throw(std::invalid_argument(std::string("Invalid type of geometry")));
         }
 
-        array_buffer_ = geometry->GetArrayBuffer();
-        element_array_buffer_ = geometry->GetElementArrayBuffer();
-        size_ = geometry->GetSize();
+        geometry_ = geometry->GetMeshHandle();
 
         // Set material (shader program)
         if (material->GetType() != Material) {
             throw(std::invalid_argument(std::string("Invalid type of material")));
         }
 
-        material_ = material->GetResource();
+        material_ = material->GetMaterialHandle();
 
-        // Set texture
+        // Set texture (null handle if none)
         if (texture) {
-            texture_ = texture->GetResource();
-        }
-        else {
-            texture_ = 0;
+            texture_ = texture->GetTextureHandle();
         }
 
         // Other attributes
@@ -175,6 +223,25 @@ namespace game {
         pivot_ *= scale;
     }
 
+    void SceneNode::SetSway(glm::vec3 amplitude, float frequency, float phase) {
+        sway_amplitude_ = amplitude;
+        sway_frequency_ = frequency;
+        sway_phase_ = phase;
+    }
+
+    glm::mat4 SceneNode::GetSwayTransf(double time) const {
+        float angle = sway_frequency_ * time + sway_phase_;
+        glm::quat rot = glm::angleAxis(sway_amplitude_.x * sin(angle), glm::vec3(1, 0, 0)) *
+                        glm::angleAxis(sway_amplitude_.y * sin(angle), glm::vec3(0, 1, 0)) *
+                        glm::angleAxis(sway_amplitude_.z * cos(angle), glm::vec3(0, 0, 1));
+        glm::vec3 trans = glm::vec3(pivot_ - position_);
+        return glm::translate(glm::mat4(1.0f), trans) * glm::mat4_cast(rot) * glm::translate(glm::mat4(1.0f), -trans);
+    }
+
+    void SceneNode::Sway(double time) {
+        sway_ = GetSwayTransf(time);
+    }
+
 
     GLenum SceneNode::GetMode(void) const {
 
@@ -182,27 +249,37 @@ namespace game {
     }
 
 
+    bool SceneNode::HasResources(void) const {
+
+        return resource_manager_g && resource_manager_g->Resolve(geometry_) && resource_manager_g->Resolve(material_);
+    }
+
+
     GLuint SceneNode::GetArrayBuffer(void) const {
 
-        return array_buffer_;
+        const Resource* res = resource_manager_g ? resource_manager_g->Resolve(geometry_) : NULL;
+        return res ? res->GetArrayBuffer() : 0;
     }
 
 
     GLuint SceneNode::GetElementArrayBuffer(void) const {
 
-        return element_array_buffer_;
+        const Resource* res = resource_manager_g ? resource_manager_g->Resolve(geometry_) : NULL;
+        return res ? res->GetElementArrayBuffer() : 0;
     }
 
 
     GLsizei SceneNode::GetSize(void) const {
 
-        return size_;
+        const Resource* res = resource_manager_g ? resource_manager_g->Resolve(geometry_) : NULL;
+        return res ? res->GetSize() : 0;
     }
 
 
     GLuint SceneNode::GetMaterial(void) const {
 
-        return material_;
+        const Resource* res = resource_manager_g ? resource_manager_g->Resolve(material_) : NULL;
+        return res ? res->GetResource() : 0;
     }
 
     glm::mat4 SceneNode::GetParentTransf(void) const {
@@ -222,31 +299,37 @@ void SceneNode::SetGeometry(const Resource *geometry) {
         throw(std::invalid_argument(std::string("Invalid type of geometry")));
     }
 
-    array_buffer_ = geometry->GetArrayBuffer();
-    element_array_buffer_ = geometry->GetElementArrayBuffer();
-    size_ = geometry->GetSize();
+    geometry_ = geometry->GetMeshHandle();
 }
 
 void SceneNode::Draw(Camera *camera, SceneNode* light){
 
+    // Nothing to draw with once the resources were removed
+    const Resource* geometry = resource_manager_g ? resource_manager_g->Resolve(geometry_) : NULL;
+    const Resource* material = resource_manager_g ? resource_manager_g->Resolve(material_) : NULL;
+    if (!geometry || !material){
+        return;
+    }
+    GLuint program = material->GetResource();
+
     // Select proper material (shader program)
-    glUseProgram(material_);
+    glUseProgram(program);
 
     // Set geometry to draw
-    glBindBuffer(GL_ARRAY_BUFFER, array_buffer_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_array_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->GetArrayBuffer());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->GetElementArrayBuffer());
 
     // Set globals for camera
-    camera->SetupShader(material_);
+    camera->SetupShader(program);
 
     // Set world matrix and other shader input variables
-    SetupShader(material_, camera, light);
+    SetupShader(program, camera, light);
 
     // Draw geometry
     if (mode_ == GL_POINTS){
-        glDrawArrays(mode_, 0, size_);
+        glDrawArrays(mode_, 0, geometry->GetSize());
     } else {
-        glDrawElements(mode_, size_, GL_UNSIGNED_INT, 0);
+        glDrawElements(mode_, geometry->GetSize(), GL_UNSIGNED_INT, 0);
     }
 }
 
@@ -257,11 +340,25 @@ void SceneNode::Update(Camera *camera){
 }
 
 
-void SceneNode::SetupShader(GLuint program, Camera* camera, SceneNode* light){
+void SceneNode::UpdateTransform(void){
 
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    // World transformation
+    glm::mat4 scaling = glm::scale(glm::mat4(1.0), scale_);
+    glm::mat4 rotation = glm::mat4_cast(orientation_);
+    glm::mat4 orbit = orbit_ * sway_;
+    glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
+    world_transf_ = parent_transf_ * translation * orbit * rotation * scaling; // why this sequence?
+
+    position_collision_ = glm::vec3(world_transf_ * glm::vec4(position_, 1.0));
+
+    for (int i = 0; i < children_.size(); i++) {
+        children_[i]->SetParentTransf(world_transf_);
+    }
+}
+
+
+void SceneNode::SetupAttributes(GLuint program){
 
-    // Set attributes for shaders
     GLint vertex_att = glGetAttribLocation(program, "vertex");
     glVertexAttribPointer(vertex_att, 3, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), 0);
     glEnableVertexAttribArray(vertex_att);
@@ -277,19 +374,18 @@ void SceneNode::SetupShader(GLuint program, Camera* camera, SceneNode* light){
     GLint tex_att = glGetAttribLocation(program, "uv");
     glVertexAttribPointer(tex_att, 2, GL_FLOAT, GL_FALSE, 11*sizeof(GLfloat), (void *) (9*sizeof(GLfloat)));
     glEnableVertexAttribArray(tex_att);
+}
 
-    // World transformation
-    glm::mat4 scaling = glm::scale(glm::mat4(1.0), scale_);
-    glm::mat4 rotation = glm::mat4_cast(orientation_);
-    glm::mat4 orbit = orbit_;
-    glm::mat4 translation = glm::translate(glm::mat4(1.0), position_);
-    glm::mat4 transf = parent_transf_ * translation * orbit * rotation * scaling; // why this sequence?
 
-    position_collision_ = glm::vec3(transf * glm::vec4(position_, 1.0));
+void SceneNode::SetupShader(GLuint program, Camera* camera, SceneNode* light){
 
-    for (int i = 0; i < children_.size(); i++) {
-        children_[i]->SetParentTransf(transf);
-    }
+    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+    // Set attributes for shaders
+    SetupAttributes(program);
+
+    // World transformation (computed beforehand by UpdateTransform)
+    glm::mat4 transf = world_transf_;
 
     GLint world_mat = glGetUniformLocation(program, "world_mat");
     glUniformMatrix4fv(world_mat, 1, GL_FALSE, glm::value_ptr(transf));
@@ -300,19 +396,13 @@ void SceneNode::SetupShader(GLuint program, Camera* camera, SceneNode* light){
     glUniformMatrix4fv(normal_mat, 1, GL_FALSE, glm::value_ptr(normal_matrix));
     
     // Texture
-    if (texture_) {
+    GLuint texture = ResolveTexture(texture_);
+    if (texture) {
         GLint tex = glGetUniformLocation(program, "texture_map");
         glUniform1i(tex, 0); // Assign the first texture to the map
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture_); // First texture we bind
-        // Define texture interpolation
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, texture); // First texture we bind
+        // Mipmaps and interpolation are set up when the texture is loaded
 
         if (t_ == ParticleSystem) {
             //enable alpha blending for transparency of textured particles
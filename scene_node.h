@@ -26,6 +26,8 @@
 
 namespace game {
 
+    class ResourceManager;
+
     // Class that manages one object in a scene 
     class SceneNode {
 
@@ -35,7 +37,17 @@ namespace game {
             SceneNode(const std::string name, const Resource *geometry, const Resource *material, const Resource* texture, int collision);
 
             // Destructor
-            ~SceneNode();
+            virtual ~SceneNode();
+
+            // Nodes are allocated from a slab pool (see node_pool.h)
+            static void* operator new(std::size_t size);
+            static void operator delete(void* p, std::size_t size);
+            // Return the pool's memory to the system; only does anything once every node is deleted
+            static void ReleasePool(void);
+            // Manager that resolves the resource handles of every node (set before drawing)
+            static void SetResourceManager(const ResourceManager* resman);
+            // OpenGL texture of a handle, 0 if it is not loaded
+            static GLuint ResolveTexture(TextureHandle texture);
             
             // Get name of node
             const std::string GetName(void) const;
@@ -80,6 +92,13 @@ namespace game {
             void Orbit(glm::quat rot);
             void Scale(glm::vec3 scale);
 
+            // Sway animation about the pivot; the pose is computed from the time alone, so it
+            // never accumulates error and any timestamp can be evaluated independently
+            // Amplitudes are angles (radians) about the x, y and z axes
+            void SetSway(glm::vec3 amplitude, float frequency, float phase);
+            glm::mat4 GetSwayTransf(double time) const;
+            void Sway(double time);
+
             // Draw the node according to scene parameters in 'camera'
             // variable
             virtual void Draw(Camera *camera, SceneNode* light);
@@ -87,13 +106,22 @@ namespace game {
             // Update the node
             virtual void Update(Camera *camera);
 
-            // OpenGL variables
+            // Compute the world transformation of the node and pass it on to its children
+            // Must run for a parent before its children; safe to run for separate hierarchies in parallel
+            void UpdateTransform(void);
+
+            // True while the geometry and the material are loaded; nodes whose resources were
+            // removed are not drawn
+            bool HasResources(void) const;
+            // OpenGL variables (0 while the resource is unloaded)
             GLenum GetMode(void) const;
             GLuint GetArrayBuffer(void) const;
             GLuint GetElementArrayBuffer(void) const;
             GLsizei GetSize(void) const;
             GLuint GetMaterial(void) const;
             glm::mat4 GetParentTransf(void) const;
+            // World transformation from the last UpdateTransform()
+            inline const glm::mat4& GetWorldTransf(void) const { return world_transf_; }
             int GetCollision(void) const;
             float GetRadius(void) const;
             Type GetType(void);
@@ -105,21 +133,24 @@ namespace game {
         private:
             std::string name_; // Name of the scene node
             std::vector<SceneNode*> children_;
-            GLuint array_buffer_; // References to geometry: vertex and array buffers
-            GLuint element_array_buffer_;
+            MeshHandle geometry_; // Vertex and array buffers
             GLenum mode_; // Type of geometry
-            GLsizei size_; // Number of primitives in geometry
-            GLuint material_; // Reference to shader program
-            GLuint texture_; // Reference to texture resource
+            MaterialHandle material_; // Shader program
+            TextureHandle texture_; // Texture, null if none
             glm::vec3 position_; // Position of node
             glm::vec3 position_collision_;
             glm::quat orientation_; // Orientation of node
             glm::mat4 orbit_; // orbit motion + rotation
+            glm::mat4 sway_ = glm::mat4(1.0f); // animated orbit for the current time
+            glm::vec3 sway_amplitude_ = glm::vec3(0.0f);
+            float sway_frequency_ = 0.0f;
+            float sway_phase_ = 0.0f;
             glm::vec3 scale_; // Scale of node
             glm::vec3 color_ = glm::vec3(1,0,1);
             int tile_count_ = 10; // The # of tiles for the texture mapping
             glm::vec3 pivot_; // the point at which the node orbits (locally)
             glm::mat4 parent_transf_ = glm::mat4(1.0f);
+            glm::mat4 world_transf_ = glm::mat4(1.0f); // Result of the last UpdateTransform()
             Type t_; // for use in shader. Types allow for differentiation between stems and leaves
       
             // For collision
@@ -133,8 +164,11 @@ namespace game {
             float specular_power_ = 278.0;
             float ambient_lighting_ = 0.2;
 
+        protected:
             // Set matrices that transform the node in a shader program
             virtual void SetupShader(GLuint program, Camera* camera, SceneNode* light);
+            // Point the vertex attributes of the program at the bound array buffer
+            virtual void SetupAttributes(GLuint program);
 
     }; // class SceneNode
 
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cmath>
+
+#include "spatial_grid.h"
+
+namespace game {
+
+    SpatialGrid::SpatialGrid(void) {
+
+        num_entities_ = 0;
+        query_ = 0;
+        Init(glm::vec2(-100.0f, -100.0f), glm::vec2(100.0f, 100.0f), 10.0f);
+    }
+
+
+    void SpatialGrid::Init(glm::vec2 min_corner, glm::vec2 max_corner, float cell_size) {
+
+        min_corner_ = min_corner;
+        cell_size_ = cell_size;
+        cells_x_ = std::max(1, (int)ceil((max_corner.x - min_corner.x) / cell_size));
+        cells_z_ = std::max(1, (int)ceil((max_corner.y - min_corner.y) / cell_size));
+
+        cell_.assign(cells_x_ * cells_z_, std::vector<uint32_t>());
+        entry_.clear();
+        num_entities_ = 0;
+    }
+
+
+    int SpatialGrid::CellX(float x) const {
+
+        int c = (int)floor((x - min_corner_.x) / cell_size_);
+        return std::min(std::max(c, 0), cells_x_ - 1);
+    }
+
+
+    int SpatialGrid::CellZ(float z) const {
+
+        int c = (int)floor((z - min_corner_.y) / cell_size_);
+        return std::min(std::max(c, 0), cells_z_ - 1);
+    }
+
+
+    void SpatialGrid::AddToCells(uint32_t index) {
+
+        const Entry& e = entry_[index];
+        for (int z = e.z0; z <= e.z1; z++) {
+            for (int x = e.x0; x <= e.x1; x++) {
+                cell_[x + z * cells_x_].push_back(index);
+            }
+        }
+    }
+
+
+    void SpatialGrid::RemoveFromCells(uint32_t index) {
+
+        const Entry& e = entry_[index];
+        for (int z = e.z0; z <= e.z1; z++) {
+            for (int x = e.x0; x <= e.x1; x++) {
+                std::vector<uint32_t>& cell = cell_[x + z * cells_x_];
+                for (int i = 0; i < cell.size(); i++) {
+                    if (cell[i] == index) {
+                        cell[i] = cell.back();
+                        cell.pop_back();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+
+    void SpatialGrid::Insert(EntityHandle entity, glm::vec3 center, float radius, uint32_t layer) {
+
+        if (Contains(entity)) {
+            Update(entity, center, radius, layer);
+            return;
+        }
+        if (entity.index >= entry_.size()) {
+            entry_.resize(entity.index + 1);
+        }
+        // A stale entry from an older entity in the same slot is dropped
+        if (entry_[entity.index].used) {
+            Remove(entry_[entity.index].entity);
+        }
+
+        Entry& e = entry_[entity.index];
+        e.entity = entity;
+        e.center = center;
+        e.radius = radius;
+        e.layer = layer;
+        e.x0 = CellX(center.x - radius);
+        e.x1 = CellX(center.x + radius);
+        e.z0 = CellZ(center.z - radius);
+        e.z1 = CellZ(center.z + radius);
+        e.used = true;
+        AddToCells(entity.index);
+        num_entities_++;
+    }
+
+
+    void SpatialGrid::Update(EntityHandle entity, glm::vec3 center, float radius, uint32_t layer) {
+
+        if (!Contains(entity)) {
+            Insert(entity, center, radius, layer);
+            return;
+        }
+
+        Entry& e = entry_[entity.index];
+        e.center = center;
+        e.radius = radius;
+        e.layer = layer;
+
+        // Only touch the cells when the covered range changed
+        int x0 = CellX(center.x - radius);
+        int x1 = CellX(center.x + radius);
+        int z0 = CellZ(center.z - radius);
+        int z1 = CellZ(center.z + radius);
+        if (x0 != e.x0 || x1 != e.x1 || z0 != e.z0 || z1 != e.z1) {
+            RemoveFromCells(entity.index);
+            e.x0 = x0;
+            e.x1 = x1;
+            e.z0 = z0;
+            e.z1 = z1;
+            AddToCells(entity.index);
+        }
+    }
+
+
+    void SpatialGrid::Remove(EntityHandle entity) {
+
+        if (!Contains(entity)) {
+            return;
+        }
+        RemoveFromCells(entity.index);
+        entry_[entity.index].used = false;
+        num_entities_--;
+    }
+
+
+    bool SpatialGrid::Contains(EntityHandle entity) const {
+
+        return entity.index < entry_.size() && entry_[entity.index].used && entry_[entity.index].entity == entity;
+    }
+
+
+    void SpatialGrid::Clear(void) {
+
+        for (int i = 0; i < cell_.size(); i++) {
+            cell_[i].clear();
+        }
+        entry_.clear();
+        num_entities_ = 0;
+    }
+
+
+    template <typename Test>
+    void SpatialGrid::Query(int x0, int z0, int x1, int z1, uint32_t layer_mask, Test test, std::vector<EntityHandle>& result) const {
+
+        // Stamp entities as they are reported so ones in several cells only come out once
+        if (visited_.size() < entry_.size()) {
+            visited_.resize(entry_.size(), 0);
+        }
+        query_++;
+        if (query_ == 0) {
+            std::fill(visited_.begin(), visited_.end(), 0);
+            query_ = 1;
+        }
+
+        for (int z = z0; z <= z1; z++) {
+            for (int x = x0; x <= x1; x++) {
+                const std::vector<uint32_t>& cell = cell_[x + z * cells_x_];
+                for (int i = 0; i < cell.size(); i++) {
+                    uint32_t index = cell[i];
+                    if (visited_[index] == query_) {
+                        continue;
+                    }
+                    visited_[index] = query_;
+                    // Layer check first, it is cheaper than the overlap test
+                    if ((entry_[index].layer & layer_mask) && test(entry_[index])) {
+                        result.push_back(entry_[index].entity);
+                    }
+                }
+            }
+        }
+    }
+
+
+    void SpatialGrid::QueryRadius(glm::vec3 center, float radius, std::vector<EntityHandle>& result, uint32_t layer_mask) const {
+
+        glm::vec2 c(center.x, center.z);
+        Query(CellX(center.x - radius), CellZ(center.z - radius), CellX(center.x + radius), CellZ(center.z + radius), layer_mask,
+            [c, radius](const Entry& e) {
+                float reach = radius + e.radius;
+                glm::vec2 d = glm::vec2(e.center.x, e.center.z) - c;
+                return glm::dot(d, d) <= reach * reach;
+            }, result);
+    }
+
+
+    void SpatialGrid::QueryAABB(glm::vec3 min_corner, glm::vec3 max_corner, std::vector<EntityHandle>& result, uint32_t layer_mask) const {
+
+        Query(CellX(min_corner.x), CellZ(min_corner.z), CellX(max_corner.x), CellZ(max_corner.z), layer_mask,
+            [min_corner, max_corner](const Entry& e) {
+                // Distance from the sphere center to the closest point of the box
+                glm::vec3 closest = glm::clamp(e.center, min_corner, max_corner);
+                glm::vec3 d = e.center - closest;
+                return glm::dot(d, d) <= e.radius * e.radius;
+            }, result);
+    }
+
+} // namespace game
@@ -0,0 +1,83 @@
+/*
+ *
+ * Uniform grid over the playing field (x/z plane) used to find the objects near a point without
+ * visiting every object in the scene. Each entity is stored as a bounding sphere and registered
+ * in every cell its sphere overlaps; objects outside the field are clamped into the border cells.
+ * Entities carry a collision layer bit so queries can skip layers they are not interested in.
+ *
+ */
+#ifndef SPATIAL_GRID_H_
+#define SPATIAL_GRID_H_
+
+#include <cstdint>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "entity_handle.h"
+
+namespace game {
+
+    class SpatialGrid {
+
+        public:
+            SpatialGrid(void);
+
+            // Cover the rectangle min_corner..max_corner (x, z) with square cells of the given size
+            // Removes everything that was inserted before
+            void Init(glm::vec2 min_corner, glm::vec2 max_corner, float cell_size);
+
+            // Add an entity with the given bounding sphere and layer (see CollisionLayer)
+            void Insert(EntityHandle entity, glm::vec3 center, float radius, uint32_t layer = 0xFFFFFFFF);
+            // Move an entity (inserts it if it is not in the grid yet)
+            void Update(EntityHandle entity, glm::vec3 center, float radius, uint32_t layer = 0xFFFFFFFF);
+            void Remove(EntityHandle entity);
+            bool Contains(EntityHandle entity) const;
+            void Clear(void);
+
+            // Entities whose bounding sphere overlaps the sphere (tested on x/z; y is ignored)
+            // Only entities whose layer is in layer_mask are reported
+            void QueryRadius(glm::vec3 center, float radius, std::vector<EntityHandle>& result, uint32_t layer_mask = 0xFFFFFFFF) const;
+            // Entities whose bounding sphere overlaps the box
+            void QueryAABB(glm::vec3 min_corner, glm::vec3 max_corner, std::vector<EntityHandle>& result, uint32_t layer_mask = 0xFFFFFFFF) const;
+
+            int GetNumEntities(void) const { return num_entities_; }
+
+        private:
+            struct Entry {
+                EntityHandle entity;
+                glm::vec3 center;
+                float radius;
+                uint32_t layer;
+                int x0, z0, x1, z1; // Range of cells the entity is registered in
+                bool used = false;
+            };
+
+            glm::vec2 min_corner_;
+            float cell_size_;
+            int cells_x_, cells_z_;
+
+            std::vector<std::vector<uint32_t> > cell_; // Entity indices in each cell
+            std::vector<Entry> entry_; // Indexed by EntityHandle::index
+            int num_entities_;
+
+            // Entities spanning several cells are reported once per query
+            mutable std::vector<uint32_t> visited_;
+            mutable uint32_t query_;
+
+            // Cell coordinate of a world coordinate, clamped to the grid
+            int CellX(float x) const;
+            int CellZ(float z) const;
+
+            void AddToCells(uint32_t index);
+            void RemoveFromCells(uint32_t index);
+
+            // Report the entities in a range of cells that pass the overlap test
+            template <typename Test>
+            void Query(int x0, int z0, int x1, int z1, uint32_t layer_mask, Test test, std::vector<EntityHandle>& result) const;
+
+    }; // class SpatialGrid
+
+} // namespace game
+
+#endif // SPATIAL_GRID_H_
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <cmath>
+
+#include "sphere_batch.h"
+
+// AVX2 only with the USE_AVX2 build option; SSE2 is always there on x86-64
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SPHERE_BATCH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPHERE_BATCH_SSE2
+#endif
+
+namespace game {
+
+    void SphereBatch::Clear(void) {
+
+        x_.clear();
+        y_.clear();
+        z_.clear();
+        radius_.clear();
+        y_weight_.clear();
+    }
+
+
+    int SphereBatch::Add(glm::vec3 center, float radius, bool flat) {
+
+        x_.push_back(center.x);
+        y_.push_back(center.y);
+        z_.push_back(center.z);
+        radius_.push_back(radius);
+        y_weight_.push_back(flat ? 0.0f : 1.0f);
+        return x_.size() - 1;
+    }
+
+
+    void SphereBatch::OverlapsScalar(int begin, glm::vec3 center, float radius, std::vector<int>& result) const {
+
+        for (int i = begin; i < x_.size(); i++) {
+            float dx = center.x - x_[i];
+            float dy = (center.y - y_[i]) * y_weight_[i];
+            float dz = center.z - z_[i];
+            // Same order as glm::length
+            float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+            if (distance <= radius + radius_[i]) {
+                result.push_back(i);
+            }
+        }
+    }
+
+
+    void SphereBatch::Overlaps(glm::vec3 center, float radius, std::vector<int>& result) const {
+
+        int count = x_.size();
+        int i = 0;
+
+#if defined(SPHERE_BATCH_AVX2)
+        __m256 px = _mm256_set1_ps(center.x);
+        __m256 py = _mm256_set1_ps(center.y);
+        __m256 pz = _mm256_set1_ps(center.z);
+        __m256 pr = _mm256_set1_ps(radius);
+        for (; i + 8 <= count; i += 8) {
+            __m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(&x_[i]));
+            __m256 dy = _mm256_mul_ps(_mm256_sub_ps(py, _mm256_loadu_ps(&y_[i])), _mm256_loadu_ps(&y_weight_[i]));
+            __m256 dz = _mm256_sub_ps(pz, _mm256_loadu_ps(&z_[i]));
+            // Separate multiplies and adds (no FMA) to round like the scalar code
+            __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            __m256 reach = _mm256_add_ps(pr, _mm256_loadu_ps(&radius_[i]));
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_sqrt_ps(d2), reach, _CMP_LE_OQ));
+            for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+                if (mask & 1) {
+                    result.push_back(i + lane);
+                }
+            }
+        }
+#elif defined(SPHERE_BATCH_SSE2)
+        __m128 px = _mm_set1_ps(center.x);
+        __m128 py = _mm_set1_ps(center.y);
+        __m128 pz = _mm_set1_ps(center.z);
+        __m128 pr = _mm_set1_ps(radius);
+        for (; i + 4 <= count; i += 4) {
+            __m128 dx = _mm_sub_ps(px, _mm_loadu_ps(&x_[i]));
+            __m128 dy = _mm_mul_ps(_mm_sub_ps(py, _mm_loadu_ps(&y_[i])), _mm_loadu_ps(&y_weight_[i]));
+            __m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(&z_[i]));
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 reach = _mm_add_ps(pr, _mm_loadu_ps(&radius_[i]));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_sqrt_ps(d2), reach));
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) {
+                    result.push_back(i + lane);
+                }
+            }
+        }
+#endif
+
+        OverlapsScalar(i, center, radius, result);
+    }
+
+
+    // One sphere of a sweep. The end contact is the Overlaps test; the entry time solves
+    // |m + t * d| = reach for the first t (ray against the grown sphere)
+    static inline void SweepOne(int i, glm::vec3 start, glm::vec3 end, glm::vec3 movement, float radius,
+        float x, float y, float z, float sphere_radius, float y_weight, std::vector<SphereBatch::SweepHit>& result) {
+
+        float ex = end.x - x;
+        float ey = (end.y - y) * y_weight;
+        float ez = end.z - z;
+        float reach = radius + sphere_radius;
+        bool at_end = std::sqrt(ex * ex + ey * ey + ez * ez) <= reach;
+
+        float mx = start.x - x;
+        float my = (start.y - y) * y_weight;
+        float mz = start.z - z;
+        float dy = movement.y * y_weight;
+        float a = movement.x * movement.x + dy * dy + movement.z * movement.z;
+        float b = mx * movement.x + my * dy + mz * movement.z;
+        float c = (mx * mx + my * my + mz * mz) - reach * reach;
+
+        if (c <= 0.0f) {
+            // Touching at the start only counts if the mover is still there at the end
+            if (at_end) {
+                result.push_back(SphereBatch::SweepHit{ i, 0.0f });
+            }
+            return;
+        }
+        float discriminant = b * b - a * c;
+        if (a > 0.0f && b < 0.0f && discriminant >= 0.0f) {
+            float t = (-b - std::sqrt(discriminant)) / a;
+            if (t <= 1.0f) {
+                result.push_back(SphereBatch::SweepHit{ i, t });
+                return;
+            }
+        }
+        if (at_end) {
+            // Only rounding can get here; report it at the end of the movement
+            result.push_back(SphereBatch::SweepHit{ i, 1.0f });
+        }
+    }
+
+
+    void SphereBatch::SweepScalar(int begin, glm::vec3 start, glm::vec3 end, float radius, std::vector<SweepHit>& result) const {
+
+        glm::vec3 movement = end - start;
+        for (int i = begin; i < x_.size(); i++) {
+            SweepOne(i, start, end, movement, radius, x_[i], y_[i], z_[i], radius_[i], y_weight_[i], result);
+        }
+    }
+
+
+    void SphereBatch::Sweep(glm::vec3 start, glm::vec3 end, float radius, std::vector<SweepHit>& result) const {
+
+        size_t first = result.size();
+        glm::vec3 movement = end - start;
+        int count = x_.size();
+        int i = 0;
+
+        // Same steps as SweepOne, a batch of spheres at a time: the lanes of a hit at the start,
+        // while moving or only at the end are picked with masks and t is blended from them
+#if defined(SPHERE_BATCH_AVX2)
+        __m256 sx = _mm256_set1_ps(start.x);
+        __m256 sy = _mm256_set1_ps(start.y);
+        __m256 sz = _mm256_set1_ps(start.z);
+        __m256 ex = _mm256_set1_ps(end.x);
+        __m256 ey = _mm256_set1_ps(end.y);
+        __m256 ez = _mm256_set1_ps(end.z);
+        __m256 mvx = _mm256_set1_ps(movement.x);
+        __m256 mvy = _mm256_set1_ps(movement.y);
+        __m256 mvz = _mm256_set1_ps(movement.z);
+        __m256 pr = _mm256_set1_ps(radius);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one = _mm256_set1_ps(1.0f);
+        for (; i + 8 <= count; i += 8) {
+            __m256 x = _mm256_loadu_ps(&x_[i]);
+            __m256 y = _mm256_loadu_ps(&y_[i]);
+            __m256 z = _mm256_loadu_ps(&z_[i]);
+            __m256 w = _mm256_loadu_ps(&y_weight_[i]);
+            __m256 reach = _mm256_add_ps(pr, _mm256_loadu_ps(&radius_[i]));
+
+            // At the end, as in Overlaps
+            __m256 dx = _mm256_sub_ps(ex, x);
+            __m256 dy = _mm256_mul_ps(_mm256_sub_ps(ey, y), w);
+            __m256 dz = _mm256_sub_ps(ez, z);
+            __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            __m256 at_end = _mm256_cmp_ps(_mm256_sqrt_ps(d2), reach, _CMP_LE_OQ);
+
+            __m256 mx = _mm256_sub_ps(sx, x);
+            __m256 my = _mm256_mul_ps(_mm256_sub_ps(sy, y), w);
+            __m256 mz = _mm256_sub_ps(sz, z);
+            __m256 vy = _mm256_mul_ps(mvy, w);
+            __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mvx, mvx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(mvz, mvz));
+            __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mx, mvx), _mm256_mul_ps(my, vy)), _mm256_mul_ps(mz, mvz));
+            __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mx, mx), _mm256_mul_ps(my, my)), _mm256_mul_ps(mz, mz)), _mm256_mul_ps(reach, reach));
+            __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+            // Lanes without a root divide anyway; their t is never used
+            __m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero))), a);
+
+            __m256 at_start = _mm256_cmp_ps(c, zero, _CMP_LE_OQ);
+            __m256 entering = _mm256_andnot_ps(at_start, _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ), _mm256_cmp_ps(b, zero, _CMP_LT_OQ)),
+                _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, one, _CMP_LE_OQ))));
+            // Reported if entering or touching at the end (a lane touching at the start never
+            // enters, so it needs the end contact); t is 0 at the start, 1 for the end only
+            t = _mm256_blendv_ps(_mm256_blendv_ps(one, t, entering), zero, at_start);
+            int mask = _mm256_movemask_ps(_mm256_or_ps(entering, at_end));
+            if (mask != 0) {
+                float lane_t[8];
+                _mm256_storeu_ps(lane_t, t);
+                for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+                    if (mask & 1) {
+                        result.push_back(SweepHit{ i + lane, lane_t[lane] });
+                    }
+                }
+            }
+        }
+#elif defined(SPHERE_BATCH_SSE2)
+        __m128 sx = _mm_set1_ps(start.x);
+        __m128 sy = _mm_set1_ps(start.y);
+        __m128 sz = _mm_set1_ps(start.z);
+        __m128 ex = _mm_set1_ps(end.x);
+        __m128 ey = _mm_set1_ps(end.y);
+        __m128 ez = _mm_set1_ps(end.z);
+        __m128 mvx = _mm_set1_ps(movement.x);
+        __m128 mvy = _mm_set1_ps(movement.y);
+        __m128 mvz = _mm_set1_ps(movement.z);
+        __m128 pr = _mm_set1_ps(radius);
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(&x_[i]);
+            __m128 y = _mm_loadu_ps(&y_[i]);
+            __m128 z = _mm_loadu_ps(&z_[i]);
+            __m128 w = _mm_loadu_ps(&y_weight_[i]);
+            __m128 reach = _mm_add_ps(pr, _mm_loadu_ps(&radius_[i]));
+
+            __m128 dx = _mm_sub_ps(ex, x);
+            __m128 dy = _mm_mul_ps(_mm_sub_ps(ey, y), w);
+            __m128 dz = _mm_sub_ps(ez, z);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 at_end = _mm_cmple_ps(_mm_sqrt_ps(d2), reach);
+
+            __m128 mx = _mm_sub_ps(sx, x);
+            __m128 my = _mm_mul_ps(_mm_sub_ps(sy, y), w);
+            __m128 mz = _mm_sub_ps(sz, z);
+            __m128 vy = _mm_mul_ps(mvy, w);
+            __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mvx, mvx), _mm_mul_ps(vy, vy)), _mm_mul_ps(mvz, mvz));
+            __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, mvx), _mm_mul_ps(my, vy)), _mm_mul_ps(mz, mvz));
+            __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), _mm_mul_ps(mz, mz)), _mm_mul_ps(reach, reach));
+            __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+            __m128 t = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(_mm_max_ps(discriminant, zero))), a);
+
+            __m128 at_start = _mm_cmple_ps(c, zero);
+            __m128 entering = _mm_andnot_ps(at_start, _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(a, zero), _mm_cmplt_ps(b, zero)),
+                _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_cmple_ps(t, one))));
+            // No blend in SSE2: select with and/andnot/or
+            t = _mm_or_ps(_mm_and_ps(entering, t), _mm_andnot_ps(entering, one));
+            t = _mm_andnot_ps(at_start, t);
+            int mask = _mm_movemask_ps(_mm_or_ps(entering, at_end));
+            if (mask != 0) {
+                float lane_t[4];
+                _mm_storeu_ps(lane_t, t);
+                for (int lane = 0; lane < 4; lane++) {
+                    if (mask & (1 << lane)) {
+                        result.push_back(SweepHit{ i + lane, lane_t[lane] });
+                    }
+                }
+            }
+        }
+#endif
+
+        SweepScalar(i, start, end, radius, result);
+
+        // Few hits, in index order; earliest first
+        std::stable_sort(result.begin() + first, result.end(), [](const SweepHit& a, const SweepHit& b) { return a.t < b.t; });
+    }
+
+} // namespace game
@@ -0,0 +1,175 @@
+#include <chrono>
+#include <stdexcept>
+
+#include "task_graph.h"
+
+namespace game {
+
+    TaskGraph::TaskGraph(void) {
+
+        checked_ = true;
+        remaining_ = 0;
+        failed_ = false;
+    }
+
+
+    TaskGraph::TaskId TaskGraph::AddTask(const std::string& name, std::function<void()> run, bool main_thread) {
+
+        std::unique_ptr<Task> task(new Task());
+        task->name = name;
+        task->run = std::move(run);
+        task->main_thread = main_thread;
+        task->num_dependencies = 0;
+        task->waiting = 0;
+        task->time = 0.0;
+        task_.push_back(std::move(task));
+        return task_.size() - 1;
+    }
+
+
+    void TaskGraph::AddDependency(TaskId before, TaskId after) {
+
+        if (before < 0 || before >= task_.size() || after < 0 || after >= task_.size() || before == after) {
+            throw(std::invalid_argument(std::string("Invalid task dependency")));
+        }
+        task_[before]->successor.push_back(after);
+        task_[after]->num_dependencies++;
+        checked_ = false;
+    }
+
+
+    void TaskGraph::Clear(void) {
+
+        task_.clear();
+        checked_ = true;
+    }
+
+
+    void TaskGraph::CheckCycles(void) {
+
+        // Kahn's algorithm: every task must become ready at some point
+        std::vector<int> waiting(task_.size());
+        std::vector<TaskId> ready;
+        for (int i = 0; i < task_.size(); i++) {
+            waiting[i] = task_[i]->num_dependencies;
+            if (waiting[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+        int visited = 0;
+        while (!ready.empty()) {
+            TaskId id = ready.back();
+            ready.pop_back();
+            visited++;
+            for (TaskId next : task_[id]->successor) {
+                if (--waiting[next] == 0) {
+                    ready.push_back(next);
+                }
+            }
+        }
+        if (visited != task_.size()) {
+            throw(std::invalid_argument(std::string("Task graph has a dependency cycle")));
+        }
+        checked_ = true;
+    }
+
+
+    void TaskGraph::Run(ThreadPool& pool) {
+
+        if (!checked_) {
+            CheckCycles();
+        }
+
+        remaining_ = task_.size();
+        failed_ = false;
+        for (int i = 0; i < task_.size(); i++) {
+            task_[i]->waiting = task_[i]->num_dependencies;
+        }
+
+        JobCounter counter;
+        for (int i = 0; i < task_.size(); i++) {
+            if (task_[i]->num_dependencies == 0) {
+                Start(i, pool, counter);
+            }
+        }
+
+        // Run the pinned tasks here and help with the others in between
+        while (remaining_.load() > 0) {
+            TaskId id = -1;
+            {
+                std::lock_guard<std::mutex> lock(main_mutex_);
+                if (!main_ready_.empty()) {
+                    id = main_ready_.back();
+                    main_ready_.pop_back();
+                }
+            }
+            if (id >= 0) {
+                Execute(id, pool, counter);
+            }
+            else {
+                pool.WaitUntil([this]() { return remaining_.load() == 0 || HasMainReady(); });
+            }
+        }
+        pool.Wait(counter);
+
+        if (failed_) {
+            std::exception_ptr error;
+            error.swap(error_);
+            std::rethrow_exception(error);
+        }
+    }
+
+
+    bool TaskGraph::HasMainReady(void) {
+
+        std::lock_guard<std::mutex> lock(main_mutex_);
+        return !main_ready_.empty();
+    }
+
+
+    void TaskGraph::Start(TaskId id, ThreadPool& pool, JobCounter& counter) {
+
+        if (task_[id]->main_thread) {
+            {
+                std::lock_guard<std::mutex> lock(main_mutex_);
+                main_ready_.push_back(id);
+            }
+            pool.WakeWaiters();
+        }
+        else {
+            pool.Submit([this, id, &pool, &counter]() { Execute(id, pool, counter); }, &counter);
+        }
+    }
+
+
+    void TaskGraph::Execute(TaskId id, ThreadPool& pool, JobCounter& counter) {
+
+        Task& task = *task_[id];
+
+        // After a failure the remaining tasks are only marked done, so that Run returns
+        auto start = std::chrono::steady_clock::now();
+        if (!failed_.load()) {
+            try {
+                task.run();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(main_mutex_);
+                if (!failed_.load()) {
+                    error_ = std::current_exception();
+                    failed_ = true;
+                }
+            }
+        }
+        task.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (TaskId next : task.successor) {
+            if (task_[next]->waiting.fetch_sub(1) == 1) {
+                Start(next, pool, counter);
+            }
+        }
+        if (remaining_.fetch_sub(1) == 1) {
+            pool.WakeWaiters();
+        }
+    }
+
+} // namespace game
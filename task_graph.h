@@ -0,0 +1,79 @@
+/*
+ *
+ * Declarative graph of the stages of a frame. Tasks are added once with the tasks they have to
+ * wait for; every Run starts the tasks whose dependencies are done as jobs on a ThreadPool, so
+ * independent stages run at the same time. Tasks that use OpenGL or other main-thread-only
+ * state are pinned to the thread that calls Run.
+ *
+ */
+#ifndef TASK_GRAPH_H_
+#define TASK_GRAPH_H_
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace game {
+
+    class TaskGraph {
+
+        public:
+            typedef int TaskId;
+
+            TaskGraph(void);
+
+            // Add a stage; main_thread pins it to the thread calling Run
+            TaskId AddTask(const std::string& name, std::function<void()> run, bool main_thread = false);
+            // The task after starts only when the task before is done
+            void AddDependency(TaskId before, TaskId after);
+            // Remove all tasks
+            void Clear(void);
+
+            // Run every task once, following the dependencies, and return when all are done. If
+            // a task throws, the tasks that have not started are skipped and the exception is
+            // rethrown here
+            void Run(ThreadPool& pool);
+
+            int GetNumTasks(void) const { return task_.size(); }
+            const std::string& GetTaskName(TaskId id) const { return task_[id]->name; }
+            // Time the task took in the last Run, in seconds
+            double GetTaskTime(TaskId id) const { return task_[id]->time; }
+
+        private:
+            struct Task {
+                std::string name;
+                std::function<void()> run;
+                bool main_thread;
+                std::vector<TaskId> successor;
+                int num_dependencies;
+                std::atomic<int> waiting; // Dependencies not done in this run
+                double time;
+            };
+
+            std::vector<std::unique_ptr<Task>> task_;
+            bool checked_; // Cycle check done since the last change
+
+            // Main-thread tasks whose dependencies are done
+            std::mutex main_mutex_;
+            std::vector<TaskId> main_ready_;
+            std::atomic<int> remaining_; // Tasks not done in this run
+            std::atomic<bool> failed_; // A task of this run threw
+            std::exception_ptr error_; // Its exception (under main_mutex_)
+
+            void Start(TaskId id, ThreadPool& pool, JobCounter& counter);
+            bool HasMainReady(void);
+            void Execute(TaskId id, ThreadPool& pool, JobCounter& counter);
+            // Throws std::invalid_argument if the dependencies form a cycle
+            void CheckCycles(void);
+
+    }; // class TaskGraph
+
+} // namespace game
+
+#endif // TASK_GRAPH_H_
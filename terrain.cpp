@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "terrain.h"
+
+// SSE2 is always there on x86-64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TERRAIN_SSE2
+#endif
+
+namespace game {
+
+    Terrain::Terrain(void) {
+
+        width_ = 0;
+        depth_ = 0;
+        origin_ = glm::vec2(0.0f);
+    }
+
+
+    void Terrain::Init(std::vector<float> height, int width, int depth, glm::vec2 origin) {
+
+        if (width < 2 || depth < 2 || height.size() != (size_t)width * depth) {
+            throw(std::invalid_argument(std::string("Invalid terrain size")));
+        }
+        height_ = std::move(height);
+        base_height_.clear();
+        width_ = width;
+        depth_ = depth;
+        origin_ = origin;
+
+        // Steepest edge of every cell
+        slope_.resize((width_ - 1) * (depth_ - 1));
+        for (int z = 0; z < depth_ - 1; z++) {
+            for (int x = 0; x < width_ - 1; x++) {
+                // A B
+                // C D
+                float a = height_[x + width_ * z];
+                float b = height_[x + 1 + width_ * z];
+                float c = height_[x + width_ * (z + 1)];
+                float d = height_[x + 1 + width_ * (z + 1)];
+                slope_[x + (width_ - 1) * z] = std::max(std::max(std::abs(b - a), std::abs(d - b)), std::max(std::abs(d - c), std::abs(c - a)));
+            }
+        }
+
+        BuildQuadtree();
+    }
+
+
+    void Terrain::BuildQuadtree(void) {
+
+        level_.clear();
+
+        Level cells;
+        cells.width = width_ - 1;
+        cells.depth = depth_ - 1;
+        cells.range.resize(cells.width * cells.depth);
+        for (int z = 0; z < cells.depth; z++) {
+            for (int x = 0; x < cells.width; x++) {
+                float a = height_[x + width_ * z];
+                float b = height_[x + 1 + width_ * z];
+                float c = height_[x + width_ * (z + 1)];
+                float d = height_[x + 1 + width_ * (z + 1)];
+                cells.range[x + cells.width * z] = glm::vec2(std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d)));
+            }
+        }
+        level_.push_back(cells);
+
+        while (level_.back().width > 1 || level_.back().depth > 1) {
+            const Level& below = level_.back();
+            Level above;
+            above.width = (below.width + 1) / 2;
+            above.depth = (below.depth + 1) / 2;
+            above.range.assign(above.width * above.depth, glm::vec2(INFINITY, -INFINITY));
+            for (int z = 0; z < below.depth; z++) {
+                for (int x = 0; x < below.width; x++) {
+                    glm::vec2& range = above.range[x / 2 + above.width * (z / 2)];
+                    const glm::vec2& child = below.range[x + below.width * z];
+                    range.x = std::min(range.x, child.x);
+                    range.y = std::max(range.y, child.y);
+                }
+            }
+            level_.push_back(above);
+        }
+    }
+
+
+    void Terrain::UpdateCells(int x0, int z0, int x1, int z1) {
+
+        // A sample is a corner of the cells to its left and above
+        int cx0 = std::max(x0 - 1, 0), cx1 = std::min(x1, width_ - 1);
+        int cz0 = std::max(z0 - 1, 0), cz1 = std::min(z1, depth_ - 1);
+        if (cx0 >= cx1 || cz0 >= cz1) {
+            return;
+        }
+
+        Level& cells = level_[0];
+        for (int z = cz0; z < cz1; z++) {
+            for (int x = cx0; x < cx1; x++) {
+                float a = height_[x + width_ * z];
+                float b = height_[x + 1 + width_ * z];
+                float c = height_[x + width_ * (z + 1)];
+                float d = height_[x + 1 + width_ * (z + 1)];
+                slope_[x + (width_ - 1) * z] = std::max(std::max(std::abs(b - a), std::abs(d - b)), std::max(std::abs(d - c), std::abs(c - a)));
+                cells.range[x + cells.width * z] = glm::vec2(std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d)));
+            }
+        }
+
+        // Then the nodes above them, level by level
+        for (int l = 1; l < level_.size(); l++) {
+            const Level& below = level_[l - 1];
+            Level& above = level_[l];
+            cx0 /= 2;
+            cz0 /= 2;
+            cx1 = (cx1 + 1) / 2;
+            cz1 = (cz1 + 1) / 2;
+            for (int z = cz0; z < cz1; z++) {
+                for (int x = cx0; x < cx1; x++) {
+                    glm::vec2 range(INFINITY, -INFINITY);
+                    for (int bz = 2 * z; bz < std::min(2 * z + 2, below.depth); bz++) {
+                        for (int bx = 2 * x; bx < std::min(2 * x + 2, below.width); bx++) {
+                            const glm::vec2& child = below.range[bx + below.width * bz];
+                            range.x = std::min(range.x, child.x);
+                            range.y = std::max(range.y, child.y);
+                        }
+                    }
+                    above.range[x + above.width * z] = range;
+                }
+            }
+        }
+    }
+
+
+    void Terrain::RaiseHeights(int x0, int z0, int size_x, int size_z, const float* height, int stride) {
+
+        if (base_height_.empty()) {
+            base_height_ = height_;
+        }
+        int x1 = std::min(x0 + size_x, width_), z1 = std::min(z0 + size_z, depth_);
+        for (int z = std::max(z0, 0); z < z1; z++) {
+            for (int x = std::max(x0, 0); x < x1; x++) {
+                float& sample = height_[x + width_ * z];
+                sample = std::max(sample, height[(x - x0) + stride * (z - z0)]);
+            }
+        }
+        UpdateCells(std::max(x0, 0), std::max(z0, 0), x1, z1);
+    }
+
+
+    void Terrain::RestoreHeights(int x0, int z0, int size_x, int size_z) {
+
+        if (base_height_.empty()) {
+            return;
+        }
+        int x1 = std::min(x0 + size_x, width_), z1 = std::min(z0 + size_z, depth_);
+        for (int z = std::max(z0, 0); z < z1; z++) {
+            for (int x = std::max(x0, 0); x < x1; x++) {
+                height_[x + width_ * z] = base_height_[x + width_ * z];
+            }
+        }
+        UpdateCells(std::max(x0, 0), std::max(z0, 0), x1, z1);
+    }
+
+
+    float Terrain::GetSample(int x, int z) const {
+
+        x = std::min(std::max(x, 0), width_ - 1);
+        z = std::min(std::max(z, 0), depth_ - 1);
+        return height_[x + width_ * z];
+    }
+
+
+    float Terrain::GetHeight(float x, float z) const {
+
+        if (IsEmpty()) {
+            return 0.0f;
+        }
+        float fx = std::min(std::max(x - origin_.x, 0.0f), (float)(width_ - 1));
+        float fz = std::min(std::max(z - origin_.y, 0.0f), (float)(depth_ - 1));
+        int ix = std::min((int)fx, width_ - 2);
+        int iz = std::min((int)fz, depth_ - 2);
+        float s = fx - ix;
+        float t = fz - iz;
+
+        const float* row = &height_[ix + width_ * iz];
+        float a = row[0];
+        float b = row[1];
+        float c = row[width_];
+        float d = row[width_ + 1];
+        return (1 - t) * ((1 - s) * a + s * b) + t * ((1 - s) * c + s * d);
+    }
+
+
+    glm::vec3 Terrain::GetNormal(float x, float z) const {
+
+        if (IsEmpty()) {
+            return glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        float fx = std::min(std::max(x - origin_.x, 0.0f), (float)(width_ - 1));
+        float fz = std::min(std::max(z - origin_.y, 0.0f), (float)(depth_ - 1));
+        int ix = std::min((int)fx, width_ - 2);
+        int iz = std::min((int)fz, depth_ - 2);
+        float s = fx - ix;
+        float t = fz - iz;
+
+        const float* row = &height_[ix + width_ * iz];
+        float a = row[0];
+        float b = row[1];
+        float c = row[width_];
+        float d = row[width_ + 1];
+        // Derivatives of the bilinear height
+        float dx = (1 - t) * (b - a) + t * (d - c);
+        float dz = (1 - s) * (c - a) + s * (d - b);
+        return glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+    }
+
+
+    void Terrain::GetHeights(const float* x, const float* z, float* height, int count) const {
+
+        int i = 0;
+
+#if defined(TERRAIN_SSE2)
+        if (!IsEmpty()) {
+            __m128 origin_x = _mm_set1_ps(origin_.x);
+            __m128 origin_z = _mm_set1_ps(origin_.y);
+            __m128 max_x = _mm_set1_ps((float)(width_ - 1));
+            __m128 max_z = _mm_set1_ps((float)(depth_ - 1));
+            __m128i last_x = _mm_set1_epi32(width_ - 2);
+            __m128i last_z = _mm_set1_epi32(depth_ - 2);
+            __m128 one = _mm_set1_ps(1.0f);
+            for (; i + 4 <= count; i += 4) {
+                __m128 fx = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(x + i), origin_x), _mm_setzero_ps()), max_x);
+                __m128 fz = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(z + i), origin_z), _mm_setzero_ps()), max_z);
+                // Truncation is floor for the clamped (non-negative) coordinates; SSE2 has no
+                // integer min, so the last row/column is handled with a compare
+                __m128i ix = _mm_cvttps_epi32(fx);
+                __m128i iz = _mm_cvttps_epi32(fz);
+                __m128i over_x = _mm_cmpgt_epi32(ix, last_x);
+                __m128i over_z = _mm_cmpgt_epi32(iz, last_z);
+                ix = _mm_or_si128(_mm_and_si128(over_x, last_x), _mm_andnot_si128(over_x, ix));
+                iz = _mm_or_si128(_mm_and_si128(over_z, last_z), _mm_andnot_si128(over_z, iz));
+                __m128 s = _mm_sub_ps(fx, _mm_cvtepi32_ps(ix));
+                __m128 t = _mm_sub_ps(fz, _mm_cvtepi32_ps(iz));
+
+                // No gather in SSE2: fetch the corners one lane at a time
+                alignas(16) int cx[4], cz[4];
+                _mm_store_si128((__m128i*)cx, ix);
+                _mm_store_si128((__m128i*)cz, iz);
+                alignas(16) float a[4], b[4], c[4], d[4];
+                for (int lane = 0; lane < 4; lane++) {
+                    const float* row = &height_[cx[lane] + width_ * cz[lane]];
+                    a[lane] = row[0];
+                    b[lane] = row[1];
+                    c[lane] = row[width_];
+                    d[lane] = row[width_ + 1];
+                }
+
+                // Same expression as GetHeight
+                __m128 one_s = _mm_sub_ps(one, s);
+                __m128 one_t = _mm_sub_ps(one, t);
+                __m128 top = _mm_add_ps(_mm_mul_ps(one_s, _mm_load_ps(a)), _mm_mul_ps(s, _mm_load_ps(b)));
+                __m128 bottom = _mm_add_ps(_mm_mul_ps(one_s, _mm_load_ps(c)), _mm_mul_ps(s, _mm_load_ps(d)));
+                _mm_storeu_ps(height + i, _mm_add_ps(_mm_mul_ps(one_t, top), _mm_mul_ps(t, bottom)));
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            height[i] = GetHeight(x[i], z[i]);
+        }
+    }
+
+
+    float Terrain::GetCellSlope(int x, int z) const {
+
+        if (x < 0 || z < 0 || x >= width_ - 1 || z >= depth_ - 1) {
+            return INFINITY;
+        }
+        return slope_[x + (width_ - 1) * z];
+    }
+
+
+    void Terrain::GetNodeBounds(int level, int x, int z, glm::vec3& min_corner, glm::vec3& max_corner) const {
+
+        const glm::vec2& range = level_[level].range[x + level_[level].width * z];
+        int cells = 1 << level;
+        min_corner = glm::vec3(origin_.x + x * cells, range.x, origin_.y + z * cells);
+        max_corner = glm::vec3(origin_.x + std::min((x + 1) * cells, width_ - 1), range.y, origin_.y + std::min((z + 1) * cells, depth_ - 1));
+    }
+
+
+    void Terrain::GetCellTriangles(int x, int z, glm::vec3 triangle[2][3]) const {
+
+        // Same split as the plane mesh: the diagonal runs from (x, z + 1) to (x + 1, z)
+        float x0 = origin_.x + x;
+        float z0 = origin_.y + z;
+        glm::vec3 a(x0, height_[x + width_ * z], z0);
+        glm::vec3 b(x0 + 1.0f, height_[x + 1 + width_ * z], z0);
+        glm::vec3 c(x0, height_[x + width_ * (z + 1)], z0 + 1.0f);
+        glm::vec3 d(x0 + 1.0f, height_[x + 1 + width_ * (z + 1)], z0 + 1.0f);
+        triangle[0][0] = c;
+        triangle[0][1] = b;
+        triangle[0][2] = a;
+        triangle[1][0] = c;
+        triangle[1][1] = d;
+        triangle[1][2] = b;
+    }
+
+
+    // Entry distance of a ray into a box, or INFINITY if it misses (within max_distance)
+    static float RayBox(glm::vec3 origin, glm::vec3 inverse_direction, float max_distance, glm::vec3 min_corner, glm::vec3 max_corner) {
+
+        glm::vec3 t0 = (min_corner - origin) * inverse_direction;
+        glm::vec3 t1 = (max_corner - origin) * inverse_direction;
+        glm::vec3 near_t = glm::min(t0, t1);
+        glm::vec3 far_t = glm::max(t0, t1);
+        float enter = std::max(std::max(near_t.x, near_t.y), std::max(near_t.z, 0.0f));
+        float exit = std::min(std::min(far_t.x, far_t.y), std::min(far_t.z, max_distance));
+        return (enter <= exit) ? enter : INFINITY;
+    }
+
+
+    // Möller–Trumbore; both faces count
+    static bool RayTriangle(glm::vec3 origin, glm::vec3 direction, const glm::vec3* v, float& t) {
+
+        glm::vec3 e1 = v[1] - v[0];
+        glm::vec3 e2 = v[2] - v[0];
+        glm::vec3 p = glm::cross(direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-8f) {
+            return false;
+        }
+        float inv_det = 1.0f / det;
+        glm::vec3 s = origin - v[0];
+        float u = glm::dot(s, p) * inv_det;
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+        glm::vec3 q = glm::cross(s, e1);
+        float w = glm::dot(direction, q) * inv_det;
+        if (w < 0.0f || u + w > 1.0f) {
+            return false;
+        }
+        t = glm::dot(e2, q) * inv_det;
+        return t >= 0.0f;
+    }
+
+
+    bool Terrain::RayCast(glm::vec3 origin, glm::vec3 direction, float max_distance, float& distance) const {
+
+        if (IsEmpty()) {
+            return false;
+        }
+        // A large finite reciprocal for zero components: with infinity a ray starting on a slab
+        // plane gives 0 * inf = NaN, which the min and max in RayBox keep or drop by argument order
+        glm::vec3 inverse_direction;
+        for (int a = 0; a < 3; a++) {
+            inverse_direction[a] = (direction[a] != 0.0f) ? 1.0f / direction[a] : 1e30f;
+        }
+        float best = max_distance;
+        bool hit = false;
+
+        // Depth-first from the root, skipping nodes the ray misses or enters after the best hit
+        struct Entry {
+            int level, x, z;
+        };
+        Entry stack[64 * 4];
+        int size = 0;
+        stack[size++] = Entry{ (int)level_.size() - 1, 0, 0 };
+        while (size > 0) {
+            Entry node = stack[--size];
+            glm::vec3 min_corner, max_corner;
+            GetNodeBounds(node.level, node.x, node.z, min_corner, max_corner);
+            if (RayBox(origin, inverse_direction, best, min_corner, max_corner) > best) {
+                continue;
+            }
+
+            if (node.level == 0) {
+                glm::vec3 triangle[2][3];
+                GetCellTriangles(node.x, node.z, triangle);
+                for (int k = 0; k < 2; k++) {
+                    float t;
+                    if (RayTriangle(origin, direction, triangle[k], t) && t <= best) {
+                        best = t;
+                        hit = true;
+                    }
+                }
+                continue;
+            }
+
+            // Children, farthest pushed first so the nearest is visited first
+            const Level& below = level_[node.level - 1];
+            Entry child[4];
+            float enter[4];
+            int num_children = 0;
+            for (int dz = 0; dz < 2; dz++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int cx = node.x * 2 + dx;
+                    int cz = node.z * 2 + dz;
+                    if (cx >= below.width || cz >= below.depth) {
+                        continue;
+                    }
+                    glm::vec3 child_min, child_max;
+                    GetNodeBounds(node.level - 1, cx, cz, child_min, child_max);
+                    float t = RayBox(origin, inverse_direction, best, child_min, child_max);
+                    if (t <= best) {
+                        child[num_children] = Entry{ node.level - 1, cx, cz };
+                        enter[num_children] = t;
+                        num_children++;
+                    }
+                }
+            }
+            for (int a = 0; a < num_children; a++) {
+                for (int b = a + 1; b < num_children; b++) {
+                    if (enter[b] > enter[a]) {
+                        std::swap(enter[a], enter[b]);
+                        std::swap(child[a], child[b]);
+                    }
+                }
+            }
+            for (int c = 0; c < num_children; c++) {
+                stack[size++] = child[c];
+            }
+        }
+
+        if (hit) {
+            distance = best;
+        }
+        return hit;
+    }
+
+
+    bool Terrain::SegmentCast(glm::vec3 start, glm::vec3 end, float& t) const {
+
+        glm::vec3 segment = end - start;
+        float length = glm::length(segment);
+        if (length <= 0.0f) {
+            return false;
+        }
+        float distance;
+        if (!RayCast(start, segment / length, length, distance)) {
+            return false;
+        }
+        t = distance / length;
+        return true;
+    }
+
+
+    // Closest point of a triangle to p (Ericson, Real-Time Collision Detection 5.1.5)
+    static glm::vec3 ClosestPointOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+
+        glm::vec3 ab = b - a;
+        glm::vec3 ac = c - a;
+        glm::vec3 ap = p - a;
+        float d1 = glm::dot(ab, ap);
+        float d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) {
+            return a;
+        }
+
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp);
+        float d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) {
+            return b;
+        }
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            return a + ab * (d1 / (d1 - d3));
+        }
+
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp);
+        float d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) {
+            return c;
+        }
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            return a + ac * (d2 / (d2 - d6));
+        }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+
+        float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+
+
+    bool Terrain::IntersectsSphere(glm::vec3 center, float radius) const {
+
+        if (IsEmpty()) {
+            return false;
+        }
+        // Below the field counts as touching it
+        glm::vec2 grid = glm::vec2(center.x, center.z) - origin_;
+        if (grid.x >= 0.0f && grid.y >= 0.0f && grid.x <= width_ - 1 && grid.y <= depth_ - 1 && center.y <= GetHeight(center.x, center.z)) {
+            return true;
+        }
+
+        int stack[64 * 4][3];
+        int size = 0;
+        stack[size][0] = level_.size() - 1;
+        stack[size][1] = 0;
+        stack[size][2] = 0;
+        size++;
+        while (size > 0) {
+            size--;
+            int level = stack[size][0];
+            int x = stack[size][1];
+            int z = stack[size][2];
+
+            // Closest point of the node's box to the center
+            glm::vec3 min_corner, max_corner;
+            GetNodeBounds(level, x, z, min_corner, max_corner);
+            glm::vec3 closest = glm::clamp(center, min_corner, max_corner);
+            glm::vec3 d = center - closest;
+            if (glm::dot(d, d) > radius * radius) {
+                continue;
+            }
+
+            if (level == 0) {
+                glm::vec3 triangle[2][3];
+                GetCellTriangles(x, z, triangle);
+                for (int k = 0; k < 2; k++) {
+                    glm::vec3 p = ClosestPointOnTriangle(center, triangle[k][0], triangle[k][1], triangle[k][2]);
+                    glm::vec3 offset = center - p;
+                    if (glm::dot(offset, offset) <= radius * radius) {
+                        return true;
+                    }
+                }
+                continue;
+            }
+
+            const Level& below = level_[level - 1];
+            for (int dz = 0; dz < 2; dz++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int cx = x * 2 + dx;
+                    int cz = z * 2 + dz;
+                    if (cx < below.width && cz < below.depth) {
+                        stack[size][0] = level - 1;
+                        stack[size][1] = cx;
+                        stack[size][2] = cz;
+                        size++;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+} // namespace game
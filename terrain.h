@@ -0,0 +1,87 @@
+/*
+ *
+ * The walkable height field of the sea floor, shared by everything that needs the ground:
+ * the camera follows it, objects can be placed on it and collision queries test against it.
+ * Samples are 1 unit apart; every cell is split into the same two triangles as the terrain grid
+ * (ResourceManager::CreateTerrainGrid). A min/max quadtree over the cells lets ray, segment and
+ * sphere queries skip every part of the field that is entirely above or below them.
+ *
+ */
+#ifndef TERRAIN_H_
+#define TERRAIN_H_
+
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace game {
+
+    class Terrain {
+
+        public:
+            Terrain(void);
+
+            // Take over a field of width x depth samples (row by row along z); sample (0, 0)
+            // is at origin (x, z)
+            void Init(std::vector<float> height, int width, int depth, glm::vec2 origin);
+            bool IsEmpty(void) const { return height_.empty(); }
+
+            int GetWidth(void) const { return width_; }
+            int GetDepth(void) const { return depth_; }
+            glm::vec2 GetOrigin(void) const { return origin_; }
+            // Sample at grid coordinates, clamped to the field
+            float GetSample(int x, int z) const;
+
+            // Bilinear height at a world position (clamped to the edges of the field)
+            float GetHeight(float x, float z) const;
+            // Surface normal of the bilinear height at a world position
+            glm::vec3 GetNormal(float x, float z) const;
+            // Heights of count positions at once (4 at a time with SSE2)
+            void GetHeights(const float* x, const float* z, float* height, int count) const;
+            // Largest height difference along the edges of cell (x, z); cells outside the field
+            // are infinitely steep
+            float GetCellSlope(int x, int z) const;
+
+            // Nearest hit of a ray (direction normalized) within max_distance
+            bool RayCast(glm::vec3 origin, glm::vec3 direction, float max_distance, float& distance) const;
+            // First hit between start and end; t is the fraction of the way to end
+            bool SegmentCast(glm::vec3 start, glm::vec3 end, float& t) const;
+            // True if the sphere touches or is below the surface of a triangle
+            bool IntersectsSphere(glm::vec3 center, float radius) const;
+
+            // Raise the samples of a rectangle (corner x0, z0 in samples, size_x x size_z read
+            // row by row with the given stride) to at least the given heights, as for a streamed
+            // height tile; the parts outside the field are ignored. RestoreHeights puts back the
+            // heights given to Init. Neither may run during a query
+            void RaiseHeights(int x0, int z0, int size_x, int size_z, const float* height, int stride);
+            void RestoreHeights(int x0, int z0, int size_x, int size_z);
+
+        private:
+            std::vector<float> height_;
+            std::vector<float> base_height_; // Heights given to Init, once some were raised
+            std::vector<float> slope_; // Per cell, (width - 1) x (depth - 1)
+            int width_;
+            int depth_;
+            glm::vec2 origin_;
+
+            // Min/max quadtree: level 0 holds the height range of every cell, each level above
+            // covers 2x2 nodes of the one below, the last level is the single root
+            struct Level {
+                int width, depth;
+                std::vector<glm::vec2> range; // (min, max)
+            };
+            std::vector<Level> level_;
+
+            void BuildQuadtree(void);
+            // Slopes and quadtree ranges of the cells touching the samples [x0, x1) x [z0, z1)
+            void UpdateCells(int x0, int z0, int x1, int z1);
+            // World-space box of a quadtree node
+            void GetNodeBounds(int level, int x, int z, glm::vec3& min_corner, glm::vec3& max_corner) const;
+            // Corners of the two triangles of a cell
+            void GetCellTriangles(int x, int z, glm::vec3 triangle[2][3]) const;
+
+    }; // class Terrain
+
+} // namespace game
+
+#endif // TERRAIN_H_
@@ -0,0 +1,88 @@
+#version 140
+
+// Vertex buffer: position on the patch grid, 0 to 1
+in vec2 grid;
+
+// Uniform (global) buffer
+uniform mat4 world_mat;
+uniform mat4 view_mat;
+uniform mat4 projection_mat;
+uniform mat4 normal_mat;
+uniform vec3 view_pos;
+uniform vec3 light_pos;
+
+// Height field
+uniform sampler2D height_map;
+uniform vec2 terrain_size; // samples
+uniform vec2 terrain_origin; // position of sample (0, 0)
+uniform vec4 terrain_patch; // corner (x, z) and size in samples, level
+uniform vec2 morph_range; // distances between which the patch morphs into the next level
+uniform float grid_cells;
+
+// Attributes forwarded to the fragment shader
+out vec3 vertex_position;
+out vec2 vertex_uv;
+
+out vec3 tangent_light_pos;
+out vec3 tangent_frag_pos;
+out vec3 tangent_view_pos;
+
+out vec3 light_vector;
+out vec3 view_vector;
+out vec3 normal_vector;
+
+float Height(vec2 cell)
+{
+    return texture(height_map, (cell + 0.5) / terrain_size).r;
+}
+
+void main()
+{
+    // Position on the height field (in samples)
+    vec2 cell = terrain_patch.xy + grid * terrain_patch.z;
+    vec3 world = vec3(world_mat * vec4(terrain_origin.x + cell.x, Height(min(cell, terrain_size - 1.0)), terrain_origin.y + cell.y, 1.0));
+
+    // Move odd grid vertices onto the coarser grid as the patch gets further away
+    float morph = clamp((distance(view_pos, world) - morph_range.x) / max(morph_range.y - morph_range.x, 0.0001), 0.0, 1.0);
+    vec2 odd = fract(grid * grid_cells * 0.5) * 2.0 / grid_cells;
+    cell -= odd * terrain_patch.z * morph;
+    cell = clamp(cell, vec2(0.0), terrain_size - 1.0);
+
+    float height = Height(cell);
+    vec3 vertex = vec3(terrain_origin.x + cell.x, height, terrain_origin.y + cell.y);
+
+    // Normal and tangent from central differences
+    float dx = (Height(cell + vec2(1.0, 0.0)) - Height(cell - vec2(1.0, 0.0))) * 0.5;
+    float dz = (Height(cell + vec2(0.0, 1.0)) - Height(cell - vec2(0.0, 1.0))) * 0.5;
+    vec3 normal = normalize(vec3(-dx, 1.0, -dz));
+    vec3 tangent = normalize(vec3(1.0, dx, 0.0));
+
+    gl_Position = projection_mat * view_mat * world_mat * vec4(vertex, 1.0);
+
+    vertex_position = vec3(view_mat * world_mat * vec4(vertex, 1.0));
+
+    // Define vertex tangent, bitangent and normal (TBN)
+    vec3 vertex_normal = normalize(vec3(normal_mat * view_mat * vec4(normal, 0.0)));
+    vec3 vertex_tangent_ts = normalize(vec3(normal_mat * view_mat * vec4(tangent, 0.0)));
+    vec3 vertex_bitangent_ts = cross(vertex_normal, vertex_tangent_ts);
+
+    // TBN matrix allows transition from view space to tangent space
+    mat3 TBN_mat = transpose(mat3(vertex_tangent_ts, vertex_bitangent_ts, vertex_normal));
+
+    // view-space positions
+    vec3 light_pos_v = vec3(view_mat * vec4(light_pos,1.0));
+    vec3 view_pos_v = vec3(view_mat * vec4(view_pos,1.0));
+
+    // tangent-space positions
+    tangent_light_pos = TBN_mat * light_pos_v;
+    tangent_view_pos = TBN_mat * view_pos_v;
+    tangent_frag_pos = TBN_mat * vertex_position;
+
+    // vectors for lighting calculations
+    normal_vector = TBN_mat * vertex_normal;
+    light_vector = tangent_light_pos - tangent_frag_pos;
+    view_vector = tangent_view_pos - tangent_frag_pos;
+
+    // Same texture coordinates as the plane mesh
+    vertex_uv = cell / (terrain_size - 1.0);
+}
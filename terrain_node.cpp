@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#include "terrain_node.h"
+
+namespace game {
+
+    TerrainNode::TerrainNode(const std::string name, const Resource* geometry, const Resource* material, const Resource* texture, const Resource* height_texture,
+        const std::vector<float>& height_map, int width, int depth, glm::vec2 origin) : SceneNode(name, geometry, material, texture, 0) {
+
+        if (!height_texture || height_texture->GetType() != Texture) {
+            throw(std::invalid_argument(std::string("Invalid type of height texture")));
+        }
+        // Two triangles per cell of a square grid
+        int grid_cells = (int)std::lround(std::sqrt(geometry->GetSize() / 6.0));
+        if (grid_cells < 2 || grid_cells % 2 != 0 || geometry->GetSize() != grid_cells * grid_cells * 6) {
+            throw(std::invalid_argument(std::string("Geometry is not a terrain grid")));
+        }
+        if (width < 2 || depth < 2 || height_map.size() < (size_t)width * depth) {
+            throw(std::invalid_argument(std::string("Invalid terrain size")));
+        }
+
+        height_texture_ = height_texture->GetTextureHandle();
+        grid_cells_ = grid_cells;
+        width_ = width;
+        depth_ = depth;
+        origin_ = origin;
+
+        BuildQuadtree(height_map);
+        SetDetailDistance(2.0f * grid_cells_);
+    }
+
+
+    void TerrainNode::BuildQuadtree(const std::vector<float>& height_map) {
+
+        level_.clear();
+
+        // Patches of the finest level, grid_cells_ cells a side (the last ones may be cut off)
+        Level patches;
+        patches.width = (width_ - 1 + grid_cells_ - 1) / grid_cells_;
+        patches.depth = (depth_ - 1 + grid_cells_ - 1) / grid_cells_;
+        patches.range.assign(patches.width * patches.depth, glm::vec2(INFINITY, -INFINITY));
+        for (int z = 0; z < depth_; z++) {
+            // Samples on a patch border belong to both patches
+            int first_z = std::max(z - 1, 0) / grid_cells_;
+            int last_z = std::min(z / grid_cells_, patches.depth - 1);
+            for (int x = 0; x < width_; x++) {
+                float h = height_map[x + width_ * z];
+                int first_x = std::max(x - 1, 0) / grid_cells_;
+                int last_x = std::min(x / grid_cells_, patches.width - 1);
+                for (int pz = first_z; pz <= last_z; pz++) {
+                    for (int px = first_x; px <= last_x; px++) {
+                        glm::vec2& range = patches.range[px + patches.width * pz];
+                        range.x = std::min(range.x, h);
+                        range.y = std::max(range.y, h);
+                    }
+                }
+            }
+        }
+        level_.push_back(patches);
+
+        while (level_.back().width > 1 || level_.back().depth > 1) {
+            const Level& below = level_.back();
+            Level above;
+            above.width = (below.width + 1) / 2;
+            above.depth = (below.depth + 1) / 2;
+            above.range.assign(above.width * above.depth, glm::vec2(INFINITY, -INFINITY));
+            for (int z = 0; z < below.depth; z++) {
+                for (int x = 0; x < below.width; x++) {
+                    glm::vec2& range = above.range[x / 2 + above.width * (z / 2)];
+                    const glm::vec2& child = below.range[x + below.width * z];
+                    range.x = std::min(range.x, child.x);
+                    range.y = std::max(range.y, child.y);
+                }
+            }
+            level_.push_back(above);
+        }
+    }
+
+
+    void TerrainNode::SetDetailDistance(float distance) {
+
+        lod_range_.resize(level_.size());
+        morph_range_.resize(level_.size());
+        for (int level = 0; level < level_.size(); level++) {
+            lod_range_[level] = distance * (float)(1 << level);
+        }
+        // The root is drawn however far away it is, and never morphs
+        lod_range_.back() = FLT_MAX;
+
+        for (int level = 0; level < level_.size(); level++) {
+            float start = (level > 0) ? lod_range_[level - 1] : 0.0f;
+            float end = lod_range_[level];
+            morph_range_[level] = (end == FLT_MAX) ? glm::vec2(FLT_MAX) : glm::vec2(start + (end - start) * 0.7f, end);
+        }
+    }
+
+
+    void TerrainNode::GetNodeBounds(int level, int x, int z, glm::vec3& min_corner, glm::vec3& max_corner) const {
+
+        float size = (float)(grid_cells_ << level);
+        const glm::vec2& range = level_[level].range[x + level_[level].width * z];
+        min_corner = glm::vec3(origin_.x + x * size, range.x, origin_.y + z * size);
+        max_corner = glm::vec3(std::min(min_corner.x + size, origin_.x + width_ - 1), range.y, std::min(min_corner.z + size, origin_.y + depth_ - 1));
+    }
+
+
+    bool TerrainNode::Select(int level, int x, int z, glm::vec3 eye, glm::vec3 forward) {
+
+        glm::vec3 min_corner, max_corner;
+        GetNodeBounds(level, x, z, min_corner, max_corner);
+        glm::vec3 offset = glm::clamp(eye, min_corner, max_corner) - eye;
+        float distance2 = glm::dot(offset, offset);
+        if (level + 1 < level_.size() && distance2 > lod_range_[level] * lod_range_[level]) {
+            return false;
+        }
+
+        // Entirely behind the viewer: nothing to draw here, and nothing for the parent either
+        glm::vec3 farthest(forward.x >= 0.0f ? max_corner.x : min_corner.x, forward.y >= 0.0f ? max_corner.y : min_corner.y, forward.z >= 0.0f ? max_corner.z : min_corner.z);
+        if (glm::dot(farthest - eye, forward) < 0.0f) {
+            return true;
+        }
+
+        float size = (float)(grid_cells_ << level);
+        Patch patch;
+        patch.rect = glm::vec4(x * size, z * size, size, level);
+
+        // Nothing is close enough for the level below
+        if (level == 0 || distance2 > lod_range_[level - 1] * lod_range_[level - 1]) {
+            patch.quarters = 15;
+            patch_.push_back(patch);
+            return true;
+        }
+
+        // Children out of their range are drawn as quarters of this patch
+        const Level& below = level_[level - 1];
+        patch.quarters = 0;
+        for (int quarter = 0; quarter < 4; quarter++) {
+            int child_x = 2 * x + (quarter & 1);
+            int child_z = 2 * z + (quarter >> 1);
+            if (child_x < below.width && child_z < below.depth && !Select(level - 1, child_x, child_z, eye, forward)) {
+                patch.quarters |= 1 << quarter;
+            }
+        }
+        if (patch.quarters) {
+            patch_.push_back(patch);
+        }
+        return true;
+    }
+
+
+    void TerrainNode::Draw(Camera* camera, SceneNode* light) {
+
+        if (!HasResources()) {
+            return;
+        }
+
+        // Select the patches around the camera in the space of the height field
+        glm::mat4 to_local = glm::inverse(GetWorldTransf());
+        glm::vec3 eye = glm::vec3(to_local * glm::vec4(camera->GetPosition(), 1.0f));
+        glm::vec3 forward = glm::vec3(to_local * glm::vec4(camera->GetForward(), 0.0f));
+        patch_.clear();
+        Select((int)level_.size() - 1, 0, 0, eye, forward);
+        if (patch_.empty()) {
+            return;
+        }
+
+        GLuint program = GetMaterial();
+        glUseProgram(program);
+        glBindBuffer(GL_ARRAY_BUFFER, GetArrayBuffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetElementArrayBuffer());
+        camera->SetupShader(program);
+        SetupShader(program, camera, light);
+
+        GLint patch_var = glGetUniformLocation(program, "terrain_patch");
+        GLint morph_var = glGetUniformLocation(program, "morph_range");
+        GLsizei quarter_size = GetSize() / 4;
+        for (int i = 0; i < patch_.size(); i++) {
+            const Patch& patch = patch_[i];
+            glUniform4fv(patch_var, 1, glm::value_ptr(patch.rect));
+            glUniform2fv(morph_var, 1, glm::value_ptr(morph_range_[(int)patch.rect.w]));
+            if (patch.quarters == 15) {
+                glDrawElements(GL_TRIANGLES, GetSize(), GL_UNSIGNED_INT, 0);
+                continue;
+            }
+            for (int quarter = 0; quarter < 4; quarter++) {
+                if (patch.quarters & (1 << quarter)) {
+                    glDrawElements(GL_TRIANGLES, quarter_size, GL_UNSIGNED_INT, (void*)(quarter * quarter_size * sizeof(GLuint)));
+                }
+            }
+        }
+    }
+
+
+    void TerrainNode::SetupAttributes(GLuint program) {
+
+        // Only the grid position; arrays left enabled by other nodes would read past the grid
+        for (GLuint i = 0; i < 4; i++) {
+            glDisableVertexAttribArray(i);
+        }
+        GLint grid_att = glGetAttribLocation(program, "grid");
+        glVertexAttribPointer(grid_att, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), 0);
+        glEnableVertexAttribArray(grid_att);
+    }
+
+
+    void TerrainNode::SetupShader(GLuint program, Camera* camera, SceneNode* light) {
+
+        SceneNode::SetupShader(program, camera, light);
+
+        // Heights on the second texture unit, the normal map stays on the first
+        GLint height_var = glGetUniformLocation(program, "height_map");
+        glUniform1i(height_var, 1);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, ResolveTexture(height_texture_));
+        glActiveTexture(GL_TEXTURE0);
+
+        GLint size_var = glGetUniformLocation(program, "terrain_size");
+        glUniform2f(size_var, (float)width_, (float)depth_);
+
+        GLint origin_var = glGetUniformLocation(program, "terrain_origin");
+        glUniform2fv(origin_var, 1, glm::value_ptr(origin_));
+
+        GLint cells_var = glGetUniformLocation(program, "grid_cells");
+        glUniform1f(cells_var, (float)grid_cells_);
+    }
+
+} // namespace game
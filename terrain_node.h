@@ -0,0 +1,73 @@
+/*
+ *
+ * Scene node that draws a height field with continuous level of detail (CDLOD). One small grid
+ * mesh (ResourceManager::CreateTerrainGrid) is drawn once per selected patch and displaced in
+ * the vertex shader from a height texture. Patches come from a min/max quadtree: every level
+ * doubles the patch size and the distance up to which it is used, so the number of draws grows
+ * with the number of levels, not with the size of the map. Vertices near the end of a level's
+ * range morph onto the grid of the next level, so there are no cracks or pops between levels.
+ *
+ */
+#ifndef TERRAIN_NODE_H_
+#define TERRAIN_NODE_H_
+
+#include <vector>
+
+#include "scene_node.h"
+
+namespace game {
+
+    class TerrainNode : public SceneNode {
+
+        public:
+            // geometry is a terrain grid, height_texture the same heights as height_map (width x
+            // depth samples, row by row along z); sample (0, 0) is at origin (x, z)
+            TerrainNode(const std::string name, const Resource* geometry, const Resource* material, const Resource* texture, const Resource* height_texture,
+                const std::vector<float>& height_map, int width, int depth, glm::vec2 origin);
+
+            // Distance up to which the finest level is used; each level above doubles it
+            void SetDetailDistance(float distance);
+            // Number of patches drawn the last frame
+            int GetNumPatches(void) const { return (int)patch_.size(); }
+
+            virtual void Draw(Camera* camera, SceneNode* light);
+
+        protected:
+            virtual void SetupShader(GLuint program, Camera* camera, SceneNode* light);
+            virtual void SetupAttributes(GLuint program);
+
+        private:
+            TextureHandle height_texture_;
+            int grid_cells_; // Quads along a side of the grid mesh
+            int width_; // Samples
+            int depth_;
+            glm::vec2 origin_;
+
+            // Min/max quadtree: level 0 holds the height range of every grid_cells_ sized patch,
+            // each level above covers 2x2 patches of the one below
+            struct Level {
+                int width, depth;
+                std::vector<glm::vec2> range; // (min, max)
+            };
+            std::vector<Level> level_;
+            std::vector<float> lod_range_; // Distance up to which a level is used
+            std::vector<glm::vec2> morph_range_; // Distances between which a level morphs into the next
+
+            struct Patch {
+                glm::vec4 rect; // Corner (x, z) and size in samples, level
+                int quarters; // Bit set of the quarters to draw (-x-z, +x-z, -x+z, +x+z)
+            };
+            std::vector<Patch> patch_; // Selected this frame
+
+            void BuildQuadtree(const std::vector<float>& height_map);
+            // Local-space box of a quadtree node
+            void GetNodeBounds(int level, int x, int z, glm::vec3& min_corner, glm::vec3& max_corner) const;
+            // Add the patches of a node seen from eye; returns false if the node is beyond its
+            // level's range and its parent has to draw that area instead
+            bool Select(int level, int x, int z, glm::vec3 eye, glm::vec3 forward);
+
+    }; // class TerrainNode
+
+} // namespace game
+
+#endif // TERRAIN_NODE_H_
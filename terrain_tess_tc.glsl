@@ -0,0 +1,87 @@
+#version 400
+
+// Corners (x, z), (x + 1, z), (x + 1, z + 1), (x, z + 1)
+layout(vertices = 4) out;
+
+in vec2 control_cell[];
+out vec2 patch_cell[];
+
+// Uniform (global) buffer
+uniform mat4 world_mat;
+uniform mat4 view_mat;
+uniform mat4 projection_mat;
+
+// Height field
+uniform sampler2D height_map;
+uniform vec2 terrain_size; // samples
+uniform vec2 terrain_origin; // position of sample (0, 0)
+uniform vec2 height_range; // lowest and highest sample
+
+// Subdivision
+uniform vec2 viewport_size; // pixels
+uniform float triangle_size; // wanted edge length in pixels
+uniform float max_tess_level;
+
+vec3 WorldPosition(vec2 cell)
+{
+    float height = texture(height_map, (cell + 0.5) / terrain_size).r;
+    return vec3(world_mat * vec4(terrain_origin.x + cell.x, height, terrain_origin.y + cell.y, 1.0));
+}
+
+// Subdivision of an edge from its size on screen; only depends on the edge, so the two
+// patches sharing it agree
+float EdgeLevel(vec2 a, vec2 b)
+{
+    vec3 world_a = WorldPosition(a);
+    vec3 world_b = WorldPosition(b);
+    float edge = distance(world_a, world_b);
+    // Size of a sphere around the edge, which does not depend on the direction it is seen from
+    float view_distance = max(length(vec3(view_mat * vec4((world_a + world_b) * 0.5, 1.0))), 0.001);
+    float pixels = edge * projection_mat[1][1] * viewport_size.y * 0.5 / view_distance;
+    return clamp(pixels / triangle_size, 1.0, max_tess_level);
+}
+
+// True if the box around the patch (from the height range of the field) is entirely outside
+// one of the planes of the view
+bool Culled(void)
+{
+    vec2 low = min(min(control_cell[0], control_cell[1]), min(control_cell[2], control_cell[3]));
+    vec2 high = max(max(control_cell[0], control_cell[1]), max(control_cell[2], control_cell[3]));
+    mat4 to_clip = projection_mat * view_mat * world_mat;
+
+    ivec3 outside_low = ivec3(0);
+    ivec3 outside_high = ivec3(0);
+    for (int i = 0; i < 8; i++) {
+        vec2 cell = vec2((i & 1) != 0 ? high.x : low.x, (i & 2) != 0 ? high.y : low.y);
+        float height = (i & 4) != 0 ? height_range.y : height_range.x;
+        vec4 clip = to_clip * vec4(terrain_origin.x + cell.x, height, terrain_origin.y + cell.y, 1.0);
+        outside_low += ivec3(lessThan(clip.xyz, vec3(-clip.w)));
+        outside_high += ivec3(greaterThan(clip.xyz, vec3(clip.w)));
+    }
+    return any(equal(outside_low, ivec3(8))) || any(equal(outside_high, ivec3(8)));
+}
+
+void main()
+{
+    patch_cell[gl_InvocationID] = control_cell[gl_InvocationID];
+
+    if (gl_InvocationID == 0) {
+        if (Culled()) {
+            // A zero level discards the patch
+            gl_TessLevelOuter[0] = 0.0;
+            gl_TessLevelOuter[1] = 0.0;
+            gl_TessLevelOuter[2] = 0.0;
+            gl_TessLevelOuter[3] = 0.0;
+            gl_TessLevelInner[0] = 0.0;
+            gl_TessLevelInner[1] = 0.0;
+        } else {
+            // Edges u = 0, v = 0, u = 1, v = 1
+            gl_TessLevelOuter[0] = EdgeLevel(control_cell[0], control_cell[3]);
+            gl_TessLevelOuter[1] = EdgeLevel(control_cell[0], control_cell[1]);
+            gl_TessLevelOuter[2] = EdgeLevel(control_cell[1], control_cell[2]);
+            gl_TessLevelOuter[3] = EdgeLevel(control_cell[3], control_cell[2]);
+            gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+            gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+        }
+    }
+}
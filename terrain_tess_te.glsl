@@ -0,0 +1,81 @@
+#version 400
+
+// u runs along x and v along z, which is clockwise seen from above
+layout(quads, fractional_even_spacing, cw) in;
+
+in vec2 patch_cell[];
+
+// Uniform (global) buffer
+uniform mat4 world_mat;
+uniform mat4 view_mat;
+uniform mat4 projection_mat;
+uniform mat4 normal_mat;
+uniform vec3 view_pos;
+uniform vec3 light_pos;
+
+// Height field
+uniform sampler2D height_map;
+uniform vec2 terrain_size; // samples
+uniform vec2 terrain_origin; // position of sample (0, 0)
+
+// Attributes forwarded to the fragment shader
+out vec3 vertex_position;
+out vec2 vertex_uv;
+
+out vec3 tangent_light_pos;
+out vec3 tangent_frag_pos;
+out vec3 tangent_view_pos;
+
+out vec3 light_vector;
+out vec3 view_vector;
+out vec3 normal_vector;
+
+float Height(vec2 cell)
+{
+    return texture(height_map, (cell + 0.5) / terrain_size).r;
+}
+
+void main()
+{
+    // Position on the height field (in samples)
+    vec2 uv = gl_TessCoord.xy;
+    vec2 cell = mix(mix(patch_cell[0], patch_cell[1], uv.x), mix(patch_cell[3], patch_cell[2], uv.x), uv.y);
+    cell = clamp(cell, vec2(0.0), terrain_size - 1.0);
+
+    vec3 vertex = vec3(terrain_origin.x + cell.x, Height(cell), terrain_origin.y + cell.y);
+
+    // Normal and tangent from central differences
+    float dx = (Height(cell + vec2(1.0, 0.0)) - Height(cell - vec2(1.0, 0.0))) * 0.5;
+    float dz = (Height(cell + vec2(0.0, 1.0)) - Height(cell - vec2(0.0, 1.0))) * 0.5;
+    vec3 normal = normalize(vec3(-dx, 1.0, -dz));
+    vec3 tangent = normalize(vec3(1.0, dx, 0.0));
+
+    gl_Position = projection_mat * view_mat * world_mat * vec4(vertex, 1.0);
+
+    vertex_position = vec3(view_mat * world_mat * vec4(vertex, 1.0));
+
+    // Define vertex tangent, bitangent and normal (TBN)
+    vec3 vertex_normal = normalize(vec3(normal_mat * view_mat * vec4(normal, 0.0)));
+    vec3 vertex_tangent_ts = normalize(vec3(normal_mat * view_mat * vec4(tangent, 0.0)));
+    vec3 vertex_bitangent_ts = cross(vertex_normal, vertex_tangent_ts);
+
+    // TBN matrix allows transition from view space to tangent space
+    mat3 TBN_mat = transpose(mat3(vertex_tangent_ts, vertex_bitangent_ts, vertex_normal));
+
+    // view-space positions
+    vec3 light_pos_v = vec3(view_mat * vec4(light_pos,1.0));
+    vec3 view_pos_v = vec3(view_mat * vec4(view_pos,1.0));
+
+    // tangent-space positions
+    tangent_light_pos = TBN_mat * light_pos_v;
+    tangent_view_pos = TBN_mat * view_pos_v;
+    tangent_frag_pos = TBN_mat * vertex_position;
+
+    // vectors for lighting calculations
+    normal_vector = TBN_mat * vertex_normal;
+    light_vector = tangent_light_pos - tangent_frag_pos;
+    view_vector = tangent_view_pos - tangent_frag_pos;
+
+    // Same texture coordinates as the plane mesh
+    vertex_uv = cell / (terrain_size - 1.0);
+}
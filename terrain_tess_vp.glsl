@@ -0,0 +1,14 @@
+#version 400
+
+// Vertex buffer: corner of a patch on the grid, 0 to 1
+in vec2 grid;
+
+uniform vec2 terrain_size; // samples
+
+// Corner of the patch in samples, for the tessellation control shader
+out vec2 control_cell;
+
+void main()
+{
+    control_cell = grid * (terrain_size - 1.0);
+}
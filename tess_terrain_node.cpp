@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "tess_terrain_node.h"
+
+namespace game {
+
+    TessTerrainNode::TessTerrainNode(const std::string name, const Resource* geometry, const Resource* material, const Resource* texture, const Resource* height_texture,
+        const std::vector<float>& height_map, int width, int depth, glm::vec2 origin) : SceneNode(name, geometry, material, texture, 0) {
+
+        if (!height_texture || height_texture->GetType() != Texture) {
+            throw(std::invalid_argument(std::string("Invalid type of height texture")));
+        }
+        // Four corners per cell of a square grid
+        int cells = (int)std::lround(std::sqrt(geometry->GetSize() / 4.0));
+        if (cells < 1 || geometry->GetSize() != cells * cells * 4) {
+            throw(std::invalid_argument(std::string("Geometry is not a patch grid")));
+        }
+        if (width < 2 || depth < 2 || height_map.size() < (size_t)width * depth) {
+            throw(std::invalid_argument(std::string("Invalid terrain size")));
+        }
+
+        height_texture_ = height_texture->GetTextureHandle();
+        width_ = width;
+        depth_ = depth;
+        origin_ = origin;
+
+        auto range = std::minmax_element(height_map.begin(), height_map.begin() + (size_t)width * depth);
+        height_range_ = glm::vec2(*range.first, *range.second);
+
+        // Subdividing a patch beyond its samples adds triangles but no detail (64 is the least
+        // every implementation supports)
+        float samples = (float)std::max(width_ - 1, depth_ - 1) / (float)cells;
+        max_tess_level_ = std::min(std::max(std::ceil(samples), 1.0f), 64.0f);
+        triangle_size_ = 8.0f;
+    }
+
+
+    void TessTerrainNode::Draw(Camera* camera, SceneNode* light) {
+
+        if (!HasResources()) {
+            return;
+        }
+        GLuint program = GetMaterial();
+        glUseProgram(program);
+        glBindBuffer(GL_ARRAY_BUFFER, GetArrayBuffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetElementArrayBuffer());
+        camera->SetupShader(program);
+        SetupShader(program, camera, light);
+
+        glPatchParameteri(GL_PATCH_VERTICES, 4);
+        glDrawElements(GL_PATCHES, GetSize(), GL_UNSIGNED_INT, 0);
+    }
+
+
+    void TessTerrainNode::SetupAttributes(GLuint program) {
+
+        // Only the grid position; arrays left enabled by other nodes would read past the grid
+        for (GLuint i = 0; i < 4; i++) {
+            glDisableVertexAttribArray(i);
+        }
+        GLint grid_att = glGetAttribLocation(program, "grid");
+        glVertexAttribPointer(grid_att, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), 0);
+        glEnableVertexAttribArray(grid_att);
+    }
+
+
+    void TessTerrainNode::SetupShader(GLuint program, Camera* camera, SceneNode* light) {
+
+        SceneNode::SetupShader(program, camera, light);
+
+        // Heights on the second texture unit, the normal map stays on the first
+        GLint height_var = glGetUniformLocation(program, "height_map");
+        glUniform1i(height_var, 1);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, ResolveTexture(height_texture_));
+        glActiveTexture(GL_TEXTURE0);
+
+        GLint size_var = glGetUniformLocation(program, "terrain_size");
+        glUniform2f(size_var, (float)width_, (float)depth_);
+
+        GLint origin_var = glGetUniformLocation(program, "terrain_origin");
+        glUniform2fv(origin_var, 1, glm::value_ptr(origin_));
+
+        GLint range_var = glGetUniformLocation(program, "height_range");
+        glUniform2fv(range_var, 1, glm::value_ptr(height_range_));
+
+        // Edge lengths are measured in pixels of the current target
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLint viewport_var = glGetUniformLocation(program, "viewport_size");
+        glUniform2f(viewport_var, (float)viewport[2], (float)viewport[3]);
+
+        GLint triangle_var = glGetUniformLocation(program, "triangle_size");
+        glUniform1f(triangle_var, triangle_size_);
+
+        GLint level_var = glGetUniformLocation(program, "max_tess_level");
+        glUniform1f(level_var, max_tess_level_);
+    }
+
+} // namespace game
@@ -0,0 +1,50 @@
+/*
+ *
+ * Scene node that draws a height field with hardware tessellation (OpenGL 4). Only a coarse
+ * grid of quad patches (ResourceManager::CreatePatchGrid) and the height texture are on the
+ * GPU; the tessellation control shader subdivides every patch edge by its length on screen and
+ * drops patches outside the view, the evaluation shader displaces the vertices and samples the
+ * normals from the heights. Neighbouring patches compute a shared edge the same way, so there
+ * are no cracks. Used instead of TerrainNode where tessellation is available.
+ *
+ */
+#ifndef TESS_TERRAIN_NODE_H_
+#define TESS_TERRAIN_NODE_H_
+
+#include <vector>
+
+#include "scene_node.h"
+
+namespace game {
+
+    class TessTerrainNode : public SceneNode {
+
+        public:
+            // geometry is a patch grid, height_texture the same heights as height_map (width x
+            // depth samples, row by row along z); sample (0, 0) is at origin (x, z)
+            TessTerrainNode(const std::string name, const Resource* geometry, const Resource* material, const Resource* texture, const Resource* height_texture,
+                const std::vector<float>& height_map, int width, int depth, glm::vec2 origin);
+
+            // Length in pixels the edges of the tessellated triangles should have on screen
+            void SetTriangleSize(float pixels) { triangle_size_ = pixels; }
+
+            virtual void Draw(Camera* camera, SceneNode* light);
+
+        protected:
+            virtual void SetupShader(GLuint program, Camera* camera, SceneNode* light);
+            virtual void SetupAttributes(GLuint program);
+
+        private:
+            TextureHandle height_texture_;
+            int width_; // Samples
+            int depth_;
+            glm::vec2 origin_;
+            glm::vec2 height_range_; // (min, max) of the whole field, for culling patches
+            float max_tess_level_; // No finer than one triangle per sample
+            float triangle_size_;
+
+    }; // class TessTerrainNode
+
+} // namespace game
+
+#endif // TESS_TERRAIN_NODE_H_
@@ -0,0 +1,93 @@
+/*
+ *
+ * Block-compressed textures: DDS files holding a whole mip chain in BC1 (opaque colour), BC3
+ * (colour with alpha) or BC5 (two channels, for normal maps). They are produced from the PNG
+ * images by tools/texture_converter and uploaded without decoding.
+ *
+ * Layout (little endian):
+ *   "DDS " magic
+ *   DdsHeader
+ *   mip levels from the largest down to 1x1, each in rows of 4x4 blocks
+ *
+ * Only the legacy FourCC formats DXT1, DXT5 and ATI2 are written and read.
+ *
+ */
+#ifndef TEXTURE_FILE_H_
+#define TEXTURE_FILE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace game {
+
+    // FourCC codes, as stored in DdsPixelFormat::four_cc
+    const uint32_t dds_magic_g = 0x20534444; // "DDS "
+    const uint32_t dds_dxt1_g = 0x31545844; // "DXT1", BC1
+    const uint32_t dds_dxt5_g = 0x35545844; // "DXT5", BC3
+    const uint32_t dds_ati2_g = 0x32495441; // "ATI2", BC5
+
+    // Header flags written by the converter
+    enum DdsFlags : uint32_t {
+        DdsCaps = 0x1,
+        DdsHeight = 0x2,
+        DdsWidth = 0x4,
+        DdsPixelFormatFlag = 0x1000,
+        DdsMipMapCount = 0x20000,
+        DdsLinearSize = 0x80000,
+        DdsFourCC = 0x4, // DdsPixelFormat::flags
+        DdsCapsComplex = 0x8, // DdsHeader::caps
+        DdsCapsTexture = 0x1000,
+        DdsCapsMipMap = 0x400000
+    };
+
+    struct DdsPixelFormat {
+        uint32_t size; // 32
+        uint32_t flags;
+        uint32_t four_cc;
+        uint32_t rgb_bit_count;
+        uint32_t mask[4];
+    };
+
+    struct DdsHeader {
+        uint32_t size; // 124
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t linear_size; // Bytes in the largest level
+        uint32_t depth;
+        uint32_t mip_map_count;
+        uint32_t reserved[11];
+        DdsPixelFormat pixel_format;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    static_assert(sizeof(DdsHeader) == 124, "DDS header must be packed");
+
+    // Bytes in one 4x4 block of a format, 0 for a format that is not supported
+    inline uint32_t DdsBlockBytes(uint32_t four_cc) {
+        return (four_cc == dds_dxt1_g) ? 8 : (four_cc == dds_dxt5_g || four_cc == dds_ati2_g) ? 16 : 0;
+    }
+
+    // Bytes in a level of width x height texels (partial blocks are whole blocks)
+    inline uint32_t DdsLevelBytes(uint32_t width, uint32_t height, uint32_t block_bytes) {
+        return std::max((width + 3) / 4, 1u) * std::max((height + 3) / 4, 1u) * block_bytes;
+    }
+
+    // Converted file of an image: the same name with the extension .dds
+    inline std::string DdsFilename(const std::string& image) {
+        size_t dot = image.find_last_of('.');
+        size_t slash = image.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return image + ".dds";
+        }
+        return image.substr(0, dot) + ".dds";
+    }
+
+} // namespace game
+
+#endif // TEXTURE_FILE_H_
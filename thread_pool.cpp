@@ -0,0 +1,273 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+namespace game {
+
+    // Pool and deque of the current thread (workers only)
+    static thread_local ThreadPool* current_pool_g = nullptr;
+    static thread_local int current_queue_g = 0;
+
+
+    ThreadPool::ThreadPool(int num_threads) {
+
+        queued_ = 0;
+        background_queued_ = 0;
+
+        if (num_threads <= 0) {
+            num_threads = (int)std::thread::hardware_concurrency() - 1;
+        }
+
+        for (int i = 0; i <= std::max(num_threads, 0); i++) {
+            queue_.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+        }
+        for (int i = 0; i < num_threads; i++) {
+            workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this, i + 1));
+        }
+    }
+
+
+    ThreadPool::~ThreadPool() {
+
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+
+        for (int i = 0; i < workers_.size(); i++) {
+            workers_[i].join();
+        }
+    }
+
+
+    int ThreadPool::GetNumThreads(void) const {
+
+        return workers_.size();
+    }
+
+
+    int ThreadPool::GetQueueIndex(void) const {
+
+        return (current_pool_g == this) ? current_queue_g : 0;
+    }
+
+
+    void ThreadPool::Submit(std::function<void()> job, JobCounter* counter) {
+
+        if (counter) {
+            counter->pending_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Without workers the job runs right away
+        if (workers_.empty()) {
+            Job now = { std::move(job), counter };
+            RunJob(now);
+            return;
+        }
+
+        WorkQueue& queue = *queue_[GetQueueIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(Job{ std::move(job), counter });
+        }
+        queued_.fetch_add(1);
+
+        // Taking the lock orders this with a thread that is about to sleep
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            if (waiting_ > 0) {
+                idle_.notify_all();
+            }
+        }
+        wake_.notify_one();
+    }
+
+
+    void ThreadPool::SubmitBackground(std::function<void()> job, JobCounter* counter) {
+
+        if (counter) {
+            counter->pending_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (workers_.empty()) {
+            Job now = { std::move(job), counter };
+            RunJob(now);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(background_.mutex);
+            background_.jobs.push_back(Job{ std::move(job), counter });
+        }
+        background_queued_.fetch_add(1);
+
+        // Only workers run background jobs, so waiting threads are left asleep
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+        wake_.notify_one();
+    }
+
+
+    bool ThreadPool::PopBackgroundJob(Job& job) {
+
+        std::lock_guard<std::mutex> lock(background_.mutex);
+        if (background_.jobs.empty()) {
+            return false;
+        }
+        job = std::move(background_.jobs.front());
+        background_.jobs.pop_front();
+        background_queued_.fetch_sub(1);
+        return true;
+    }
+
+
+    bool ThreadPool::PopJob(int index, Job& job) {
+
+        // Newest job of our own first (its data is likely still in cache)
+        {
+            WorkQueue& own = *queue_[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // Steal the oldest job of another thread
+        for (int i = 1; i < queue_.size(); i++) {
+            WorkQueue& victim = *queue_[(index + i) % queue_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    void ThreadPool::RunJob(Job& job) {
+
+        // A job that throws still counts as done; its exception goes to the thread waiting for it
+        try {
+            job.run();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(job.counter ? job.counter->error_mutex_ : sleep_mutex_);
+            std::exception_ptr& error = job.counter ? job.counter->error_ : error_;
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        if (job.counter && job.counter->pending_.fetch_sub(1, std::memory_order_release) == 1) {
+            WakeWaiters();
+        }
+    }
+
+
+    void ThreadPool::WakeWaiters(void) {
+
+        // Taking the lock orders this with a thread that is about to sleep
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        if (waiting_ > 0) {
+            idle_.notify_all();
+        }
+    }
+
+
+    bool ThreadPool::RunPendingJob(void) {
+
+        Job job;
+        if (!PopJob(GetQueueIndex(), job)) {
+            return false;
+        }
+        RunJob(job);
+        return true;
+    }
+
+
+    void ThreadPool::WaitUntil(const std::function<bool()>& done) {
+
+        // Help instead of blocking, so waiting inside a job cannot stall the pool
+        while (!done()) {
+            if (RunPendingJob()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            waiting_++;
+            idle_.wait(lock, [this, &done] { return queued_.load() > 0 || done(); });
+            waiting_--;
+        }
+    }
+
+
+    void ThreadPool::Wait(JobCounter& counter) {
+
+        WaitUntil([&counter]() { return counter.IsDone(); });
+
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(counter.error_mutex_);
+            error.swap(counter.error_);
+        }
+        if (!error) {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            error.swap(error_);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+
+    void ThreadPool::ParallelFor(int count, const std::function<void(int)>& task) {
+
+        // Not worth waking anyone up for a single item
+        if (workers_.empty() || count <= 1) {
+            for (int i = 0; i < count; i++) {
+                task(i);
+            }
+            return;
+        }
+
+        // A few batches per thread so stealing can even out uneven items
+        int num_batches = std::min(count, (int)queue_.size() * 4);
+        JobCounter counter;
+        for (int b = 0; b < num_batches; b++) {
+            int begin = (int)((long long)count * b / num_batches);
+            int end = (int)((long long)count * (b + 1) / num_batches);
+            Submit([&task, begin, end]() {
+                for (int i = begin; i < end; i++) {
+                    task(i);
+                }
+            }, &counter);
+        }
+        Wait(counter);
+    }
+
+
+    void ThreadPool::WorkerLoop(int index) {
+
+        current_pool_g = this;
+        current_queue_g = index;
+
+        while (true) {
+            Job job;
+            if (PopJob(index, job) || PopBackgroundJob(job)) {
+                RunJob(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_.wait(lock, [this] { return stop_ || queued_.load() > 0 || background_queued_.load() > 0; });
+            if (stop_) {
+                return;
+            }
+        }
+    }
+
+} // namespace game
@@ -0,0 +1,111 @@
+/*
+ *
+ * A small pool of worker threads used to spread per-object work (animation, transforms)
+ * across all cores. Jobs are scheduled by work stealing: every worker (and the thread that
+ * created the pool) has its own deque, pushes and pops jobs at the back of it and, when it runs
+ * dry, steals from the front of another worker's deque. Threads waiting for jobs to finish run
+ * other jobs in the meantime, so jobs may submit and wait for jobs of their own, and sleep when
+ * there are none. An exception thrown by a job is passed on to the thread waiting for it.
+ *
+ */
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace game {
+
+    // Counts the unfinished jobs of a group; wait for it with ThreadPool::Wait
+    class JobCounter {
+
+        public:
+            JobCounter(void) : pending_(0) {}
+            bool IsDone(void) const { return pending_.load(std::memory_order_acquire) == 0; }
+
+        private:
+            friend class ThreadPool;
+            std::atomic<int> pending_;
+            std::mutex error_mutex_;
+            std::exception_ptr error_; // First exception thrown by a job of the group
+    };
+
+    // Fixed-size pool of worker threads
+    class ThreadPool {
+
+        public:
+            // Create the pool; 0 threads means one per hardware core (minus the calling thread)
+            ThreadPool(int num_threads = 0);
+            ~ThreadPool();
+
+            // Queue a job; the counter (if any) is done once all jobs submitted with it have run
+            void Submit(std::function<void()> job, JobCounter* counter = nullptr);
+            // Queue a job that only idle workers pick up, after every other job. Waiting threads
+            // never run it, so long jobs (file decoding) cannot hold up the waits of a frame
+            void SubmitBackground(std::function<void()> job, JobCounter* counter = nullptr);
+            // Run queued jobs until the counter is done, then rethrow the first exception one of
+            // its jobs threw (or one of a job submitted without a counter)
+            void Wait(JobCounter& counter);
+            // Run queued jobs until done() is true, sleeping while there are none to run. Whoever
+            // makes done() true must call WakeWaiters (counters do that themselves)
+            void WaitUntil(const std::function<bool()>& done);
+            void WakeWaiters(void);
+            // Run one queued job if there is one (own deque first, then stealing)
+            bool RunPendingJob(void);
+
+            // Call task(i) for every i in [0, count) and wait until all calls have returned.
+            // The calling thread takes part in the work. Tasks must only touch data owned by index i.
+            void ParallelFor(int count, const std::function<void(int)>& task);
+
+            // Number of worker threads (not counting the caller)
+            int GetNumThreads(void) const;
+
+        private:
+            struct Job {
+                std::function<void()> run;
+                JobCounter* counter;
+            };
+
+            // Deque of one thread; the owner works at the back, thieves take from the front
+            struct WorkQueue {
+                std::mutex mutex;
+                std::deque<Job> jobs;
+            };
+
+            std::vector<std::thread> workers_;
+            // queue_[0] belongs to the thread that created the pool (and any other outside thread),
+            // queue_[i + 1] to worker i
+            std::vector<std::unique_ptr<WorkQueue>> queue_;
+
+            std::atomic<int> queued_; // Jobs in all deques
+            // Background jobs, oldest first
+            WorkQueue background_;
+            std::atomic<int> background_queued_;
+            std::mutex sleep_mutex_;
+            std::condition_variable wake_; // Signals sleeping workers that jobs were queued
+            std::condition_variable idle_; // Signals waiting threads that jobs were queued or finished
+            int waiting_ = 0; // Threads sleeping in WaitUntil
+            std::exception_ptr error_; // First exception of a job without a counter
+            bool stop_ = false;
+
+            // Main loop of every worker thread
+            void WorkerLoop(int index);
+
+            // Deque of the calling thread
+            int GetQueueIndex(void) const;
+            bool PopJob(int index, Job& job);
+            bool PopBackgroundJob(Job& job);
+            void RunJob(Job& job);
+
+    }; // class ThreadPool
+
+} // namespace game
+
+#endif // THREAD_POOL_H_
@@ -0,0 +1,320 @@
+/*
+ *
+ * Converts a text scene description into the binary format loaded by the game (scene_file.h).
+ *
+ * Usage: scene_converter <input.txt> <output.scene> [chunk_size]
+ *
+ * With a chunk size, objects are split by position into <output>_<x>_<z>.scene files for
+ * WorldStreamer; objects following the camera stay in <output>.scene, and linked objects go
+ * with the object they are linked to.
+ *
+ * One object per line, '#' starts a comment:
+ *   <prefab> <name> <x> <y> <z> [options]
+ * Options:
+ *   rotate <degrees> <ax> <ay> <az>   rotation applied after construction
+ *   scale <sx> <sy> <sz>              scale applied after construction
+ *   param <a> [b] [c] [d]             prefab parameters (see ScenePrefab)
+ *   object|material|texture <name>    resources of a particle system
+ *   link <name>                       destroyed together with an earlier object
+ *   follow <ox> <oy> <oz>             particle system follows the camera at this offset
+ *   ground                            y is the height above the terrain
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../scene_file.h"
+
+using namespace game;
+
+// Builds the string table, storing every distinct string once
+class StringTable {
+
+    public:
+        StringTable(void) : data_(1, '\0') {}
+
+        uint32_t Add(const std::string& s) {
+            if (s.empty()) {
+                return 0;
+            }
+            auto it = offset_.find(s);
+            if (it != offset_.end()) {
+                return it->second;
+            }
+            uint32_t offset = data_.size();
+            data_.insert(data_.end(), s.begin(), s.end());
+            data_.push_back('\0');
+            offset_[s] = offset;
+            return offset;
+        }
+
+        const std::vector<char>& GetData(void) const { return data_; }
+
+    private:
+        std::vector<char> data_;
+        std::unordered_map<std::string, uint32_t> offset_;
+};
+
+
+// A parsed record; strings are kept as text until the file they go to is known
+struct Object {
+    SceneRecord record;
+    std::string name;
+    std::string string[3];
+};
+
+
+static bool WriteSceneFile(const std::string& filename, const std::vector<Object>& objects, const std::vector<int>& subset) {
+
+    StringTable strings;
+    std::vector<SceneRecord> records;
+    std::unordered_map<int, int> new_index; // Links are renumbered within the file
+
+    for (int i = 0; i < subset.size(); i++) {
+        const Object& object = objects[subset[i]];
+        SceneRecord record = object.record;
+        record.name = strings.Add(object.name);
+        for (int s = 0; s < 3; s++) {
+            record.string[s] = strings.Add(object.string[s]);
+        }
+        if (record.link >= 0) {
+            auto it = new_index.find(record.link);
+            record.link = (it != new_index.end()) ? it->second : -1;
+        }
+        new_index[subset[i]] = records.size();
+        records.push_back(record);
+    }
+
+    const std::vector<char>& string_data = strings.GetData();
+
+    SceneFileHeader header;
+    std::memcpy(header.magic, "BJSC", 4);
+    header.version = scene_file_version_g;
+    header.num_records = records.size();
+    header.record_size = sizeof(SceneRecord);
+    header.strings_offset = sizeof(SceneFileHeader) + records.size() * sizeof(SceneRecord);
+    header.strings_size = string_data.size();
+
+    std::ofstream output(filename, std::ios::binary);
+    if (!output) {
+        std::cerr << "Error opening file " << filename << std::endl;
+        return false;
+    }
+    output.write((const char*)&header, sizeof(header));
+    output.write((const char*)records.data(), records.size() * sizeof(SceneRecord));
+    output.write(string_data.data(), string_data.size());
+    if (!output) {
+        std::cerr << "Error writing file " << filename << std::endl;
+        return false;
+    }
+
+    std::cout << filename << ": " << records.size() << " objects" << std::endl;
+    return true;
+}
+
+
+static bool ReadFloats(std::istringstream& in, float* values, int count) {
+
+    for (int i = 0; i < count; i++) {
+        if (!(in >> values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <input.txt> <output.scene> [chunk_size]" << std::endl;
+        return 1;
+    }
+    float chunk_size = (argc == 4) ? (float)std::atof(argv[3]) : 0.0f;
+    if (argc == 4 && chunk_size <= 0.0f) {
+        std::cerr << "Invalid chunk size " << argv[3] << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(argv[1]);
+    if (!input) {
+        std::cerr << "Error opening file " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<Object> objects;
+    std::unordered_map<std::string, int> record_index; // By name, for links
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(input, line)) {
+        line_number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::istringstream in(line);
+        std::string prefab;
+        if (!(in >> prefab)) {
+            continue; // Blank line
+        }
+
+        Object object;
+        SceneRecord& record = object.record;
+        std::memset(&record, 0, sizeof(record));
+        record.prefab = PrefabCount;
+        for (uint32_t i = 0; i < PrefabCount; i++) {
+            if (prefab == scene_prefab_names_g[i]) {
+                record.prefab = i;
+            }
+        }
+        record.link = -1;
+        record.rotation[0] = 1.0f;
+        record.scale[0] = record.scale[1] = record.scale[2] = 1.0f;
+
+        std::string error;
+        std::string name;
+        if (record.prefab == PrefabCount) {
+            error = "unknown prefab '" + prefab + "'";
+        }
+        else if (!(in >> name) || !ReadFloats(in, record.position, 3)) {
+            error = "expected <name> <x> <y> <z>";
+        }
+
+        std::string option;
+        while (error.empty() && in >> option) {
+            if (option == "rotate") {
+                float r[4];
+                if (!ReadFloats(in, r, 4)) {
+                    error = "rotate needs <degrees> <ax> <ay> <az>";
+                    break;
+                }
+                // Same quaternion as glm::angleAxis (the axis is used as given)
+                float half = r[0] * 3.14159265358979f / 180.0f * 0.5f;
+                record.rotation[0] = std::cos(half);
+                record.rotation[1] = r[1] * std::sin(half);
+                record.rotation[2] = r[2] * std::sin(half);
+                record.rotation[3] = r[3] * std::sin(half);
+            }
+            else if (option == "scale") {
+                if (!ReadFloats(in, record.scale, 3)) {
+                    error = "scale needs <sx> <sy> <sz>";
+                }
+            }
+            else if (option == "param") {
+                // Up to four numbers, until the next option
+                int n = 0;
+                float value;
+                std::streampos pos = in.tellg();
+                while (n < 4 && in >> value) {
+                    record.param[n++] = value;
+                    pos = in.tellg();
+                }
+                in.clear();
+                in.seekg(pos);
+                if (n == 0) {
+                    error = "param needs at least one value";
+                }
+            }
+            else if (option == "object" || option == "material" || option == "texture") {
+                std::string value;
+                if (!(in >> value)) {
+                    error = option + " needs a name";
+                    break;
+                }
+                int slot = (option == "object") ? 0 : (option == "material") ? 1 : 2;
+                object.string[slot] = value;
+            }
+            else if (option == "link") {
+                std::string owner;
+                if (!(in >> owner) || record_index.find(owner) == record_index.end()) {
+                    error = "link needs the name of an earlier object";
+                    break;
+                }
+                record.link = record_index[owner];
+            }
+            else if (option == "ground") {
+                record.flags |= RecordOnTerrain;
+            }
+            else if (option == "follow") {
+                if (!ReadFloats(in, record.param, 3)) {
+                    error = "follow needs <ox> <oy> <oz>";
+                }
+                record.flags |= RecordFollowCamera;
+            }
+            else {
+                error = "unknown option '" + option + "'";
+            }
+        }
+
+        if (!error.empty()) {
+            std::cerr << argv[1] << ":" << line_number << ": " << error << std::endl;
+            return 1;
+        }
+
+        object.name = name;
+        // First object with a name wins, as in the scene graph
+        record_index.insert(std::make_pair(name, (int)objects.size()));
+        objects.push_back(object);
+    }
+
+    std::string output = argv[2];
+    if (chunk_size == 0.0f) {
+        std::vector<int> all(objects.size());
+        for (int i = 0; i < all.size(); i++) {
+            all[i] = i;
+        }
+        return WriteSceneFile(output, objects, all) ? 0 : 1;
+    }
+
+    // Split by chunk; INT32_MIN marks objects that stay resident
+    std::vector<int> global;
+    std::map<std::pair<int, int>, std::vector<int>> chunks;
+    std::vector<std::pair<int, int>> chunk_of(objects.size());
+    for (int i = 0; i < objects.size(); i++) {
+        const SceneRecord& record = objects[i].record;
+        if (record.flags & RecordFollowCamera) {
+            chunk_of[i] = std::make_pair(INT32_MIN, INT32_MIN);
+        }
+        else if (record.link >= 0) {
+            chunk_of[i] = chunk_of[record.link];
+        }
+        else {
+            chunk_of[i] = std::make_pair((int)std::floor(record.position[0] / chunk_size), (int)std::floor(record.position[2] / chunk_size));
+        }
+        if (chunk_of[i].first == INT32_MIN) {
+            global.push_back(i);
+        }
+        else {
+            chunks[chunk_of[i]].push_back(i);
+        }
+    }
+
+    // Output name without the extension is the prefix of the chunk files
+    std::string prefix = output;
+    size_t dot = prefix.rfind('.');
+    if (dot != std::string::npos && prefix.find_first_of("/\\", dot) == std::string::npos) {
+        prefix.erase(dot);
+    }
+
+    if (!WriteSceneFile(output, objects, global)) {
+        return 1;
+    }
+    for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+        std::string filename = prefix + "_" + std::to_string(it->first.first) + "_" + std::to_string(it->first.second) + ".scene";
+        if (!WriteSceneFile(filename, objects, it->second)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,338 @@
+/*
+ *
+ * Converts images into block-compressed DDS textures with their whole mip chain
+ * (texture_file.h), which the game loads in place of the images.
+ *
+ * Usage: texture_converter [bc1|bc3|bc5] <image>...
+ *
+ * Every image is written next to itself with the extension .dds. Without a format, normal
+ * maps (names starting with nm_) become BC5, images with transparent texels BC3 and the others
+ * BC1. Levels are box filtered from the one above; the normals of BC5 levels are renormalized.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <SOIL/SOIL.h>
+
+#include "../texture_file.h"
+
+using namespace game;
+
+// RGBA texels in [0, 1], row by row
+struct Image {
+    int width;
+    int height;
+    std::vector<float> texel;
+
+    // Texels past the edge repeat the edge
+    const float* At(int x, int y) const {
+        x = std::min(std::max(x, 0), width - 1);
+        y = std::min(std::max(y, 0), height - 1);
+        return &texel[4 * ((size_t)x + (size_t)width * y)];
+    }
+};
+
+
+// Next level of the mip chain: every texel is the average of the 2x2 texels above it
+static Image Downsample(const Image& image, bool normal_map) {
+
+    Image half;
+    half.width = std::max(image.width / 2, 1);
+    half.height = std::max(image.height / 2, 1);
+    half.texel.resize(4 * (size_t)half.width * half.height);
+    for (int y = 0; y < half.height; y++) {
+        for (int x = 0; x < half.width; x++) {
+            float* texel = &half.texel[4 * ((size_t)x + (size_t)half.width * y)];
+            for (int c = 0; c < 4; c++) {
+                texel[c] = 0.25f * (image.At(2 * x, 2 * y)[c] + image.At(2 * x + 1, 2 * y)[c] + image.At(2 * x, 2 * y + 1)[c] + image.At(2 * x + 1, 2 * y + 1)[c]);
+            }
+            if (normal_map) {
+                // Averaged normals get shorter
+                float n[3] = { texel[0] * 2.0f - 1.0f, texel[1] * 2.0f - 1.0f, texel[2] * 2.0f - 1.0f };
+                float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length > 0.0f) {
+                    for (int c = 0; c < 3; c++) {
+                        texel[c] = n[c] / length * 0.5f + 0.5f;
+                    }
+                }
+            }
+        }
+    }
+    return half;
+}
+
+
+static uint16_t To565(const float* color) {
+
+    int r = (int)std::lround(std::min(std::max(color[0], 0.0f), 1.0f) * 31.0f);
+    int g = (int)std::lround(std::min(std::max(color[1], 0.0f), 1.0f) * 63.0f);
+    int b = (int)std::lround(std::min(std::max(color[2], 0.0f), 1.0f) * 31.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+
+static void From565(uint16_t packed, float* color) {
+
+    color[0] = ((packed >> 11) & 31) / 31.0f;
+    color[1] = ((packed >> 5) & 63) / 63.0f;
+    color[2] = (packed & 31) / 31.0f;
+}
+
+
+// BC1 block (8 bytes) of 16 RGBA texels: two 5:6:5 endpoints at the ends of the principal
+// axis of the colours and a 2-bit index per texel into the endpoints and two colours between
+static void EncodeColorBlock(const float block[16][4], uint8_t* out) {
+
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += block[i][c] / 16.0f;
+        }
+    }
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                covariance[r][c] += d[r] * d[c];
+            }
+        }
+    }
+
+    // Principal axis by power iteration
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int r = 0; r < 3; r++) {
+            next[r] = covariance[r][0] * axis[0] + covariance[r][1] * axis[1] + covariance[r][2] * axis[2];
+        }
+        float length = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+        if (length < 1e-9f) {
+            break; // All texels have the same colour
+        }
+        for (int r = 0; r < 3; r++) {
+            axis[r] = next[r] / length;
+        }
+    }
+    float axis_length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    float low = INFINITY, high = -INFINITY;
+    for (int i = 0; i < 16; i++) {
+        float t = ((block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2]) / axis_length2;
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+    float end0[3], end1[3];
+    for (int c = 0; c < 3; c++) {
+        end0[c] = mean[c] + high * axis[c];
+        end1[c] = mean[c] + low * axis[c];
+    }
+
+    // The first endpoint must be the larger one, or the block has only three colours
+    uint16_t color0 = To565(end0);
+    uint16_t color1 = To565(end1);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+    float palette[4][3];
+    From565(color0, palette[0]);
+    From565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            float best_error = INFINITY;
+            for (int p = 0; p < 4; p++) {
+                float error = 0.0f;
+                for (int c = 0; c < 3; c++) {
+                    error += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+                }
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+
+// BC4 block (8 bytes) of one channel of 16 RGBA texels: the lowest and highest values and a
+// 3-bit index per texel into them and six values between
+static void EncodeChannelBlock(const float block[16][4], int channel, uint8_t* out) {
+
+    float low = 1.0f, high = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        low = std::min(low, block[i][channel]);
+        high = std::max(high, block[i][channel]);
+    }
+    int value0 = (int)std::lround(std::min(std::max(high, 0.0f), 1.0f) * 255.0f);
+    int value1 = (int)std::lround(std::min(std::max(low, 0.0f), 1.0f) * 255.0f);
+
+    uint64_t indices = 0;
+    if (value0 > value1) {
+        float palette[8];
+        palette[0] = (float)value0;
+        palette[1] = (float)value1;
+        for (int p = 2; p < 8; p++) {
+            palette[p] = ((8 - p) * value0 + (p - 1) * value1) / 7.0f;
+        }
+        for (int i = 0; i < 16; i++) {
+            float value = block[i][channel] * 255.0f;
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::fabs(value - palette[p]) < std::fabs(value - palette[best])) {
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    out[0] = (uint8_t)value0;
+    out[1] = (uint8_t)value1;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+
+// Append the blocks of a level, row by row
+static void EncodeLevel(const Image& image, uint32_t four_cc, std::vector<uint8_t>& data) {
+
+    for (int block_y = 0; block_y < image.height; block_y += 4) {
+        for (int block_x = 0; block_x < image.width; block_x += 4) {
+            float block[16][4];
+            for (int i = 0; i < 16; i++) {
+                std::memcpy(block[i], image.At(block_x + i % 4, block_y + i / 4), sizeof(block[i]));
+            }
+
+            uint8_t encoded[16];
+            if (four_cc == dds_dxt1_g) {
+                EncodeColorBlock(block, encoded);
+            }
+            else if (four_cc == dds_dxt5_g) {
+                EncodeChannelBlock(block, 3, encoded);
+                EncodeColorBlock(block, encoded + 8);
+            }
+            else {
+                EncodeChannelBlock(block, 0, encoded);
+                EncodeChannelBlock(block, 1, encoded + 8);
+            }
+            data.insert(data.end(), encoded, encoded + DdsBlockBytes(four_cc));
+        }
+    }
+}
+
+
+static bool ConvertImage(const std::string& filename, uint32_t four_cc) {
+
+    int width, height, channels;
+    unsigned char* pixels = SOIL_load_image(filename.c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
+    if (!pixels) {
+        std::cerr << "Error loading image " << filename << ": " << SOIL_last_result() << std::endl;
+        return false;
+    }
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.texel.resize(4 * (size_t)width * height);
+    bool transparent = false;
+    for (size_t i = 0; i < image.texel.size(); i++) {
+        image.texel[i] = pixels[i] / 255.0f;
+        transparent = transparent || (i % 4 == 3 && pixels[i] < 255);
+    }
+    SOIL_free_image_data(pixels);
+
+    if (!four_cc) {
+        size_t slash = filename.find_last_of("/\\");
+        std::string name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+        four_cc = (name.compare(0, 3, "nm_") == 0) ? dds_ati2_g : transparent ? dds_dxt5_g : dds_dxt1_g;
+    }
+
+    // Levels down to 1x1
+    std::vector<uint8_t> data;
+    uint32_t levels = 1;
+    EncodeLevel(image, four_cc, data);
+    uint32_t linear_size = data.size();
+    while (image.width > 1 || image.height > 1) {
+        image = Downsample(image, four_cc == dds_ati2_g);
+        EncodeLevel(image, four_cc, data);
+        levels++;
+    }
+
+    DdsHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.size = sizeof(DdsHeader);
+    header.flags = DdsCaps | DdsHeight | DdsWidth | DdsPixelFormatFlag | DdsMipMapCount | DdsLinearSize;
+    header.height = height;
+    header.width = width;
+    header.linear_size = linear_size;
+    header.mip_map_count = levels;
+    header.pixel_format.size = sizeof(DdsPixelFormat);
+    header.pixel_format.flags = DdsFourCC;
+    header.pixel_format.four_cc = four_cc;
+    header.caps = DdsCapsTexture | DdsCapsComplex | DdsCapsMipMap;
+
+    std::string output = DdsFilename(filename);
+    std::ofstream out(output, std::ios::binary);
+    out.write((const char*)&dds_magic_g, sizeof(dds_magic_g));
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)data.data(), data.size());
+    if (!out) {
+        std::cerr << "Error writing file " << output << std::endl;
+        return false;
+    }
+
+    const char* format = (four_cc == dds_dxt1_g) ? "BC1" : (four_cc == dds_dxt5_g) ? "BC3" : "BC5";
+    std::cout << filename << " -> " << output << " (" << format << ", " << levels << " levels, "
+        << data.size() / 1024 << " KB, " << (size_t)width * height * 16 / 3 / 1024 << " KB as RGBA with mipmaps)" << std::endl;
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+
+    int first = 1;
+    uint32_t four_cc = 0; // Chosen per image
+    if (argc > 1) {
+        std::string format = argv[1];
+        four_cc = (format == "bc1") ? dds_dxt1_g : (format == "bc3") ? dds_dxt5_g : (format == "bc5") ? dds_ati2_g : 0;
+        if (four_cc) {
+            first = 2;
+        }
+    }
+    if (first >= argc) {
+        std::cerr << "Usage: " << argv[0] << " [bc1|bc3|bc5] <image>..." << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = first; i < argc; i++) {
+        if (!ConvertImage(argv[i], four_cc)) {
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <ios>
+
+#include "walk_field.h"
+
+namespace game {
+
+    // Cache file layout: header, walkable_ (one byte per cell), distance_ (one float per cell)
+    struct WalkFieldHeader {
+        char magic[4]; // "BJWF"
+        uint32_t version;
+        int32_t width;
+        int32_t depth;
+        float max_slope;
+        uint32_t reserved;
+        uint64_t source_hash;
+    };
+    static const uint32_t walk_field_version_g = 1;
+
+
+    WalkField::WalkField(void) {
+
+        width_ = 0;
+        depth_ = 0;
+        origin_ = glm::vec2(0.0f);
+        max_slope_ = 0.0f;
+        source_hash_ = 0;
+    }
+
+
+    uint64_t WalkField::HashTerrain(const Terrain& terrain) {
+
+        // FNV-1a over the sizes and every sample
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](const void* data, size_t size) {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+        };
+        int width = terrain.GetWidth();
+        int depth = terrain.GetDepth();
+        add(&width, sizeof(width));
+        add(&depth, sizeof(depth));
+        for (int z = 0; z < depth; z++) {
+            for (int x = 0; x < width; x++) {
+                float h = terrain.GetSample(x, z);
+                add(&h, sizeof(h));
+            }
+        }
+        return hash;
+    }
+
+
+    // Stands for "no site"; finite so the parabola intersections below stay defined
+    static const float edt_far_g = 1e20f;
+
+
+    // Squared distance transform of a row (Felzenszwalb and Huttenlocher): f[i] is 0 at the
+    // sites and edt_far_g elsewhere, d[i] becomes the squared distance to the nearest site
+    static void DistanceTransform1D(const float* f, float* d, int n, int* v, float* z) {
+
+        // Lower envelope of the parabolas rooted at every cell
+        int k = 0;
+        v[0] = 0;
+        z[0] = -INFINITY;
+        z[1] = INFINITY;
+        for (int q = 1; q < n; q++) {
+            float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+            while (s <= z[k]) {
+                k--;
+                s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+            }
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = INFINITY;
+        }
+
+        k = 0;
+        for (int q = 0; q < n; q++) {
+            while (z[k + 1] < q) {
+                k++;
+            }
+            d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+        }
+    }
+
+
+    // Squared distance from every cell to the nearest cell where site is set
+    static void DistanceTransform2D(const std::vector<uint8_t>& site, int width, int depth, std::vector<float>& result) {
+
+        int n = std::max(width, depth);
+        std::vector<float> f(n), d(n), z(n + 1);
+        std::vector<int> v(n);
+        result.resize(width * depth);
+
+        // Columns
+        for (int x = 0; x < width; x++) {
+            for (int y = 0; y < depth; y++) {
+                f[y] = site[x + width * y] ? 0.0f : edt_far_g;
+            }
+            DistanceTransform1D(f.data(), d.data(), depth, v.data(), z.data());
+            for (int y = 0; y < depth; y++) {
+                result[x + width * y] = d[y];
+            }
+        }
+        // Rows
+        for (int y = 0; y < depth; y++) {
+            for (int x = 0; x < width; x++) {
+                f[x] = result[x + width * y];
+            }
+            DistanceTransform1D(f.data(), d.data(), width, v.data(), z.data());
+            for (int x = 0; x < width; x++) {
+                result[x + width * y] = d[x];
+            }
+        }
+    }
+
+
+    void WalkField::Build(const Terrain& terrain, float max_slope) {
+
+        width_ = terrain.GetWidth() - 1;
+        depth_ = terrain.GetDepth() - 1;
+        origin_ = terrain.GetOrigin();
+        max_slope_ = max_slope;
+        source_hash_ = HashTerrain(terrain);
+        if (width_ < 1 || depth_ < 1) {
+            walkable_.clear();
+            distance_.clear();
+            return;
+        }
+
+        // Walkable cells; the outermost ring never is
+        walkable_.assign(width_ * depth_, 0);
+        for (int z = 1; z < depth_ - 1; z++) {
+            for (int x = 1; x < width_ - 1; x++) {
+                walkable_[x + width_ * z] = terrain.GetCellSlope(x, z) < max_slope ? 1 : 0;
+            }
+        }
+        ComputeDistances();
+    }
+
+
+    void WalkField::Update(const Terrain& terrain, int x0, int z0, int x1, int z1) {
+
+        if (IsEmpty()) {
+            return;
+        }
+
+        // Cells with one of the samples as a corner
+        bool changed = false;
+        for (int z = std::max(z0 - 1, 1); z < std::min(z1, depth_ - 1); z++) {
+            for (int x = std::max(x0 - 1, 1); x < std::min(x1, width_ - 1); x++) {
+                uint8_t walkable = terrain.GetCellSlope(x, z) < max_slope_ ? 1 : 0;
+                changed = changed || walkable != walkable_[x + width_ * z];
+                walkable_[x + width_ * z] = walkable;
+            }
+        }
+        if (changed) {
+            // A nearest obstacle can be anywhere, so the distances are made again (a few
+            // milliseconds for the whole field). The field no longer matches a cache file
+            ComputeDistances();
+            source_hash_ = 0;
+        }
+    }
+
+
+    void WalkField::ComputeDistances(void) {
+
+        std::vector<uint8_t> blocked(walkable_.size());
+        for (int i = 0; i < walkable_.size(); i++) {
+            blocked[i] = walkable_[i] ? 0 : 1;
+        }
+
+        // Distance between cell centers to the nearest cell of the other kind; half a cell less
+        // puts zero on the edge between the two
+        std::vector<float> to_blocked, to_walkable;
+        DistanceTransform2D(blocked, width_, depth_, to_blocked);
+        DistanceTransform2D(walkable_, width_, depth_, to_walkable);
+        distance_.resize(width_ * depth_);
+        for (int i = 0; i < distance_.size(); i++) {
+            if (walkable_[i]) {
+                distance_[i] = std::sqrt(to_blocked[i]) - 0.5f;
+            }
+            else {
+                // With no walkable cell at all, everything is far inside an obstacle
+                distance_[i] = (to_walkable[i] >= edt_far_g * 0.5f) ? -(float)(width_ + depth_) : -(std::sqrt(to_walkable[i]) - 0.5f);
+            }
+        }
+    }
+
+
+    bool WalkField::Load(const std::string& filename, const Terrain& terrain, float max_slope) {
+
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        WalkFieldHeader header;
+        if (!file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, "BJWF", 4) != 0 || header.version != walk_field_version_g) {
+            return false;
+        }
+        // Made for other heights or another slope limit: build it again
+        if (header.width != terrain.GetWidth() - 1 || header.depth != terrain.GetDepth() - 1 || header.max_slope != max_slope || header.source_hash != HashTerrain(terrain)) {
+            return false;
+        }
+
+        std::vector<uint8_t> walkable(header.width * header.depth);
+        std::vector<float> distance(header.width * header.depth);
+        if (!file.read((char*)walkable.data(), walkable.size()) || !file.read((char*)distance.data(), distance.size() * sizeof(float))) {
+            return false;
+        }
+
+        width_ = header.width;
+        depth_ = header.depth;
+        origin_ = terrain.GetOrigin();
+        max_slope_ = max_slope;
+        source_hash_ = header.source_hash;
+        walkable_ = std::move(walkable);
+        distance_ = std::move(distance);
+        return true;
+    }
+
+
+    void WalkField::Save(const std::string& filename) const {
+
+        WalkFieldHeader header;
+        std::memcpy(header.magic, "BJWF", 4);
+        header.version = walk_field_version_g;
+        header.width = width_;
+        header.depth = depth_;
+        header.max_slope = max_slope_;
+        header.reserved = 0;
+        header.source_hash = source_hash_;
+
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) {
+            throw(std::ios_base::failure(std::string("Error opening file ") + filename));
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)walkable_.data(), walkable_.size());
+        file.write((const char*)distance_.data(), distance_.size() * sizeof(float));
+        if (!file) {
+            throw(std::ios_base::failure(std::string("Error writing file ") + filename));
+        }
+    }
+
+
+    void WalkField::GetCorners(float x, float z, float corner[4], float& s, float& t) const {
+
+        // Distances are stored at cell centers
+        float fx = std::min(std::max(x - origin_.x - 0.5f, 0.0f), (float)(width_ - 1));
+        float fz = std::min(std::max(z - origin_.y - 0.5f, 0.0f), (float)(depth_ - 1));
+        int ix = std::min((int)fx, std::max(width_ - 2, 0));
+        int iz = std::min((int)fz, std::max(depth_ - 2, 0));
+        int ix1 = std::min(ix + 1, width_ - 1);
+        int iz1 = std::min(iz + 1, depth_ - 1);
+        s = fx - ix;
+        t = fz - iz;
+        corner[0] = distance_[ix + width_ * iz];
+        corner[1] = distance_[ix1 + width_ * iz];
+        corner[2] = distance_[ix + width_ * iz1];
+        corner[3] = distance_[ix1 + width_ * iz1];
+    }
+
+
+    float WalkField::GetDistance(float x, float z) const {
+
+        if (IsEmpty()) {
+            return INFINITY;
+        }
+        float c[4], s, t;
+        GetCorners(x, z, c, s, t);
+        float distance = (1 - t) * ((1 - s) * c[0] + s * c[1]) + t * ((1 - s) * c[2] + s * c[3]);
+
+        // Off the field is always an obstacle
+        glm::vec2 local = glm::vec2(x, z) - origin_;
+        if (local.x < 0.0f || local.y < 0.0f || local.x > width_ || local.y > depth_) {
+            distance = std::min(distance, -glm::length(local - glm::clamp(local, glm::vec2(0.0f), glm::vec2(width_, depth_))));
+        }
+        return distance;
+    }
+
+
+    glm::vec2 WalkField::GetGradient(float x, float z) const {
+
+        if (IsEmpty()) {
+            return glm::vec2(0.0f);
+        }
+        float c[4], s, t;
+        GetCorners(x, z, c, s, t);
+        glm::vec2 gradient((1 - t) * (c[1] - c[0]) + t * (c[3] - c[2]), (1 - s) * (c[2] - c[0]) + s * (c[3] - c[1]));
+        float length = glm::length(gradient);
+        return (length > 0.0f) ? gradient / length : glm::vec2(0.0f);
+    }
+
+
+    glm::vec3 WalkField::Slide(glm::vec3 start, glm::vec3 end, float clearance) const {
+
+        if (IsEmpty() || GetDistance(end.x, end.z) >= clearance) {
+            return end;
+        }
+
+        // Drop the part of the movement that goes into the obstacle
+        glm::vec2 normal = GetGradient(end.x, end.z);
+        glm::vec2 movement(end.x - start.x, end.z - start.z);
+        float into = glm::dot(movement, normal);
+        if (into < 0.0f) {
+            movement -= normal * into;
+        }
+        glm::vec2 position = glm::vec2(start.x, start.z) + movement;
+
+        // Push back out to the clearance (the field is close to a true distance, so this
+        // converges in a step or two)
+        for (int i = 0; i < 4; i++) {
+            float distance = GetDistance(position.x, position.y);
+            if (distance >= clearance) {
+                break;
+            }
+            glm::vec2 out = GetGradient(position.x, position.y);
+            if (out == glm::vec2(0.0f)) {
+                break;
+            }
+            position += out * (clearance - distance + 0.001f);
+        }
+
+        // Wedged in a corner: stay put rather than end up inside the obstacle
+        if (GetDistance(position.x, position.y) < std::min(clearance, GetDistance(start.x, start.z))) {
+            return start;
+        }
+        return glm::vec3(position.x, end.y, position.y);
+    }
+
+} // namespace game
@@ -0,0 +1,71 @@
+/*
+ *
+ * Where the ground can be walked on, precomputed from the terrain. A cell is walkable if no
+ * edge of it is steeper than the slope limit; the border of the field never is. From the
+ * walkability mask a signed distance field is made (distance in units to the nearest cell of the
+ * other kind, positive on walkable ground), so movers can look up how far they are from an
+ * obstacle and which way it is in constant time and slide along it instead of stopping.
+ * Building takes a moment, so the result is cached in a file next to the height maps.
+ *
+ */
+#ifndef WALK_FIELD_H_
+#define WALK_FIELD_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "terrain.h"
+
+namespace game {
+
+    class WalkField {
+
+        public:
+            WalkField(void);
+
+            // Compute the mask and distances for the terrain
+            void Build(const Terrain& terrain, float max_slope);
+            // Read a cache file; returns false if it is missing or was made from other heights
+            bool Load(const std::string& filename, const Terrain& terrain, float max_slope);
+            // Write the cache file (throws std::ios_base::failure)
+            void Save(const std::string& filename) const;
+            bool IsEmpty(void) const { return distance_.empty(); }
+            // Heights of the samples [x0, x1) x [z0, z1) changed: check the cells around them
+            // again and make the distances again if one became (un)walkable
+            void Update(const Terrain& terrain, int x0, int z0, int x1, int z1);
+
+            // Signed distance to the nearest obstacle edge at a world position (x/z)
+            float GetDistance(float x, float z) const;
+            // Direction (x/z, normalized) in which the distance grows fastest, away from obstacles
+            glm::vec2 GetGradient(float x, float z) const;
+            bool IsWalkable(float x, float z) const { return GetDistance(x, z) >= 0.0f; }
+
+            // Where a mover going from start to end ends up if it keeps clearance from obstacles:
+            // the part of the movement into an obstacle is dropped and the rest slides along it.
+            // Only x and z are changed
+            glm::vec3 Slide(glm::vec3 start, glm::vec3 end, float clearance) const;
+
+        private:
+            int width_; // Cells
+            int depth_;
+            glm::vec2 origin_; // Corner of cell (0, 0)
+            float max_slope_;
+            uint64_t source_hash_; // Of the terrain heights the field was built from
+            std::vector<uint8_t> walkable_;
+            std::vector<float> distance_; // At cell centers
+
+            // Distance field from walkable_
+            void ComputeDistances(void);
+            // Fetch the four cell centers around a world position
+            void GetCorners(float x, float z, float corner[4], float& s, float& t) const;
+
+            static uint64_t HashTerrain(const Terrain& terrain);
+
+    }; // class WalkField
+
+} // namespace game
+
+#endif // WALK_FIELD_H_
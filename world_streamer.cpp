@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <ios>
+
+#include "world_streamer.h"
+#include "scene_graph.h"
+#include "resource_manager.h"
+#include "manipulator.h"
+#include "height_map.h"
+#include "terrain.h"
+#include "walk_field.h"
+
+namespace game {
+
+    WorldStreamer::WorldStreamer(void) :
+        chunk_size_(50.0f),
+        min_chunk_(0, 0),
+        max_chunk_(-1, -1),
+        load_radius_(75.0f),
+        unload_radius_(100.0f),
+        look_ahead_(2.0f),
+        budget_(64 * 1024 * 1024),
+        budget_radius_(FLT_MAX),
+        tile_error_(0.05f),
+        terrain_(NULL),
+        walk_field_(NULL),
+        resident_bytes_(0),
+        last_position_(0.0f),
+        has_last_position_(false),
+        epoch_(0),
+        stop_(false) {
+
+        loader_ = std::thread(&WorldStreamer::LoaderLoop, this);
+    }
+
+
+    WorldStreamer::~WorldStreamer() {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        loader_.join();
+    }
+
+
+    void WorldStreamer::Init(const std::string& prefix, float chunk_size, glm::vec2 min_corner, glm::vec2 max_corner) {
+
+        prefix_ = prefix;
+        chunk_size_ = chunk_size;
+        min_chunk_ = glm::ivec2((int)std::floor(min_corner.x / chunk_size), (int)std::floor(min_corner.y / chunk_size));
+        // The max corner itself belongs to the previous chunk
+        max_chunk_ = glm::ivec2((int)std::ceil(max_corner.x / chunk_size) - 1, (int)std::ceil(max_corner.y / chunk_size) - 1);
+    }
+
+
+    void WorldStreamer::SetRadius(float load_radius, float unload_radius) {
+
+        load_radius_ = load_radius;
+        unload_radius_ = std::max(load_radius, unload_radius);
+    }
+
+
+    void WorldStreamer::SetLookAhead(float seconds) {
+
+        look_ahead_ = seconds;
+    }
+
+
+    void WorldStreamer::SetMemoryBudget(size_t bytes) {
+
+        budget_ = bytes;
+    }
+
+
+    float WorldStreamer::GetChunkDistance(int64_t key, glm::vec3 point) const {
+
+        // Distance from the point to the chunk's rectangle
+        float x0 = GetKeyX(key) * chunk_size_;
+        float z0 = GetKeyZ(key) * chunk_size_;
+        float dx = std::max(0.0f, std::max(x0 - point.x, point.x - (x0 + chunk_size_)));
+        float dz = std::max(0.0f, std::max(z0 - point.z, point.z - (z0 + chunk_size_)));
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+
+    void WorldStreamer::GetChunksInRadius(glm::vec3 point, float radius, std::vector<int64_t>& result) const {
+
+        int x0 = std::max(min_chunk_.x, (int)std::floor((point.x - radius) / chunk_size_));
+        int x1 = std::min(max_chunk_.x, (int)std::floor((point.x + radius) / chunk_size_));
+        int z0 = std::max(min_chunk_.y, (int)std::floor((point.z - radius) / chunk_size_));
+        int z1 = std::min(max_chunk_.y, (int)std::floor((point.z + radius) / chunk_size_));
+
+        result.clear();
+        for (int z = z0; z <= z1; z++) {
+            for (int x = x0; x <= x1; x++) {
+                int64_t key = MakeKey(x, z);
+                if (GetChunkDistance(key, point) <= radius) {
+                    result.push_back(key);
+                }
+            }
+        }
+        std::sort(result.begin(), result.end(), [&](int64_t a, int64_t b) {
+            return GetChunkDistance(a, point) < GetChunkDistance(b, point);
+        });
+    }
+
+
+    // Read a square height tile (any HeightMap format); heights are scaled like the boundary
+    // (the brightest 8 bit value -> ~32 units)
+    static bool ReadHeightTile(const std::string& filename, std::vector<float>& height, int& size, std::string& error) {
+
+        if (!std::ifstream(filename).good()) {
+            return false;
+        }
+
+        HeightMap file;
+        try {
+            file.Open(filename);
+        }
+        catch (const std::ios_base::failure& e) {
+            error = e.what();
+            return false;
+        }
+        if (file.GetWidth() != file.GetDepth() || file.GetWidth() < 2) {
+            error = "Height tile must be square: " + filename;
+            return false;
+        }
+
+        size = file.GetWidth();
+        height.resize(size * size);
+        for (int z = 0; z < size; z++) {
+            for (int x = 0; x < size; x++) {
+                height[x + size * z] = file.GetHeight(x, z, 255.0f / 8.0f);
+            }
+        }
+        return true;
+    }
+
+
+    std::unique_ptr<WorldStreamer::ChunkData> WorldStreamer::LoadChunkData(int64_t key) const {
+
+        std::unique_ptr<ChunkData> data(new ChunkData());
+        data->key = key;
+        std::string base = prefix_ + "_" + std::to_string(GetKeyX(key)) + "_" + std::to_string(GetKeyZ(key));
+
+        // A chunk without a scene file simply has no objects
+        if (std::ifstream(base + ".scene").good()) {
+            try {
+                data->scene.reset(new SceneFile());
+                data->scene->Open(base + ".scene");
+
+                // Touch every page now so building the chunk on the main thread does not stall on disk
+                volatile char sum = 0;
+                const char* bytes = (const char*)&data->scene->GetRecord(0);
+                size_t size = data->scene->GetSize() - sizeof(SceneFileHeader);
+                for (size_t i = 0; i < size && data->scene->GetNumRecords() > 0; i += 4096) {
+                    sum += bytes[i];
+                }
+            }
+            catch (const std::ios_base::failure& e) {
+                data->scene.reset();
+                data->error = e.what();
+            }
+        }
+
+        ReadHeightTile(base + ".pgm", data->height, data->tile_size, data->error);
+        return data;
+    }
+
+
+    void WorldStreamer::LoaderLoop(void) {
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this] { return stop_ || !request_.empty(); });
+            if (stop_) {
+                return;
+            }
+            int64_t key = request_.front();
+            request_.pop_front();
+            int epoch = epoch_;
+
+            // File access happens without holding the lock
+            lock.unlock();
+            std::unique_ptr<ChunkData> data = LoadChunkData(key);
+            data->epoch = epoch;
+            lock.lock();
+
+            done_.push_back(std::move(data));
+        }
+    }
+
+
+    void WorldStreamer::AddChunk(ChunkData& data, SceneGraph* scene, ResourceManager* resman, Manipulator* manipulator) {
+
+        if (!data.error.empty()) {
+            throw(std::ios_base::failure(data.error));
+        }
+
+        Chunk chunk;
+        chunk.x = GetKeyX(data.key);
+        chunk.z = GetKeyZ(data.key);
+        chunk.ground_x = chunk.ground_z = chunk.ground_size = 0;
+        chunk.bytes = 0;
+
+        // The ground first, so records placed on it land on the tile
+        if (data.tile_size > 0 && terrain_ != NULL && !terrain_->IsEmpty()) {
+            // Only the samples inside the chunk; the last row and column of a tile are the first
+            // ones of the next chunk
+            glm::vec2 origin = terrain_->GetOrigin();
+            chunk.ground_x = (int)std::floor(chunk.x * chunk_size_ - origin.x);
+            chunk.ground_z = (int)std::floor(chunk.z * chunk_size_ - origin.y);
+            chunk.ground_size = std::min(data.tile_size, (int)std::ceil(chunk_size_));
+            terrain_->RaiseHeights(chunk.ground_x, chunk.ground_z, chunk.ground_size, chunk.ground_size, data.height.data(), data.tile_size);
+            if (walk_field_ != NULL) {
+                walk_field_->Update(*terrain_, chunk.ground_x, chunk.ground_z, chunk.ground_x + chunk.ground_size, chunk.ground_z + chunk.ground_size);
+            }
+        }
+
+        if (data.scene) {
+            std::vector<char>& removed = removed_[data.key];
+            manipulator->ConstructWorld(resman, scene, *data.scene, &chunk.entity, &removed);
+            removed.resize(chunk.entity.size(), 0);
+            // The nodes built from the records; the mapped file is released once they exist
+            for (int i = 0; i < chunk.entity.size(); i++) {
+                CompositeNode* node = chunk.entity[i].IsNull() ? NULL : scene->GetNode(chunk.entity[i]);
+                if (node) {
+                    chunk.bytes += sizeof(CompositeNode) + node->GetAllNodes().size() * sizeof(SceneNode);
+                }
+            }
+        }
+
+        if (data.tile_size > 0) {
+            // The mesh is placed in world coordinates through the plane offset
+            chunk.tile = "TerrainTile_" + std::to_string(chunk.x) + "_" + std::to_string(chunk.z);
+            int offset_x = -(int)std::floor(chunk.x * chunk_size_);
+            int offset_z = -(int)std::floor(chunk.z * chunk_size_);
+            resman->CreateSimplifiedPlane(chunk.tile, data.height, data.tile_size, data.tile_size, offset_x, offset_z, tile_error_);
+            chunk.tile_entity = scene->AddNode(manipulator->ConstructTerrainTile(resman, chunk.tile, chunk.tile));
+            // Index buffer and vertex buffer (11 floats per vertex, about one vertex per two
+            // triangles)
+            size_t indices = resman->GetResource(chunk.tile)->GetSize();
+            chunk.bytes += indices * sizeof(unsigned int) + (indices / 6 + 1) * 11 * sizeof(float);
+        }
+
+        resident_bytes_ += chunk.bytes;
+        loaded_[data.key] = chunk;
+    }
+
+
+    void WorldStreamer::RemoveChunk(int64_t key, SceneGraph* scene) {
+
+        auto it = loaded_.find(key);
+        if (it == loaded_.end()) {
+            return;
+        }
+        Chunk& chunk = it->second;
+
+        // Objects that are gone already were removed by the game (e.g. collected)
+        std::vector<char>& removed = removed_[key];
+        removed.resize(chunk.entity.size(), 0);
+        for (int i = 0; i < chunk.entity.size(); i++) {
+            if (chunk.entity[i].IsNull()) {
+                continue;
+            }
+            if (!scene->IsAlive(chunk.entity[i]) || scene->IsDying(chunk.entity[i])) {
+                removed[i] = 1;
+            }
+            else {
+                scene->Destroy(chunk.entity[i]);
+            }
+        }
+
+        if (!chunk.tile.empty()) {
+            scene->Destroy(chunk.tile_entity);
+            free_tiles_.push_back(chunk.tile);
+        }
+        RestoreGround(chunk);
+
+        resident_bytes_ -= chunk.bytes;
+        loaded_.erase(it);
+    }
+
+
+    void WorldStreamer::RestoreGround(const Chunk& chunk) {
+
+        if (chunk.ground_size == 0 || terrain_ == NULL) {
+            return;
+        }
+        terrain_->RestoreHeights(chunk.ground_x, chunk.ground_z, chunk.ground_size, chunk.ground_size);
+        if (walk_field_ != NULL) {
+            walk_field_->Update(*terrain_, chunk.ground_x, chunk.ground_z, chunk.ground_x + chunk.ground_size, chunk.ground_z + chunk.ground_size);
+        }
+    }
+
+
+    void WorldStreamer::LoadAround(glm::vec3 position, SceneGraph* scene, ResourceManager* resman, Manipulator* manipulator) {
+
+        std::vector<int64_t> wanted;
+        GetChunksInRadius(position, load_radius_, wanted);
+        for (int i = 0; i < wanted.size(); i++) {
+            if (loaded_.find(wanted[i]) == loaded_.end() && pending_.find(wanted[i]) == pending_.end()) {
+                std::unique_ptr<ChunkData> data = LoadChunkData(wanted[i]);
+                AddChunk(*data, scene, resman, manipulator);
+            }
+        }
+        last_position_ = position;
+        has_last_position_ = true;
+    }
+
+
+    bool WorldStreamer::Update(glm::vec3 position, float delta_time, SceneGraph* scene, ResourceManager* resman, Manipulator* manipulator) {
+
+        bool changed = false;
+
+        // Tiles unloaded last frame are no longer drawn (their nodes were freed by EndFrame)
+        for (int i = 0; i < free_tiles_.size(); i++) {
+            resman->RemoveResource(free_tiles_[i]);
+        }
+        free_tiles_.clear();
+
+        // Add the chunks that finished loading, unless the player moved away in the meantime.
+        // Loads requested before the last Clear are dropped
+        std::vector<std::unique_ptr<ChunkData>> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int i = 0; i < done_.size(); i++) {
+                if (done_[i]->epoch == epoch_) {
+                    done.push_back(std::move(done_[i]));
+                }
+            }
+            done_.clear();
+        }
+        for (int i = 0; i < done.size(); i++) {
+            pending_.erase(done[i]->key);
+            if (loaded_.find(done[i]->key) == loaded_.end() && GetChunkDistance(done[i]->key, position) <= unload_radius_) {
+                AddChunk(*done[i], scene, resman, manipulator);
+                changed = true;
+            }
+        }
+
+        // Look ahead along the player's velocity
+        glm::vec3 velocity(0.0f);
+        if (has_last_position_ && delta_time > 0.0f) {
+            velocity = (position - last_position_) / delta_time;
+        }
+        last_position_ = position;
+        has_last_position_ = true;
+
+        // Nearest chunks are requested first; chunks ahead of the player come after those around it
+        // Once the budget forced chunks out, only nearer ones are requested until memory frees up
+        if (resident_bytes_ < budget_ / 2) {
+            budget_radius_ = FLT_MAX;
+        }
+        float radius = std::min(load_radius_, budget_radius_);
+        std::vector<int64_t> wanted;
+        std::vector<int64_t> ahead;
+        GetChunksInRadius(position, radius, wanted);
+        GetChunksInRadius(position + velocity * look_ahead_, radius, ahead);
+        wanted.insert(wanted.end(), ahead.begin(), ahead.end());
+
+        std::vector<int64_t> request;
+        for (int i = 0; i < wanted.size(); i++) {
+            int64_t key = wanted[i];
+            if (loaded_.find(key) == loaded_.end() && pending_.find(key) == pending_.end()) {
+                pending_[key] = 1;
+                request.push_back(key);
+            }
+        }
+        if (!request.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                request_.insert(request_.end(), request.begin(), request.end());
+            }
+            wake_.notify_one();
+        }
+
+        // Unload chunks left behind
+        std::vector<int64_t> far;
+        for (auto it = loaded_.begin(); it != loaded_.end(); ++it) {
+            if (GetChunkDistance(it->first, position) > unload_radius_) {
+                far.push_back(it->first);
+            }
+        }
+        for (int i = 0; i < far.size(); i++) {
+            RemoveChunk(far[i], scene);
+            changed = true;
+        }
+
+        // Over budget: drop the farthest chunks, but never the one the player is in
+        while (resident_bytes_ > budget_ && loaded_.size() > 1) {
+            int64_t farthest = loaded_.begin()->first;
+            for (auto it = loaded_.begin(); it != loaded_.end(); ++it) {
+                if (GetChunkDistance(it->first, position) > GetChunkDistance(farthest, position)) {
+                    farthest = it->first;
+                }
+            }
+            float distance = GetChunkDistance(farthest, position);
+            if (distance == 0.0f) {
+                break;
+            }
+            budget_radius_ = std::min(budget_radius_, distance * 0.99f);
+            RemoveChunk(farthest, scene);
+            changed = true;
+        }
+
+        return changed;
+    }
+
+
+    void WorldStreamer::Clear(ResourceManager* resman) {
+
+        // Loads in flight are discarded when they come back
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            request_.clear();
+            done_.clear();
+            epoch_++;
+        }
+
+        for (auto it = loaded_.begin(); it != loaded_.end(); ++it) {
+            if (!it->second.tile.empty()) {
+                free_tiles_.push_back(it->second.tile);
+            }
+            RestoreGround(it->second);
+        }
+        for (int i = 0; i < free_tiles_.size(); i++) {
+            resman->RemoveResource(free_tiles_[i]);
+        }
+        free_tiles_.clear();
+
+        loaded_.clear();
+        pending_.clear();
+        removed_.clear();
+        resident_bytes_ = 0;
+        budget_radius_ = FLT_MAX;
+        has_last_position_ = false;
+    }
+
+} // namespace game
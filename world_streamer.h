@@ -0,0 +1,146 @@
+/*
+ *
+ * Streams the world in square chunks around the player. Each chunk has a scene file with its
+ * objects (<prefix>_<x>_<z>.scene, see scene_file.h) and optionally a height tile
+ * (<prefix>_<x>_<z>.pgm) that raises the shared Terrain (and so the ground the camera walks and
+ * collides with) while the chunk is loaded; chunks without files are empty. Files are read on a loader thread,
+ * chunks ahead of the player (by its velocity) are requested early, and chunks that fall behind
+ * are unloaded. Objects removed during play (collected parts) stay removed when their chunk
+ * is loaded again.
+ *
+ */
+#ifndef WORLD_STREAMER_H_
+#define WORLD_STREAMER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "entity_handle.h"
+#include "scene_file.h"
+
+namespace game {
+
+    class SceneGraph;
+    class ResourceManager;
+    class Manipulator;
+    class Terrain;
+    class WalkField;
+
+    class WorldStreamer {
+
+        public:
+            WorldStreamer(void);
+            ~WorldStreamer();
+
+            // Chunk (x, z) covers [x, x + 1) * chunk_size on each axis; only chunks overlapping
+            // the world rectangle are loaded
+            void Init(const std::string& prefix, float chunk_size, glm::vec2 min_corner, glm::vec2 max_corner);
+            // Chunks closer than load_radius are loaded, chunks farther than unload_radius are dropped
+            void SetRadius(float load_radius, float unload_radius);
+            // How far ahead (in seconds of movement) chunks are requested
+            void SetLookAhead(float seconds);
+            // Approximate limit on the memory held by loaded chunks; the farthest chunks go first
+            void SetMemoryBudget(size_t bytes);
+            // Height error allowed when the terrain tiles are simplified
+            void SetTileError(float error) { tile_error_ = error; }
+            // Ground the height tiles are merged into (optional; without it tiles are only drawn)
+            void SetGround(Terrain* terrain, WalkField* walk_field) { terrain_ = terrain; walk_field_ = walk_field; }
+
+            // Load every chunk around the position right away (used at startup)
+            void LoadAround(glm::vec3 position, SceneGraph* scene, ResourceManager* resman, Manipulator* manipulator);
+            // Once per frame: request chunks around and ahead of the player, add the ones that
+            // finished loading and unload far ones. Returns true if any chunk was added or removed.
+            bool Update(glm::vec3 position, float delta_time, SceneGraph* scene, ResourceManager* resman, Manipulator* manipulator);
+            // Forget every chunk (after the scene was cleared) and free the terrain tiles
+            void Clear(ResourceManager* resman);
+
+            int GetNumLoaded(void) const { return loaded_.size(); }
+            size_t GetResidentBytes(void) const { return resident_bytes_; }
+
+        private:
+            // Files of a chunk, read on the loader thread
+            struct ChunkData {
+                int64_t key;
+                int epoch = 0; // epoch_ when the load was taken
+                std::unique_ptr<SceneFile> scene; // NULL if the chunk has no objects
+                std::vector<float> height; // Height tile, tile_size * tile_size samples
+                int tile_size = 0;
+                std::string error;
+            };
+
+            // A chunk that is in the scene
+            struct Chunk {
+                int x, z;
+                std::vector<EntityHandle> entity; // Per scene record
+                std::string tile; // Name of the terrain tile mesh, empty if none
+                EntityHandle tile_entity;
+                int ground_x, ground_z; // First terrain sample raised by the tile
+                int ground_size; // Samples raised on each axis, 0 if none
+                size_t bytes;
+            };
+
+            std::string prefix_;
+            float chunk_size_;
+            glm::ivec2 min_chunk_;
+            glm::ivec2 max_chunk_;
+            float load_radius_;
+            float unload_radius_;
+            float look_ahead_;
+            size_t budget_;
+            float budget_radius_; // Request radius after the budget forced chunks out
+            float tile_error_;
+            Terrain* terrain_;
+            WalkField* walk_field_;
+
+            std::unordered_map<int64_t, Chunk> loaded_;
+            std::unordered_map<int64_t, char> pending_; // Requested, not loaded yet
+            // Records removed during play, per chunk, kept across unloads
+            std::unordered_map<int64_t, std::vector<char>> removed_;
+            size_t resident_bytes_;
+
+            glm::vec3 last_position_;
+            bool has_last_position_;
+
+            // Tile meshes to free; nodes using them are only deleted at the end of the frame
+            std::vector<std::string> free_tiles_;
+
+            // Loader thread
+            std::thread loader_;
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::deque<int64_t> request_;
+            std::vector<std::unique_ptr<ChunkData>> done_;
+            int epoch_; // Bumped by Clear; older loads are stale
+            bool stop_;
+
+            void LoaderLoop(void);
+            std::unique_ptr<ChunkData> LoadChunkData(int64_t key) const;
+
+            // Create the chunk's objects and tile in the scene
+            void AddChunk(ChunkData& data, SceneGraph* scene, ResourceManager* resman, Manipulator* manipulator);
+            void RemoveChunk(int64_t key, SceneGraph* scene);
+            // Put the ground under a chunk's tile back as it was
+            void RestoreGround(const Chunk& chunk);
+
+            // Chunks whose rectangle is within radius of the point (x/z), nearest first
+            void GetChunksInRadius(glm::vec3 point, float radius, std::vector<int64_t>& result) const;
+            float GetChunkDistance(int64_t key, glm::vec3 point) const;
+
+            static int64_t MakeKey(int x, int z) { return ((int64_t)x << 32) | (uint32_t)z; }
+            static int GetKeyX(int64_t key) { return (int)(key >> 32); }
+            static int GetKeyZ(int64_t key) { return (int)(uint32_t)key; }
+
+    }; // class WorldStreamer
+
+} // namespace game
+
+#endif // WORLD_STREAMER_H_